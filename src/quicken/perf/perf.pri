@@ -1,19 +1,40 @@
 HEADERS += \
+    $$PWD/quickenallocationtracker_p.h \
+    $$PWD/quickenanimationtracker_p.h \
     $$PWD/quickenapplicationmonitor.h \
     $$PWD/quickenapplicationmonitor_p.h \
+    $$PWD/quickenbinarylogreader.h \
+    $$PWD/quickenbinarylogreader_p.h \
+    $$PWD/quickenbindingprofiler_p.h \
     $$PWD/quickenbitmaptext_p.h \
     $$PWD/quickenbitmaptextfont_p.h \
+    $$PWD/quickencompactlog_p.h \
+    $$PWD/quickencompactlogreader.h \
+    $$PWD/quickencompactlogreader_p.h \
     $$PWD/quickengputimer_p.h \
     $$PWD/quickenlogger.h \
     $$PWD/quickenlogger_p.h \
     $$PWD/quickenmetrics.h \
     $$PWD/quickenmetrics_p.h \
-    $$PWD/quickenoverlay_p.h
+    $$PWD/quickenopenglcounters_p.h \
+    $$PWD/quickenoverlay_p.h \
+    $$PWD/quickenstartuptimeline_p.h
 
 SOURCES += \
+    $$PWD/quickenallocationtracker.cpp \
+    $$PWD/quickenanimationtracker.cpp \
     $$PWD/quickenapplicationmonitor.cpp \
+    $$PWD/quickenbinarylogreader.cpp \
+    $$PWD/quickenbindingprofiler.cpp \
     $$PWD/quickenbitmaptext.cpp \
+    $$PWD/quickencompactlogreader.cpp \
     $$PWD/quickengputimer.cpp \
     $$PWD/quickenlogger.cpp \
     $$PWD/quickenmetrics.cpp \
-    $$PWD/quickenoverlay.cpp
+    $$PWD/quickenopenglcounters.cpp \
+    $$PWD/quickenoverlay.cpp \
+    $$PWD/quickenstartuptimeline.cpp
+
+# Per-thread heap allocation counters reported in frame metrics, enabled with
+# "qmake CONFIG+=quicken_allocation_tracking". Interposes the glibc allocator.
+quicken_allocation_tracking: DEFINES += QUICKEN_ALLOCATION_TRACKING
@@ -0,0 +1,142 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenallocationtracker_p.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+// static.
+bool QuickenAllocationTracker::isAvailable()
+{
+#if defined(QUICKEN_ALLOCATION_TRACKING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(QUICKEN_ALLOCATION_TRACKING)
+
+// The initial-exec TLS model makes the counters reachable without calling
+// __tls_get_addr(), which can allocate and would recurse into malloc().
+static __thread QuickenAllocationCounters counters __attribute__((tls_model("initial-exec")));
+
+// static.
+const QuickenAllocationCounters* QuickenAllocationTracker::threadCounters()
+{
+    return &counters;
+}
+
+// Entry points of the glibc allocator.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+// The counters are only written by their thread, a relaxed load and store is
+// enough and avoids the locked read-modify-write instruction of fetch_add().
+static inline void increment(std::atomic<quint64>* counter, quint64 value)
+{
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline void countAllocation(size_t size)
+{
+    increment(&counters.allocationCount, 1);
+    increment(&counters.allocatedBytes, size);
+}
+
+static inline void countFree()
+{
+    increment(&counters.freeCount, 1);
+}
+
+extern "C" Q_DECL_EXPORT void* malloc(size_t size) __THROW
+{
+    void* pointer = __libc_malloc(size);
+    if (Q_LIKELY(pointer)) {
+        countAllocation(size);
+    }
+    return pointer;
+}
+
+extern "C" Q_DECL_EXPORT void* calloc(size_t count, size_t size) __THROW
+{
+    // Returns nullptr if count * size overflows.
+    void* pointer = __libc_calloc(count, size);
+    if (Q_LIKELY(pointer)) {
+        countAllocation(count * size);
+    }
+    return pointer;
+}
+
+extern "C" Q_DECL_EXPORT void* realloc(void* pointer, size_t size) __THROW
+{
+    // Moving or resizing a block counts as a free and an allocation. A null
+    // pointer makes it a malloc(), a 0 size frees the block and a failure
+    // leaves the block untouched.
+    void* newPointer = __libc_realloc(pointer, size);
+    if (Q_LIKELY(newPointer)) {
+        if (pointer) {
+            countFree();
+        }
+        countAllocation(size);
+    } else if (pointer && size == 0) {
+        countFree();
+    }
+    return newPointer;
+}
+
+extern "C" Q_DECL_EXPORT void* memalign(size_t alignment, size_t size) __THROW
+{
+    void* pointer = __libc_memalign(alignment, size);
+    if (Q_LIKELY(pointer)) {
+        countAllocation(size);
+    }
+    return pointer;
+}
+
+extern "C" Q_DECL_EXPORT void* aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return memalign(alignment, size);
+}
+
+extern "C" Q_DECL_EXPORT int posix_memalign(void** pointer, size_t alignment, size_t size) __THROW
+{
+    if (alignment < sizeof(void*) || !IS_POWER_OF_TWO(alignment)) {
+        return EINVAL;
+    }
+    void* newPointer = memalign(alignment, size);
+    if (Q_UNLIKELY(!newPointer)) {
+        return ENOMEM;
+    }
+    *pointer = newPointer;
+    return 0;
+}
+
+extern "C" Q_DECL_EXPORT void free(void* pointer) __THROW
+{
+    if (Q_LIKELY(pointer)) {
+        countFree();
+        __libc_free(pointer);
+    }
+}
+
+#else
+
+// Without allocation tracking, all the threads share counters staying at 0.
+static QuickenAllocationCounters counters;
+
+// static.
+const QuickenAllocationCounters* QuickenAllocationTracker::threadCounters()
+{
+    return &counters;
+}
+
+#endif  // QUICKEN_ALLOCATION_TRACKING
@@ -0,0 +1,58 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef ALLOCATIONTRACKER_P_H
+#define ALLOCATIONTRACKER_P_H
+
+#include <atomic>
+
+#include <Quicken/private/quickenglobal_p.h>
+
+// Heap allocation counters of a thread. Only written by their thread with
+// relaxed atomic stores (no locked instructions), other threads can read them
+// at any time with QuickenAllocationTracker::readCounters().
+struct QuickenAllocationCounters
+{
+    std::atomic<quint64> allocationCount;
+    std::atomic<quint64> freeCount;
+    std::atomic<quint64> allocatedBytes;
+};
+
+// Snapshot of QuickenAllocationCounters.
+struct QuickenAllocationCounts
+{
+    quint64 allocationCount;
+    quint64 freeCount;
+    quint64 allocatedBytes;
+};
+
+// Counts the heap allocations of each thread by interposing malloc(), free()
+// and friends. Opt-in, Quicken must be built with the
+// quicken_allocation_tracking qmake configuration option. The interposition
+// only takes effect if libQuicken comes before the C library in the symbol
+// lookup order, which is the case when the application links to it or when
+// it's preloaded (LD_PRELOAD), not when it's only loaded by a QML plugin.
+class QUICKEN_PRIVATE_EXPORT QuickenAllocationTracker
+{
+public:
+    // Whether Quicken has been built with allocation tracking.
+    static bool isAvailable();
+
+    // Get the counters of the calling thread. They stay valid as long as the
+    // thread is alive.
+    static const QuickenAllocationCounters* threadCounters();
+
+    // Get a snapshot of the given counters.
+    static void readCounters(
+        const QuickenAllocationCounters* counters, QuickenAllocationCounts* counts) {
+        DASSERT(counters);
+        DASSERT(counts);
+        counts->allocationCount = counters->allocationCount.load(std::memory_order_relaxed);
+        counts->freeCount = counters->freeCount.load(std::memory_order_relaxed);
+        counts->allocatedBytes = counters->allocatedBytes.load(std::memory_order_relaxed);
+    }
+};
+
+#endif  // ALLOCATIONTRACKER_P_H
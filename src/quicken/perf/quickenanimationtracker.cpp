@@ -0,0 +1,137 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenanimationtracker_p.h"
+
+#include <QtCore/private/qabstractanimation_p.h>
+#include <QtQml/private/qtqmlglobal_p.h>
+#if QT_CONFIG(qml_debug)
+#include <QtQml/private/qqmldebugconnector_p.h>
+#include <QtQml/private/qqmldebugserviceinterfaces_p.h>
+#endif
+
+#include <Quicken/quickenmetrics.h>
+
+// Animation timer only registered to the unified timer to be notified of the
+// end of ticks, the unified timer restarting all its timers once they've been
+// advanced.
+class TickEndTimer : public QAbstractAnimationTimer
+{
+public:
+    void updateAnimationsTime(qint64 delta) override { Q_UNUSED(delta); }
+    void restartAnimationTimer() override;
+    int runningAnimationCount() override { return 0; }
+};
+
+static QuickenAnimationCounts counts;
+static TickEndTimer* tickEndTimer = nullptr;
+static bool tickEndTimerRegistered = false;
+static bool profilerConflict = false;  // The QML profiler owns the callback.
+static quint64 tickStartTimeStamp = 0;  // 0 if not in a tick.
+static quint64 previousTickTimeStamp = 0;  // 0 if the driver has just started.
+
+void TickEndTimer::restartAnimationTimer()
+{
+    // Also called when animations are started outside of ticks.
+    if (tickStartTimeStamp != 0) {
+        counts.advanceTime += QuickenMetricsUtils::timeStamp() - tickStartTimeStamp;
+        tickStartTimeStamp = 0;
+    }
+}
+
+// Called by the unified timer before advancing the animations, delta being the
+// animation time elapsed since the previous tick in milliseconds.
+static void tickStarted(qint64 delta)
+{
+    // Left registered when uninstalled while the QML profiler is loaded.
+    if (!tickEndTimer) {
+        return;
+    }
+    const quint64 timeStamp = QuickenMetricsUtils::timeStamp();
+    counts.tickCount++;
+    if (previousTickTimeStamp != 0) {
+        counts.animationTime += delta * 1000000;
+        counts.wallTime += timeStamp - previousTickTimeStamp;
+    }
+    previousTickTimeStamp = timeStamp;
+    tickStartTimeStamp = timeStamp;
+
+    // A registered timer keeps the animation driver running, the tick end timer
+    // is unregistered once no animations are running, letting the driver stop
+    // after that last tick. Unregistering is allowed while timers are advanced.
+    const bool running = QUnifiedTimer::instance()->runningAnimationCount() > 0;
+    if (!tickEndTimerRegistered && running) {
+        QUnifiedTimer::startAnimationTimer(tickEndTimer);
+        tickEndTimerRegistered = true;
+    } else if (tickEndTimerRegistered && !running) {
+        QUnifiedTimer::stopAnimationTimer(tickEndTimer);
+        tickEndTimerRegistered = false;
+        tickStartTimeStamp = 0;
+        previousTickTimeStamp = 0;
+    }
+}
+
+// The unified timer has a single profiler callback, which the QML profiler
+// registers to profile animations once its service is loaded.
+static bool qmlProfilerLoaded()
+{
+#if QT_CONFIG(qml_debug)
+    return QQmlDebugConnector::service<QQmlProfilerService>() != nullptr;
+#else
+    return false;
+#endif
+}
+
+// static.
+bool QuickenAnimationTracker::install()
+{
+    if (!tickEndTimer) {
+        if (profilerConflict) {
+            return false;
+        }
+        if (qmlProfilerLoaded()) {
+            WARN("AnimationTracker: QML profiler loaded, animation ticks can't be tracked.");
+            profilerConflict = true;
+            return false;
+        }
+        tickEndTimer = new TickEndTimer;
+        tickStartTimeStamp = 0;
+        previousTickTimeStamp = 0;
+        QUnifiedTimer::instance()->registerProfilerCallback(tickStarted);
+    }
+    return true;
+}
+
+// static.
+void QuickenAnimationTracker::uninstall()
+{
+    profilerConflict = false;
+    if (tickEndTimer) {
+        // A QML profiler loaded since install() registers its own callback
+        // once profiling, which must be kept. Ours is kept too in case it's
+        // not registered yet, it does nothing once uninstalled.
+        if (!qmlProfilerLoaded()) {
+            QUnifiedTimer::instance()->registerProfilerCallback(nullptr);
+        }
+        if (tickEndTimerRegistered) {
+            QUnifiedTimer::stopAnimationTimer(tickEndTimer);
+            tickEndTimerRegistered = false;
+        }
+        delete tickEndTimer;
+        tickEndTimer = nullptr;
+    }
+}
+
+// static.
+const QuickenAnimationCounts& QuickenAnimationTracker::counts()
+{
+    return ::counts;
+}
+
+// static.
+int QuickenAnimationTracker::runningAnimationCount()
+{
+    return QUnifiedTimer::instance()->runningAnimationCount();
+}
@@ -0,0 +1,50 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef ANIMATIONTRACKER_P_H
+#define ANIMATIONTRACKER_P_H
+
+#include <Quicken/private/quickenglobal_p.h>
+
+// Animation ticks counted for the GUI thread since tracking started.
+struct QuickenAnimationCounts
+{
+    // Number of animation ticks, a tick advancing all the running animations.
+    quint64 tickCount;
+
+    // Time in nanoseconds spent advancing the animations.
+    quint64 advanceTime;
+
+    // Time in nanoseconds the animation clock advanced and wall-clock time in
+    // nanoseconds elapsed between ticks. The first tick after the animation
+    // driver started isn't taken into account since it doesn't have a
+    // previous tick.
+    quint64 animationTime;
+    quint64 wallTime;
+};
+
+// Tracks the ticks of the animation driver of the GUI thread, the one of the
+// QtQuick render loop or the default timer based one, through the unified
+// animation timer. The start of a tick is reported by the unified timer
+// profiler callback, which is also used by the QML profiler when it profiles
+// animations, and its end by an animation timer registered while animations
+// are running. Must be used from the GUI thread.
+class QUICKEN_PRIVATE_EXPORT QuickenAnimationTracker
+{
+public:
+    // Start and stop tracking ticks. Counts are kept when stopped. Returns
+    // false, warning once, if the QML profiler is loaded since it needs the
+    // unified timer profiler callback.
+    static bool install();
+    static void uninstall();
+
+    // Get the counts since tracking started.
+    static const QuickenAnimationCounts& counts();
+
+    // Get the number of animations currently running on the GUI thread.
+    static int runningAnimationCount();
+};
+
+#endif  // ANIMATIONTRACKER_P_H
@@ -6,119 +6,407 @@
 
 #include "quickenapplicationmonitor_p.h"
 
+#include <time.h>
+#include <atomic>
+
 #include <QtCore/QTimer>
+#include <QtCore/qmath.h>
 #include <QtGui/QGuiApplication>
+#include <QtGui/QMouseEvent>
+#include <QtQml/QQmlEngine>
+#include <QtQuick/QQuickItem>
 #include <QtQuick/QQuickWindow>
+#include <QtQuick/QSGGeometry>
+#include <QtQuick/QSGMaterial>
+#include <QtQuick/QSGNode>
 #include <QtQuick/QSGRendererInterface>
+#include <QtQml/private/qqmldata_p.h>
+#include <QtQml/private/qv4engine_p.h>
+#include <QtQml/private/qv4mm_p.h>
+#include <QtQml/private/qv8engine_p.h>
+#include <QtQuick/private/qquickwindow_p.h>
+#include <QtQuick/private/qsgrenderer_p.h>
 
-// FIXME(loicm) When a monitored window is destroyed and if there's a window
-//     that's not monitored because the max count was reached, enable monitoring
-//     on it if possible.
-
-const int logQueueSize = 16;
 const int logQueueAlignment = 64;
+const unsigned long logFlushInterval = 100;  // In milliseconds.
+const quint32 maxInputQueueingDelay = 10000;  // In milliseconds.
+const quint64 maxInputLatency = Q_UINT64_C(1000000000);  // In nanoseconds.
 
-LoggingThread::LoggingThread()
-    : m_loggerCount(0)
-    , m_refCount(1)
-    , m_queueIndex(0)
-    , m_queueSize(0)
+LoggerWorker::LoggerWorker(QuickenLogger* logger, int queueSize)
+    : m_logger(logger)
     , m_flags(0)
+    , m_droppedCount(0)
+    , m_deliveredCount(0)
+    , m_queueSize(queueSize)
+    , m_queueMask(queueSize - 1)
+    , m_queueTail(0)
+    , m_queueHead(0)
 {
+    DASSERT(logger);
+    DASSERT(IS_POWER_OF_TWO(queueSize));
+
     m_queue = static_cast<QuickenMetrics*>(
-        alignedAlloc(logQueueAlignment, logQueueSize * sizeof(QuickenMetrics)));
+        alignedAlloc(logQueueAlignment, m_queueSize * sizeof(QuickenMetrics)));
 
 #if !defined(QT_NO_DEBUG)
-    setObjectName(QStringLiteral("Quicken logging"));  // Thread name.
+    setObjectName(QStringLiteral("Quicken logger"));  // Thread name.
 #endif
     start();
 }
 
-LoggingThread::~LoggingThread()
+LoggerWorker::~LoggerWorker()
+{
+    release(false);
+    wait();
+
+    free(m_queue);
+}
+
+// Requests the worker to leave once the pending metrics are delivered, without
+// waiting for it. The logger is deleted by the worker before leaving if
+// freeLogger is true.
+void LoggerWorker::release(bool freeLogger)
 {
+    m_flags.fetchAndOrOrdered(freeLogger ? JoinRequested | FreeLogger : JoinRequested);
     m_mutex.lock();
-    m_flags |= JoinRequested;
-    if (m_flags & Waiting) {
+    m_condition.wakeOne();
+    m_mutex.unlock();
+}
+
+// Logger worker entry point.
+void LoggerWorker::run()
+{
+    QuickenThreadSampler::addThreadTags(QuickenThreadMetrics::Logger);
+    while (true) {
+        // Same handshake as the logging thread, see LoggingThread::run().
+        quint32 head = m_queueHead.load();
+        if (m_queueTail.loadAcquire() == head) {
+            m_mutex.lock();
+            m_flags.fetchAndOrOrdered(Waiting);
+            if (m_queueTail.loadAcquire() == head && !(m_flags.load() & JoinRequested)) {
+                m_condition.wait(&m_mutex, logFlushInterval);
+            }
+            m_flags.fetchAndAndOrdered(~Waiting);
+            m_mutex.unlock();
+        }
+
+        const quint32 tail = m_queueTail.loadAcquire();
+        if (tail == head) {
+            if (m_flags.load() & JoinRequested) {
+                break;
+            }
+            continue;
+        }
+        while (head != tail) {
+            const quint32 index = head & m_queueMask;
+            const quint32 count = qMin(tail - head, m_queueSize - index);
+            m_logger->logBatch(&m_queue[index], count);
+            head += count;
+            m_queueHead.storeRelease(head);
+            m_deliveredCount.fetchAndAddRelaxed(count);
+
+            // Pairs with the ProducerWaiting flag set by the logging thread
+            // before its last check of the free room, see push().
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_flags.load() & ProducerWaiting) {
+                m_mutex.lock();
+                m_spaceCondition.wakeOne();
+                m_mutex.unlock();
+            }
+        }
+    }
+    if (m_flags.load() & FreeLogger) {
+        delete m_logger;
+    }
+    QuickenThreadSampler::removeThreadTags(QuickenThreadMetrics::Logger);
+}
+
+// Called by the logging thread only. Waits for room in the queue if block is
+// true, drops the metrics that don't fit otherwise.
+void LoggerWorker::push(const QuickenMetrics* metrics, int count, bool block)
+{
+    DASSERT(count > 0);
+    DASSERT(static_cast<quint32>(count) <= m_queueSize);
+
+    const quint32 tail = m_queueTail.load();
+    quint32 freeCount = m_queueSize - (tail - m_queueHead.loadAcquire());
+    while (block && freeCount < static_cast<quint32>(count)) {
+        m_mutex.lock();
+        m_flags.fetchAndOrOrdered(ProducerWaiting);
+        freeCount = m_queueSize - (tail - m_queueHead.loadAcquire());
+        if (freeCount < static_cast<quint32>(count)) {
+            m_spaceCondition.wait(&m_mutex, logFlushInterval);
+        }
+        m_flags.fetchAndAndOrdered(~ProducerWaiting);
+        m_mutex.unlock();
+        freeCount = m_queueSize - (tail - m_queueHead.loadAcquire());
+    }
+    const quint32 size = qMin(static_cast<quint32>(count), freeCount);
+    if (size < static_cast<quint32>(count)) {
+        m_droppedCount.fetchAndAddRelaxed(count - size);
+    }
+    if (size == 0) {
+        return;
+    }
+
+    const quint32 index = tail & m_queueMask;
+    const quint32 firstSize = qMin(size, m_queueSize - index);
+    memcpy(&m_queue[index], metrics, firstSize * sizeof(QuickenMetrics));
+    memcpy(m_queue, &metrics[firstSize], (size - firstSize) * sizeof(QuickenMetrics));
+    m_queueTail.storeRelease(tail + size);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_flags.load() & Waiting) {
+        m_mutex.lock();
         m_condition.wakeOne();
+        m_mutex.unlock();
+    }
+}
+
+void LoggerWorker::statistics(QuickenApplicationMonitor::LoggerStatistics* statistics) const
+{
+    statistics->pendingCount = m_queueTail.loadAcquire() - m_queueHead.loadAcquire();
+    statistics->droppedCount = m_droppedCount.loadAcquire();
+    statistics->deliveredCount = m_deliveredCount.loadAcquire();
+}
+
+LoggingThread::LoggingThread(int queueSize, QuickenApplicationMonitor::LoggingQueuePolicy policy)
+    : m_refCount(1)
+    , m_flags(0)
+    , m_policy(policy)
+    , m_droppedCount(0)
+    , m_queueSize(queueSize)
+    , m_queueMask(queueSize - 1)
+    , m_batchSize(queueSize / 2)
+    , m_queueWaitingHead(0)
+    , m_queueTail(0)
+    , m_queueHead(0)
+{
+    DASSERT(queueSize >= QuickenApplicationMonitorPrivate::minLoggingQueueSize);
+    DASSERT(IS_POWER_OF_TWO(queueSize));
+
+    m_queue = static_cast<QuickenMetrics*>(
+        alignedAlloc(logQueueAlignment, m_queueSize * sizeof(QuickenMetrics)));
+    m_queueSequences = new QAtomicInteger<quint32>[m_queueSize];
+    for (quint32 i = 0; i < m_queueSize; ++i) {
+        m_queueSequences[i].store(i);
     }
+
+#if !defined(QT_NO_DEBUG)
+    setObjectName(QStringLiteral("Quicken logging"));  // Thread name.
+#endif
+    start();
+}
+
+LoggingThread::~LoggingThread()
+{
+    m_flags.fetchAndOrOrdered(JoinRequested);
+    m_mutex.lock();
+    m_condition.wakeOne();
     m_mutex.unlock();
     wait();
 
+    qDeleteAll(m_workers);
+    qDeleteAll(m_releasedWorkers);
+    delete [] m_queueSequences;
     free(m_queue);
 }
 
-#define BREAK_ON_JOIN_REQUEST()                \
-    if (Q_UNLIKELY(m_flags & JoinRequested)) { \
-        m_mutex.unlock();                      \
-        break;                                 \
+// Claims the slot at the given position of the queue. Returns false if the
+// slot isn't ready to be read.
+bool LoggingThread::claim(quint32 position)
+{
+    QAtomicInteger<quint32>& sequence = m_queueSequences[position & m_queueMask];
+    return sequence.loadAcquire() == position + 1
+        && sequence.testAndSetAcquire(position + 1, position + 2);
+}
+
+// Claims the slot at the head of the queue, skipping the slots dropped by the
+// producers. Returns false if the queue is empty.
+bool LoggingThread::claimHead()
+{
+    while (true) {
+        if (claim(m_queueHead)) {
+            return true;
+        }
+        const quint32 value = m_queueSequences[m_queueHead & m_queueMask].loadAcquire();
+        if (static_cast<qint32>(value - m_queueHead) >= static_cast<qint32>(m_queueSize)) {
+            m_queueHead++;
+        } else if (value != m_queueHead + 1) {
+            return false;
+        }
+        // Otherwise, the slot was dropped while being claimed, try again.
+    }
+}
+
+// Delivers the ready metrics to the logger workers as contiguous batches, a
+// batch stopping at the end of the ring or at the first slot not ready. Returns
+// the number of metrics delivered.
+int LoggingThread::deliver()
+{
+    int deliveredCount = 0;
+
+    // The workers mutex is never taken by producers, it just prevents workers
+    // from being removed while in use.
+    m_workersMutex.lock();
+    const int workerCount = m_workers.size();
+    const bool block = m_policy.loadAcquire() == QuickenApplicationMonitor::BlockProducer;
+    while (deliveredCount < static_cast<int>(m_queueSize) && claimHead()) {
+        const quint32 index = m_queueHead & m_queueMask;
+        quint32 count = 1;
+        while (index + count < m_queueSize && claim(m_queueHead + count)) {
+            count++;
+        }
+        for (int i = 0; i < workerCount; ++i) {
+            m_workers[i]->push(&m_queue[index], count, block);
+        }
+        for (quint32 i = 0; i < count; ++i) {
+            m_queueSequences[index + i].storeRelease(m_queueHead + i + m_queueSize);
+        }
+        m_queueHead += count;
+        deliveredCount += count;
     }
+    m_workersMutex.unlock();
+
+    return deliveredCount;
+}
 
 // Logging thread entry point.
 void LoggingThread::run()
 {
     DLOG("Entering logging thread.");
+    QuickenThreadSampler::addThreadTags(QuickenThreadMetrics::Logging);
     while (true) {
-        // Wait for new metrics in the log queue.
-        m_mutex.lock();
-        DASSERT(m_queueSize >= 0);
-        if (m_queueSize == 0) {
-            BREAK_ON_JOIN_REQUEST();
-            m_flags |= Waiting;
-            m_condition.wait(&m_mutex);
-            if (m_queueSize == 0) {
-                BREAK_ON_JOIN_REQUEST();
+        // Wait for a batch of metrics to be queued or for the flush interval to
+        // elapse. The Waiting flag must be set before checking the queue a last
+        // time so that a producer either sees the flag and wakes us up or
+        // pushes metrics seen by that last check.
+        if (m_queueTail.load() - m_queueHead < m_batchSize) {
+            m_mutex.lock();
+            m_queueWaitingHead.storeRelease(m_queueHead);
+            m_flags.fetchAndOrOrdered(Waiting);
+            if (m_queueTail.load() - m_queueHead < m_batchSize
+                && !(m_flags.load() & JoinRequested)) {
+                m_condition.wait(&m_mutex, logFlushInterval);
             }
-            m_flags &= ~Waiting;
+            m_flags.fetchAndAndOrdered(~Waiting);
+            m_mutex.unlock();
         }
 
-        // Unqueue oldest metrics from the log queue.
-        DASSERT(m_queueSize > 0);
-        QuickenMetrics metrics;
-        memcpy(&metrics, &m_queue[m_queueIndex], sizeof(QuickenMetrics));
-        m_queueIndex = (m_queueIndex + 1) % logQueueSize;
-        m_queueSize--;
-
-        // Log.
-        const int loggerCount = m_loggerCount;
-        QuickenLogger* loggers[QuickenApplicationMonitorPrivate::maxLoggers];
-        memcpy(loggers, m_loggers, loggerCount * sizeof(QuickenLogger*));
-        m_mutex.unlock();
-        for (int i = 0; i < loggerCount; ++i) {
-            loggers[i]->log(metrics);
+        if (deliver() == 0 && (m_flags.load() & JoinRequested)) {
+            break;
         }
     }
+    QuickenThreadSampler::removeThreadTags(QuickenThreadMetrics::Logging);
     DLOG("Leaving logging thread.");
 }
 
 void LoggingThread::push(const QuickenMetrics* metrics)
 {
-    // Ensure the log queue is not full.
-    m_mutex.lock();
-    DASSERT(m_queueSize <= logQueueSize);
-    while (m_queueSize == logQueueSize) {
-        m_mutex.unlock();
-        QThread::yieldCurrentThread();
-        m_mutex.lock();
+    // Reserve a slot by moving the tail forward.
+    quint32 position = m_queueTail.load();
+    while (true) {
+        QAtomicInteger<quint32>& sequence = m_queueSequences[position & m_queueMask];
+        const quint32 value = sequence.loadAcquire();
+        const qint32 difference = static_cast<qint32>(value - position);
+        if (difference == 0) {
+            if (m_queueTail.testAndSetRelaxed(position, position + 1, position)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The log queue is full.
+            const quint32 policy = m_policy.loadAcquire();
+            if (policy == QuickenApplicationMonitor::DropOldest
+                && value == position - m_queueSize + 1) {
+                // Make room by dropping the unread metrics stored in the slot
+                // we need, unless the logging thread started to read it.
+                if (sequence.testAndSetOrdered(value, position)) {
+                    m_droppedCount.fetchAndAddRelaxed(1);
+                }
+            } else if (policy != QuickenApplicationMonitor::BlockProducer) {
+                m_droppedCount.fetchAndAddRelaxed(1);
+                return;
+            } else {
+                // Wait for the logging thread to release the oldest slot.
+                QThread::yieldCurrentThread();
+            }
+            position = m_queueTail.load();
+        } else {
+            // Another producer reserved that slot in the meantime.
+            position = m_queueTail.load();
+        }
     }
 
-    // Push metrics to the log queue.
-    DASSERT(m_queueSize < logQueueSize);
-    memcpy(&m_queue[(m_queueIndex + m_queueSize++) % logQueueSize], metrics,
-           sizeof(QuickenMetrics));
-    if (m_flags & Waiting) {
+    // Push metrics to the log queue and publish the slot.
+    const quint32 index = position & m_queueMask;
+    memcpy(&m_queue[index], metrics, sizeof(QuickenMetrics));
+    m_queueSequences[index].storeRelease(position + 1);
+
+    // Pairs with the Waiting flag set by the logging thread before its last
+    // check of the queue. The logging thread is only woken up once a batch is
+    // ready, smaller batches are delivered at the next flush interval.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Q_UNLIKELY(m_flags.load() & Waiting)
+        && position + 1 - m_queueWaitingHead.loadAcquire() >= m_batchSize) {
+        m_mutex.lock();
         m_condition.wakeOne();
+        m_mutex.unlock();
     }
-    m_mutex.unlock();
 }
 
-void LoggingThread::setLoggers(QuickenLogger** loggers, int count)
+void LoggingThread::setLoggers(const QVector<QuickenLogger*>& loggers, bool free)
 {
-    DASSERT(count >= 0);
-    DASSERT(count <= QuickenApplicationMonitorPrivate::maxLoggers);
+    // Workers of the loggers still installed are kept. Removed ones are
+    // released once the logging thread stopped using them. If the removed
+    // loggers must be freed, the workers delete them after delivering their
+    // pending metrics and are reaped once finished, at the next call or at
+    // destruction, so that a logger stuck in a write doesn't block the caller.
+    // Otherwise, the caller still owns the loggers and the workers must be
+    // joined right away.
+    QVector<LoggerWorker*> workers;
+    workers.reserve(loggers.size());
+    m_workersMutex.lock();
+    for (int i = 0; i < loggers.size(); ++i) {
+        LoggerWorker* worker = nullptr;
+        for (int j = 0; j < m_workers.size(); ++j) {
+            if (m_workers[j]->logger() == loggers[i]) {
+                worker = m_workers[j];
+                m_workers.remove(j);
+                break;
+            }
+        }
+        workers.append(worker ? worker : new LoggerWorker(loggers[i], m_queueSize));
+    }
+    m_workers.swap(workers);
+    m_workersMutex.unlock();
 
-    QMutexLocker locker(&m_mutex);
-    memcpy(m_loggers, loggers, count * sizeof(QuickenLogger*));
-    m_loggerCount = count;
+    for (int i = 0; i < workers.size(); ++i) {
+        if (free) {
+            workers[i]->release(true);
+            m_releasedWorkers.append(workers[i]);
+        } else {
+            delete workers[i];
+        }
+    }
+    for (int i = m_releasedWorkers.size() - 1; i >= 0; --i) {
+        if (m_releasedWorkers[i]->isFinished()) {
+            delete m_releasedWorkers[i];
+            m_releasedWorkers.remove(i);
+        }
+    }
+}
+
+bool LoggingThread::loggerStatistics(
+    QuickenLogger* logger, QuickenApplicationMonitor::LoggerStatistics* statistics)
+{
+    QMutexLocker locker(&m_workersMutex);
+    for (int i = 0; i < m_workers.size(); ++i) {
+        if (m_workers[i]->logger() == logger) {
+            m_workers[i]->statistics(statistics);
+            return true;
+        }
+    }
+    return false;
 }
 
 LoggingThread* LoggingThread::ref()
@@ -150,15 +438,15 @@ QuickenApplicationMonitor::QuickenApplicationMonitor()
 QuickenApplicationMonitorPrivate::QuickenApplicationMonitorPrivate(
     QuickenApplicationMonitor* applicationMonitor)
     : q_ptr(applicationMonitor)
-#if !defined(QT_NO_DEBUG)
-    , m_monitors{}
-    , m_loggers{}
-#endif
+    , m_monitorRegistry(new MonitorRegistry)
+    , m_registryEpoch(0)
     , m_loggingThread(nullptr)
-    , m_monitorCount(0)
-    , m_loggerCount(0)
-    , m_updateInterval{1000, -1, -1}
+    , m_updateInterval{1000, -1, -1, -1, -1, -1, -1, -1, 1000, -1, -1, -1}
+    , m_bindingHotspotCount(10)
+    , m_loggingQueueSize(16)
+    , m_loggingQueuePolicy(QuickenApplicationMonitor::BlockProducer)
     , m_flags(QuickenApplicationMonitor::AllMetrics)
+    , m_processUpdates(false)
 {
     Q_Q(QuickenApplicationMonitor);
 
@@ -173,8 +461,12 @@ QuickenApplicationMonitorPrivate::QuickenApplicationMonitorPrivate(
     QObject::connect(application, SIGNAL(lastWindowClosed()), q, SLOT(closeDown()));
     QObject::connect(application, SIGNAL(aboutToQuit()), q, SLOT(closeDown()));
     QObject::connect(&m_processTimer, SIGNAL(timeout()), q, SLOT(processTimeout()));
+    QObject::connect(&m_memoryTimer, SIGNAL(timeout()), q, SLOT(memoryTimeout()));
+    QObject::connect(&m_bindingTimer, SIGNAL(timeout()), q, SLOT(bindingTimeout()));
 
     m_processTimer.setInterval(m_updateInterval[QuickenMetrics::Process]);
+    m_bindingTimer.setInterval(m_updateInterval[QuickenMetrics::Binding]);
+    memset(&m_processMetrics, 0, sizeof(QuickenMetrics));
 }
 
 QuickenApplicationMonitor::~QuickenApplicationMonitor()
@@ -186,6 +478,8 @@ QuickenApplicationMonitorPrivate::~QuickenApplicationMonitorPrivate()
 {
     DASSERT(!(m_flags & Started));
 
+    delete m_monitorRegistry.load();
+
     // Note that there's no need to disconnect from QGuiApplication signals
     // since the application monitor instance is automatically destroyed when
     // the application is destroyed (parenting), the application instance would
@@ -260,17 +554,65 @@ void QuickenApplicationMonitorPrivate::startMonitoring(QQuickWindow* window)
     ASSERT_X(window->rendererInterface()->graphicsApi() == QSGRendererInterface::OpenGL,
              "Quicken: Scenegraph graphics API other than OpenGL not supported yet.");
 
-    if (m_monitorCount < maxMonitors) {
-        DASSERT(m_monitors[m_monitorCount] == nullptr);
-        static quint32 id = 0;
-        m_monitors[m_monitorCount] =
-            new WindowMonitor(q_func(), window, m_loggingThread->ref(), m_flags, ++id);
-        m_metricsUtils.updateProcessMetrics(&m_processMetrics);
-        m_monitors[m_monitorCount]->setProcessMetrics(m_processMetrics);
-        m_monitorCount++;
-    } else {
-        WARN("ApplicationMonitor: Can't monitor more than %d QQuickWindows.", maxMonitors);
+    static quint32 id = 0;
+    WindowMonitor* monitor =
+        new WindowMonitor(q_func(), window, m_loggingThread->ref(), m_flags, ++id);
+    // Updating the process metrics here would advance the deltas without
+    // logging them, the overlay gets the ones of the latest update.
+    monitor->setProcessMetrics(m_processMetrics);
+
+    MonitorRegistry* registry = new MonitorRegistry(*m_monitorRegistry.load());
+    registry->monitors.append(monitor);
+    publishMonitors(registry);
+}
+
+MonitorRegistryReader::MonitorRegistryReader(
+    QuickenApplicationMonitorPrivate* applicationMonitor)
+    : m_applicationMonitor(applicationMonitor)
+{
+    DASSERT(applicationMonitor);
+
+    // The epoch is checked again once the reader is counted, a writer flipping
+    // it in between would otherwise wait for the readers of the wrong epoch.
+    while (true) {
+        m_epoch = applicationMonitor->m_registryEpoch.loadAcquire() & 1;
+        applicationMonitor->m_registryReaders[m_epoch].ref();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((applicationMonitor->m_registryEpoch.loadAcquire() & 1) == m_epoch) {
+            break;
+        }
+        applicationMonitor->m_registryReaders[m_epoch].deref();
+    }
+    m_registry = applicationMonitor->m_monitorRegistry.loadAcquire();
+}
+
+MonitorRegistryReader::~MonitorRegistryReader()
+{
+    m_applicationMonitor->m_registryReaders[m_epoch].deref();
+}
+
+// Publishes a new registry and frees the previous one once it can't be read
+// anymore. Must be called with the monitors mutex locked, and not while the
+// calling thread has a MonitorRegistryReader alive.
+void QuickenApplicationMonitorPrivate::publishMonitors(MonitorRegistry* registry)
+{
+    DASSERT(registry);
+
+    MonitorRegistry* previousRegistry = m_monitorRegistry.fetchAndStoreOrdered(registry);
+    const quint32 previousEpoch = m_registryEpoch.fetchAndAddOrdered(1) & 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (m_registryReaders[previousEpoch].loadAcquire() != 0) {
+        QThread::yieldCurrentThread();
     }
+    delete previousRegistry;
+}
+
+// Gets a copy of the monitors, for operations that could add or remove
+// monitors from the calling thread.
+QVector<WindowMonitor*> QuickenApplicationMonitorPrivate::monitors()
+{
+    MonitorRegistryReader reader(this);
+    return reader.monitors();
 }
 
 void QuickenApplicationMonitorPrivate::start()
@@ -278,8 +620,11 @@ void QuickenApplicationMonitorPrivate::start()
     DASSERT(!(m_flags & Started));
     DASSERT(!m_loggingThread);
 
-    m_loggingThread = new LoggingThread;
-    m_loggingThread->setLoggers(m_loggers, m_loggerCount);
+    m_loggingThread = new LoggingThread(m_loggingQueueSize, m_loggingQueuePolicy);
+    m_loggingThread->setLoggers(m_loggers);
+    QuickenThreadSampler::addThreadTags(QuickenThreadMetrics::Gui);
+    memset(&m_processMetrics, 0, sizeof(QuickenMetrics));
+    setProcessUpdates(m_flags | Started);
 
     QWindowList windows = QGuiApplication::allWindows();
     const int size = windows.size();
@@ -298,11 +643,15 @@ void QuickenApplicationMonitorPrivate::start()
     // Doing it here so that processTimeout can assert the monitoring started.
     m_flags |= Started;
 
-    memset(&m_processMetrics, 0, sizeof(QuickenMetrics));
     processTimeout();
     if (m_updateInterval[QuickenMetrics::Process] >= 0) {
         m_processTimer.start();
     }
+    if (m_updateInterval[QuickenMetrics::Memory] >= 0) {
+        memoryTimeout();
+        m_memoryTimer.start();
+    }
+    updateBindingTimer();
 }
 
 bool QuickenApplicationMonitorPrivate::removeMonitor(WindowMonitor* monitor)
@@ -310,25 +659,15 @@ bool QuickenApplicationMonitorPrivate::removeMonitor(WindowMonitor* monitor)
     DASSERT(monitor);
     DASSERT(monitor->window());
 
-    m_monitorsMutex.lock();
-    for (int i = 0; i < m_monitorCount; ++i) {
-        if (m_monitors[i] == monitor) {
-            m_monitorCount--;
-            if (i < m_monitorCount) {
-                memmove(&m_monitors[i], &m_monitors[i+1],
-                        (m_monitorCount-i) * sizeof(WindowMonitor*));
-            }
-#if !defined(QT_NO_DEBUG)
-            m_monitors[m_monitorCount] = nullptr;
-#endif
-            m_monitorsMutex.unlock();
-            
-            return true;
-        }
+    QMutexLocker locker(&m_monitorsMutex);
+    const int index = m_monitorRegistry.load()->monitors.indexOf(monitor);
+    if (index == -1) {
+        return false;
     }
-    m_monitorsMutex.unlock();
-
-    return false;
+    MonitorRegistry* registry = new MonitorRegistry(*m_monitorRegistry.load());
+    registry->monitors.remove(index);
+    publishMonitors(registry);
+    return true;
 }
 
 WindowMonitorDeleter::~WindowMonitorDeleter()
@@ -373,17 +712,19 @@ void QuickenApplicationMonitorPrivate::stop()
     if (m_updateInterval[QuickenMetrics::Process] >= 0) {
         m_processTimer.stop();
     }
+    if (m_updateInterval[QuickenMetrics::Memory] >= 0) {
+        m_memoryTimer.stop();
+    }
+    m_bindingTimer.stop();
+    m_bindingProfiler.detach();
+    QuickenAnimationTracker::uninstall();
 
     QGuiApplication::instance()->removeEventFilter(q_func());
 
-    // scheduleRenderJobs() could possibly execute jobs right now we must loop
-    // over a copy to avoid deadlocks.
-    WindowMonitor* monitorsCopy[maxMonitors];
-    m_monitorsMutex.lock();
-    int monitorCountCopy = m_monitorCount;
-    memcpy(monitorsCopy, m_monitors, m_monitorCount * sizeof(WindowMonitor*));
-    m_monitorsMutex.unlock();
-    for (int i = 0; i < monitorCountCopy; ++i) {
+    // scheduleRenderJobs() could possibly execute jobs right now, removing
+    // monitors, we must loop over a copy.
+    const QVector<WindowMonitor*> monitorsCopy = monitors();
+    for (int i = 0; i < monitorsCopy.size(); ++i) {
         stopMonitoring(monitorsCopy[i]);
     }
 
@@ -392,17 +733,14 @@ void QuickenApplicationMonitorPrivate::stop()
     m_loggingThread = nullptr;
 
     // Wait for window monitors complete deletion.
-    m_monitorsMutex.lock();
-    while (m_monitorCount > 0) {
+    while (!MonitorRegistryReader(this).monitors().isEmpty()) {
         // FIXME(loicm) Should we yield the thread here in the case of a
         //     threaded QtQuick renderer?
-        m_monitorsMutex.unlock();
         QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-        m_monitorsMutex.lock();
     }
-    m_monitorsMutex.unlock();
 
     m_flags &= ~Started;
+    setProcessUpdates(m_flags);
 }
 
 bool QuickenApplicationMonitorPrivate::hasMonitor(WindowMonitor* monitor)
@@ -410,15 +748,8 @@ bool QuickenApplicationMonitorPrivate::hasMonitor(WindowMonitor* monitor)
     DASSERT(monitor);
     DASSERT(monitor->window());
 
-    m_monitorsMutex.lock();
-    for (int i = 0; i < m_monitorCount; ++i) {
-        if (m_monitors[i] == monitor) {
-            m_monitorsMutex.unlock();
-            return true;
-        }
-    }
-    m_monitorsMutex.unlock();
-    return false;
+    MonitorRegistryReader reader(this);
+    return reader.monitors().contains(monitor);
 }
 
 WindowMonitorFlagSetter::~WindowMonitorFlagSetter()
@@ -435,16 +766,56 @@ WindowMonitorFlagSetter::~WindowMonitorFlagSetter()
     }
 }
 
+// The deltas of the process metrics (CPU usage, page faults, context switches
+// and I/O bytes) are computed from the previous update, their interval is
+// restarted when the updates get enabled so that the first one doesn't span
+// the time they were disabled.
+void QuickenApplicationMonitorPrivate::setProcessUpdates(quint32 flags)
+{
+    const bool processUpdates = (flags & Started)
+        && ((flags & Overlay)
+            || ((flags & Logging) && (flags & QuickenApplicationMonitor::ProcessMetrics)));
+    if (processUpdates && !m_processUpdates) {
+        m_metricsUtils.resetProcessMetrics();
+    }
+    m_processUpdates = processUpdates;
+}
+
+// The binding timer only runs while binding metrics are logged.
+void QuickenApplicationMonitorPrivate::updateBindingTimer()
+{
+    const bool bindingUpdates = (m_flags & Started) && (m_flags & Logging)
+        && (m_flags & QuickenApplicationMonitor::BindingMetrics)
+        && (m_updateInterval[QuickenMetrics::Binding] >= 0);
+    if (bindingUpdates && !m_bindingTimer.isActive()) {
+        m_bindingTimer.start();
+    } else if (!bindingUpdates && m_bindingTimer.isActive()) {
+        m_bindingTimer.stop();
+    }
+}
+
 void QuickenApplicationMonitorPrivate::setMonitoringFlags(quint32 flags)
 {
-    // scheduleRenderJobs() could possibly execute jobs right now we must loop
-    // over a copy to avoid deadlocks.
-    WindowMonitor* monitorsCopy[maxMonitors];
-    m_monitorsMutex.lock();
-    int monitorCountCopy = m_monitorCount;
-    memcpy(monitorsCopy, m_monitors, m_monitorCount * sizeof(WindowMonitor*));
-    m_monitorsMutex.unlock();
-    for (int i = 0; i < monitorCountCopy; ++i) {
+    setProcessUpdates(flags);
+    updateBindingTimer();
+
+    // Window monitors attach the binding profiler to their engine and install
+    // the animation tracker, they're removed as soon as logging is disabled
+    // since they have a cost.
+    if (!(flags & Logging) || !(flags & QuickenApplicationMonitor::BindingMetrics)) {
+        m_bindingProfiler.detach();
+    }
+    if (!(flags & Logging) || !(flags & QuickenApplicationMonitor::AnimationMetrics)) {
+        QuickenAnimationTracker::uninstall();
+    }
+
+    // Milestones recorded while logging was disabled.
+    logStartupMilestones();
+
+    // scheduleRenderJobs() could possibly execute jobs right now, removing
+    // monitors, we must loop over a copy.
+    const QVector<WindowMonitor*> monitorsCopy = monitors();
+    for (int i = 0; i < monitorsCopy.size(); ++i) {
         DASSERT(monitorsCopy[i]);
         DASSERT(monitorsCopy[i]->window());
         monitorsCopy[i]->window()->scheduleRenderJob(
@@ -458,6 +829,9 @@ void QuickenApplicationMonitor::setLoggingFilter(QuickenApplicationMonitor::Logg
 
     const quint32 maskedFilter = filter & QuickenApplicationMonitorPrivate::FilterMask;
     if (maskedFilter != (d->m_flags & QuickenApplicationMonitorPrivate::FilterMask)) {
+        if ((maskedFilter & BindingMetrics) && !QuickenBindingProfiler::isAvailable()) {
+            WARN("ApplicationMonitor: Binding metrics require Qt to be built with QML debugging.");
+        }
         d->m_flags = (d->m_flags & ~QuickenApplicationMonitorPrivate::FilterMask) | maskedFilter;
         if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
             d->setMonitoringFlags(d->m_flags);
@@ -474,26 +848,18 @@ QuickenApplicationMonitor::LoggingFilters QuickenApplicationMonitor::loggingFilt
 
 QList<QuickenLogger*> QuickenApplicationMonitor::loggers()
 {
-    Q_D(QuickenApplicationMonitor);
-
-    QList<QuickenLogger*> list;
-    const int count = d->m_loggerCount;
-    for (int i = 0; i < count; ++i) {
-        list.append(d->m_loggers[i]);
-    }
-    return list;
+    return d_func()->m_loggers.toList();
 }
 
 bool QuickenApplicationMonitor::installLogger(QuickenLogger* logger)
 {
     Q_D(QuickenApplicationMonitor);
 
-    if (d->m_loggerCount < QuickenApplicationMonitorPrivate::maxLoggers && logger) {
-        DASSERT(d->m_loggers[d->m_loggerCount] == nullptr);
-        d->m_loggers[d->m_loggerCount++] = logger;
+    if (logger && !d->m_loggers.contains(logger)) {
+        d->m_loggers.append(logger);
         if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
             DASSERT(d->m_loggingThread);
-            d->m_loggingThread->setLoggers(d->m_loggers, d->m_loggerCount);
+            d->m_loggingThread->setLoggers(d->m_loggers);
         }
         Q_EMIT loggersChanged();
         return true;
@@ -504,30 +870,17 @@ bool QuickenApplicationMonitor::installLogger(QuickenLogger* logger)
 
 bool QuickenApplicationMonitor::removeLogger(QuickenLogger* logger, bool free)
 {
-    if (!logger) {
-        return false;
-    }
-
     Q_D(QuickenApplicationMonitor);
 
-    for (int i = d->m_loggerCount; i > 0; --i) {
-        if (d->m_loggers[i] == logger) {
-            if (i < --d->m_loggerCount) {
-                d->m_loggers[i] = d->m_loggers[d->m_loggerCount];
-            }
-#if !defined(QT_NO_DEBUG)
-            d->m_loggers[d->m_loggerCount] = nullptr;
-#endif
-            if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
-                DASSERT(d->m_loggingThread);
-                d->m_loggingThread->setLoggers(d->m_loggers, d->m_loggerCount);
-            }
-            if (free) {
-                delete logger;
-            }
-            Q_EMIT loggersChanged();
-            return true;
+    if (logger && d->m_loggers.removeOne(logger)) {
+        if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
+            DASSERT(d->m_loggingThread);
+            d->m_loggingThread->setLoggers(d->m_loggers, free);
+        } else if (free) {
+            delete logger;
         }
+        Q_EMIT loggersChanged();
+        return true;
     }
     return false;
 }
@@ -536,18 +889,76 @@ void QuickenApplicationMonitor::clearLoggers(bool free)
 {
     Q_D(QuickenApplicationMonitor);
 
-    if (d->m_loggerCount > 0) {
-        if (free) {
-            const int count = d->m_loggerCount;
-            for (int i = 0; i < count; ++i) {
-                delete d->m_loggers[i];
-            }
+    if (!d->m_loggers.isEmpty()) {
+        const QVector<QuickenLogger*> loggers = d->m_loggers;
+        d->m_loggers.clear();
+        if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
+            DASSERT(d->m_loggingThread);
+            d->m_loggingThread->setLoggers(d->m_loggers, free);
+        } else if (free) {
+            qDeleteAll(loggers);
         }
-        d->m_loggerCount = 0;
         Q_EMIT loggersChanged();
     }
 }
 
+bool QuickenApplicationMonitor::loggerStatistics(
+    QuickenLogger* logger, LoggerStatistics* statistics)
+{
+    DASSERT(statistics);
+    Q_D(QuickenApplicationMonitor);
+
+    if (logger && (d->m_flags & QuickenApplicationMonitorPrivate::Started)) {
+        DASSERT(d->m_loggingThread);
+        return d->m_loggingThread->loggerStatistics(logger, statistics);
+    }
+    return false;
+}
+
+void QuickenApplicationMonitor::setLoggingQueueSize(int size)
+{
+    Q_D(QuickenApplicationMonitor);
+
+    const int boundedSize = qNextPowerOfTwo(static_cast<quint32>(
+        qBound(QuickenApplicationMonitorPrivate::minLoggingQueueSize, size,
+               QuickenApplicationMonitorPrivate::maxLoggingQueueSize) - 1));
+    if (boundedSize != d->m_loggingQueueSize) {
+        d->m_loggingQueueSize = boundedSize;
+        Q_EMIT loggingQueueSizeChanged();
+    }
+}
+
+int QuickenApplicationMonitor::loggingQueueSize()
+{
+    return d_func()->m_loggingQueueSize;
+}
+
+void QuickenApplicationMonitor::setLoggingQueuePolicy(LoggingQueuePolicy policy)
+{
+    Q_D(QuickenApplicationMonitor);
+
+    if (policy != d->m_loggingQueuePolicy) {
+        d->m_loggingQueuePolicy = policy;
+        if (d->m_flags & QuickenApplicationMonitorPrivate::Started) {
+            DASSERT(d->m_loggingThread);
+            d->m_loggingThread->setPolicy(policy);
+        }
+        Q_EMIT loggingQueuePolicyChanged();
+    }
+}
+
+QuickenApplicationMonitor::LoggingQueuePolicy QuickenApplicationMonitor::loggingQueuePolicy()
+{
+    return d_func()->m_loggingQueuePolicy;
+}
+
+quint32 QuickenApplicationMonitor::droppedMetricsCount()
+{
+    Q_D(QuickenApplicationMonitor);
+
+    return d->m_loggingThread ? d->m_loggingThread->droppedCount() : 0;
+}
+
 quint32 QuickenApplicationMonitor::registerGenericMetrics()
 {
     static quint32 id = 0;  // 0 is reserved for QuickenApplicationMonitor metrics.
@@ -580,22 +991,39 @@ void QuickenApplicationMonitor::setUpdateInterval(QuickenMetrics::Type type, int
 {
     Q_D(QuickenApplicationMonitor);
 
+    QTimer* timer;
     if (type == QuickenMetrics::Process) {
-        // Other types (like QuickenMetrics::Frame) are ignored for now.
-        if (interval != d->m_updateInterval[QuickenMetrics::Process]) {
+        timer = &d->m_processTimer;
+    } else if (type == QuickenMetrics::Memory) {
+        timer = &d->m_memoryTimer;
+    } else if (type == QuickenMetrics::Binding) {
+        if (interval != d->m_updateInterval[type]) {
             if (interval >= 0) {
-                d->m_processTimer.setInterval(interval);
-                if ((d->m_flags & QuickenApplicationMonitorPrivate::Started)
-                    && (d->m_updateInterval[QuickenMetrics::Process] < 0)) {
-                    d->m_processTimer.start();
-                }
-            } else if ((d->m_flags & QuickenApplicationMonitorPrivate::Started)
-                       && (d->m_updateInterval[QuickenMetrics::Process] >= 0)) {
-                d->m_processTimer.stop();
+                d->m_bindingTimer.setInterval(interval);
             }
-            d->m_updateInterval[QuickenMetrics::Process] = interval;
-            Q_EMIT updateIntervalChanged(QuickenMetrics::Process);
+            d->m_updateInterval[type] = interval;
+            d->updateBindingTimer();
+            Q_EMIT updateIntervalChanged(type);
         }
+        return;
+    } else {
+        // Other types (like QuickenMetrics::Frame) are ignored for now.
+        return;
+    }
+
+    if (interval != d->m_updateInterval[type]) {
+        if (interval >= 0) {
+            timer->setInterval(interval);
+            if ((d->m_flags & QuickenApplicationMonitorPrivate::Started)
+                && (d->m_updateInterval[type] < 0)) {
+                timer->start();
+            }
+        } else if ((d->m_flags & QuickenApplicationMonitorPrivate::Started)
+                   && (d->m_updateInterval[type] >= 0)) {
+            timer->stop();
+        }
+        d->m_updateInterval[type] = interval;
+        Q_EMIT updateIntervalChanged(type);
     }
 }
 
@@ -604,6 +1032,22 @@ int QuickenApplicationMonitor::updateInterval(QuickenMetrics::Type type)
     return d_func()->m_updateInterval[type];
 }
 
+void QuickenApplicationMonitor::setBindingHotspotCount(int count)
+{
+    Q_D(QuickenApplicationMonitor);
+
+    count = qMax(0, count);
+    if (count != d->m_bindingHotspotCount) {
+        d->m_bindingHotspotCount = count;
+        Q_EMIT bindingHotspotCountChanged();
+    }
+}
+
+int QuickenApplicationMonitor::bindingHotspotCount()
+{
+    return d_func()->m_bindingHotspotCount;
+}
+
 void QuickenApplicationMonitor::closeDown()
 {
     Q_D(QuickenApplicationMonitor);
@@ -626,10 +1070,25 @@ void QuickenApplicationMonitorPrivate::processTimeout()
 
     const bool processLogging =
         (m_flags & Logging) && (m_flags & QuickenApplicationMonitor::ProcessMetrics);
+    const bool threadLogging =
+        (m_flags & Logging) && (m_flags & QuickenApplicationMonitor::ThreadMetrics);
     const bool overlay = m_flags & Overlay;
 
+    // Milestones recorded from other threads are logged here.
+    logStartupMilestones();
+
+    if (threadLogging || overlay) {
+        m_threadSampler.update(&m_threadMetrics);
+        if (threadLogging) {
+            for (int i = 0; i < m_threadMetrics.size(); ++i) {
+                m_loggingThread->push(&m_threadMetrics[i]);
+            }
+        }
+    }
+
     if (processLogging || overlay) {
         m_metricsUtils.updateProcessMetrics(&m_processMetrics);
+        m_processMetrics.process.droppedCount = m_loggingThread->droppedCount();
         if (processLogging) {
             m_loggingThread->push(&m_processMetrics);
         }
@@ -641,24 +1100,195 @@ void QuickenApplicationMonitorPrivate::processTimeout()
             //     update freqs. The former one implying locks and the second
             //     one dynamic memory allocations (placement new to the rescue?)
             //     and copies, and also I guess locks at the QtQuick level.
-            m_monitorsMutex.lock();
-            for (int i = 0; i < m_monitorCount; ++i) {
-                DASSERT(m_monitors[i]);
-                m_monitors[i]->setProcessMetrics(m_processMetrics);
+            MonitorRegistryReader reader(this);
+            const QVector<WindowMonitor*>& monitors = reader.monitors();
+            for (int i = 0; i < monitors.size(); ++i) {
+                DASSERT(monitors[i]);
+                monitors[i]->setThreadMetrics(m_threadMetrics);
+                monitors[i]->setProcessMetrics(m_processMetrics);
+            }
+        }
+    }
+}
+
+// Logs the startup milestones recorded since the previous call. Must be called
+// from the GUI thread.
+void QuickenApplicationMonitorPrivate::logStartupMilestones()
+{
+    if ((m_flags & Started) && (m_flags & Logging)
+        && (m_flags & QuickenApplicationMonitor::StartupMetrics)) {
+        DASSERT(m_loggingThread);
+        QuickenMetrics metrics[8];
+        int count;
+        while ((count = QuickenStartupTimeline::take(metrics, ARRAY_SIZE(metrics))) > 0) {
+            for (int i = 0; i < count; ++i) {
+                m_loggingThread->push(&metrics[i]);
             }
-            m_monitorsMutex.unlock();
         }
     }
 }
 
+// static.
+void QuickenApplicationMonitor::addStartupMilestone(
+    QuickenStartupMetrics::Milestone milestone, const char* name)
+{
+    if (milestone >= QuickenStartupMetrics::MilestoneCount) {
+        WARN("ApplicationMonitor: Invalid startup milestone.");
+        return;
+    }
+    if (milestone == QuickenStartupMetrics::Custom && !name) {
+        WARN("ApplicationMonitor: Custom startup milestones must be named.");
+        return;
+    }
+    if (QuickenStartupTimeline::add(milestone, name) && self
+        && QThread::currentThread() == self->thread()) {
+        self->d_func()->logStartupMilestones();
+    }
+}
+
+void QuickenApplicationMonitor::memoryTimeout()
+{
+    d_func()->memoryTimeout();
+}
+
+void QuickenApplicationMonitorPrivate::memoryTimeout()
+{
+    DASSERT(m_flags & Started);
+    DASSERT(m_loggingThread);
+
+    const bool memoryLogging =
+        (m_flags & Logging) && (m_flags & QuickenApplicationMonitor::MemoryMetrics);
+    const bool overlay = m_flags & Overlay;
+
+    if (memoryLogging || overlay) {
+        m_metricsUtils.updateMemoryMetrics(&m_memoryMetrics);
+        if (memoryLogging) {
+            m_loggingThread->push(&m_memoryMetrics);
+        }
+        if (overlay) {
+            MonitorRegistryReader reader(this);
+            const QVector<WindowMonitor*>& monitors = reader.monitors();
+            for (int i = 0; i < monitors.size(); ++i) {
+                DASSERT(monitors[i]);
+                monitors[i]->setMemoryMetrics(m_memoryMetrics);
+            }
+        }
+    }
+}
+
+void QuickenApplicationMonitor::bindingTimeout()
+{
+    d_func()->bindingTimeout();
+}
+
+void QuickenApplicationMonitorPrivate::bindingTimeout()
+{
+    DASSERT(m_flags & Started);
+    DASSERT(m_loggingThread);
+
+    if ((m_flags & Logging) && (m_flags & QuickenApplicationMonitor::BindingMetrics)) {
+        m_bindingMetrics.resize(m_bindingHotspotCount);
+        const int count = m_bindingProfiler.takeHotspots(
+            m_bindingMetrics.data(), m_bindingHotspotCount, QuickenMetricsUtils::timeStamp());
+        for (int i = 0; i < count; ++i) {
+            m_loggingThread->push(&m_bindingMetrics[i]);
+        }
+    }
+}
+
+// Gets the type and action of input events reported in the input metrics.
+// Returns false for other events, for mouse events synthesized from touch
+// events, already reported, and for double clicks, which follow the second
+// press.
+static bool inputEventType(
+    const QEvent* event, QuickenInputMetrics::Type* type, QuickenInputMetrics::Action* action)
+{
+    switch (event->type()) {
+    case QEvent::TouchBegin:
+        *type = QuickenInputMetrics::Touch;
+        *action = QuickenInputMetrics::Press;
+        return true;
+    case QEvent::TouchUpdate:
+        *type = QuickenInputMetrics::Touch;
+        *action = QuickenInputMetrics::Move;
+        return true;
+    case QEvent::TouchEnd:
+        *type = QuickenInputMetrics::Touch;
+        *action = QuickenInputMetrics::Release;
+        return true;
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::MouseButtonRelease:
+        if (static_cast<const QMouseEvent*>(event)->source() != Qt::MouseEventNotSynthesized) {
+            return false;
+        }
+        *type = QuickenInputMetrics::Mouse;
+        *action = event->type() == QEvent::MouseMove ? QuickenInputMetrics::Move
+            : event->type() == QEvent::MouseButtonRelease ? QuickenInputMetrics::Release
+            : QuickenInputMetrics::Press;
+        return true;
+    case QEvent::KeyPress:
+        *type = QuickenInputMetrics::Key;
+        *action = QuickenInputMetrics::Press;
+        return true;
+    case QEvent::KeyRelease:
+        *type = QuickenInputMetrics::Key;
+        *action = QuickenInputMetrics::Release;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Gets the time in nanoseconds elapsed since the creation of an input event.
+// Input event time stamps are in milliseconds. The X server and the Wayland
+// compositors take them from the monotonic clock, truncated to 32 bits. The
+// other platform plugins, like eglfs and linuxfb with the evdev and libinput
+// handlers, take them from a timer started with Qt, which can't be compared.
+// Returns 0 on these.
+static quint64 inputQueueingDelay(const QInputEvent* event)
+{
+    static const bool monotonicTimeStamps =
+        QGuiApplication::platformName() == QLatin1String("xcb")
+        || QGuiApplication::platformName().startsWith(QLatin1String("wayland"));
+    if (!monotonicTimeStamps) {
+        return 0;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const quint32 milliseconds = static_cast<quint32>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+    const quint32 delay = milliseconds - static_cast<quint32>(event->timestamp());
+    return delay <= maxInputQueueingDelay ? static_cast<quint64>(delay) * 1000000 : 0;
+}
+
 bool QuickenApplicationMonitor::eventFilter(QObject* object, QEvent* event)
 {
+    QuickenInputMetrics::Type type;
+    QuickenInputMetrics::Action action;
     if (event->type() == QEvent::Show) {
         if (QQuickWindow* window = qobject_cast<QQuickWindow*>(object)) {
             Q_D(QuickenApplicationMonitor);
             d->m_monitorsMutex.lock();
             d->startMonitoring(window);
             d->m_monitorsMutex.unlock();
+            addStartupMilestone(QuickenStartupMetrics::WindowShown);
+        }
+    } else if (inputEventType(event, &type, &action)) {
+        // Input events are delivered to the window first, then to its items.
+        Q_D(QuickenApplicationMonitor);
+        if ((d->m_flags & QuickenApplicationMonitorPrivate::Logging)
+            && (d->m_flags & InputMetrics) && object->isWindowType()) {
+            const quint64 timeStamp = QuickenMetricsUtils::timeStamp();
+            const quint64 queueingDelay = inputQueueingDelay(static_cast<QInputEvent*>(event));
+            MonitorRegistryReader reader(d);
+            const QVector<WindowMonitor*>& monitors = reader.monitors();
+            for (int i = 0; i < monitors.size(); ++i) {
+                if (monitors[i]->window() == object) {
+                    monitors[i]->addInputEvent(type, action, timeStamp, queueingDelay);
+                    break;
+                }
+            }
         }
     }
     return QObject::eventFilter(object, event);
@@ -680,7 +1310,8 @@ static const char* const defaultOverlayText =
     "  VSZ mem. : %9vszMemory kB\n"
     "  RSS mem. : %9rssMemory kB\n"
     "   Threads : %9threadCount   \n"
-    " CPU usage : %9cpuUsage %% ";
+    " CPU usage : %9cpuUsage %% \n"
+    "   Dropped : %9droppedCount   ";
 
 WindowMonitor::WindowMonitor(
     QuickenApplicationMonitor* applicationMonitor, QQuickWindow* window,
@@ -689,9 +1320,17 @@ WindowMonitor::WindowMonitor(
     , m_loggingThread(loggingThread)
     , m_window(window)
     , m_overlay(defaultOverlayText, id)
+    , m_cpuTime(0)
+    // Window monitors are created in the GUI thread.
+    , m_guiAllocationCounters(QuickenAllocationTracker::threadCounters())
     , m_id(id)
     , m_flags(flags)
     , m_frameSize(window->width(), window->height())
+    , m_collectionSentinelCpuTime(0)
+    , m_collectionSentinelCreated(false)
+    , m_javaScriptMetricsPending(false)
+    , m_animationCountsValid(false)
+    , m_animationMetricsPending(false)
 {
     DASSERT(applicationMonitor == QuickenApplicationMonitor::instance());
     DASSERT(m_applicationMonitor);
@@ -704,6 +1343,8 @@ WindowMonitor::WindowMonitor(
                      SLOT(windowSceneGraphInitialized()), Qt::DirectConnection);
     QObject::connect(window, SIGNAL(sceneGraphInvalidated()), this,
                      SLOT(windowSceneGraphInvalidated()), Qt::DirectConnection);
+    QObject::connect(window, SIGNAL(afterAnimating()), this, SLOT(windowAfterAnimating()),
+                     Qt::DirectConnection);
     QObject::connect(window, SIGNAL(beforeSynchronizing()), this,
                      SLOT(windowBeforeSynchronizing()), Qt::DirectConnection);
     QObject::connect(window, SIGNAL(afterSynchronizing()), this,
@@ -720,6 +1361,15 @@ WindowMonitor::WindowMonitor(
     memset(&m_frameMetrics, 0, sizeof(m_frameMetrics));
     m_frameMetrics.type = QuickenMetrics::Frame;
     m_frameMetrics.frame.window = id;
+    memset(&m_textureMetrics, 0, sizeof(m_textureMetrics));
+    m_textureMetrics.type = QuickenMetrics::Texture;
+    m_textureMetrics.texture.window = id;
+    memset(&m_javaScriptMetrics, 0, sizeof(m_javaScriptMetrics));
+    m_javaScriptMetrics.type = QuickenMetrics::JavaScript;
+    m_javaScriptMetrics.javaScript.window = id;
+    memset(&m_animationMetrics, 0, sizeof(m_animationMetrics));
+    m_animationMetrics.type = QuickenMetrics::Animation;
+    m_animationMetrics.animation.window = id;
 
     if ((flags & QuickenApplicationMonitorPrivate::Logging)
         && (flags & QuickenApplicationMonitor::WindowMetrics)) {
@@ -761,10 +1411,15 @@ void WindowMonitor::initializeGpuResources()
     //     that behavior programmatically.
     static bool noGpuTimer = qEnvironmentVariableIsSet("QUICKEN_NO_GPU_TIMER");
 
+    QuickenThreadSampler::addThreadTags(QuickenThreadMetrics::Render, m_id);
     m_overlay.initialize();
     m_gpuTimer.initialize();
     m_frameMetrics.frame.number = 0;
+    QuickenAllocationTracker::readCounters(
+        QuickenAllocationTracker::threadCounters(), &m_renderAllocationCounts);
+    QuickenAllocationTracker::readCounters(m_guiAllocationCounters, &m_guiAllocationCounts);
     m_flags |= GpuResourcesInitialized | (!noGpuTimer ? GpuTimerAvailable : 0);
+    updateOpenGLCounters();
 }
 
 void WindowMonitor::windowSceneGraphInitialized()
@@ -772,6 +1427,30 @@ void WindowMonitor::windowSceneGraphInitialized()
     if (!(m_flags & GpuResourcesInitialized)) {
         initializeGpuResources();
     }
+
+    // Only the first scene graph initialized and the first frame it swaps are
+    // recorded, the window monitor must have seen the initialization for that
+    // frame to be the first one.
+    if (QuickenStartupTimeline::add(QuickenStartupMetrics::SceneGraphInitialized)) {
+        m_flags |= FirstFrameMilestone;
+        logStartupMilestones();
+    }
+}
+
+// Logs the startup milestones recorded since the previous call from the
+// render thread.
+void WindowMonitor::logStartupMilestones()
+{
+    if ((m_flags & QuickenApplicationMonitorPrivate::Logging)
+        && (m_flags & QuickenApplicationMonitor::StartupMetrics)) {
+        QuickenMetrics metrics[8];
+        int count;
+        while ((count = QuickenStartupTimeline::take(metrics, ARRAY_SIZE(metrics))) > 0) {
+            for (int i = 0; i < count; ++i) {
+                m_loggingThread->push(&metrics[i]);
+            }
+        }
+    }
 }
 
 void WindowMonitor::finalizeGpuResources()
@@ -781,10 +1460,39 @@ void WindowMonitor::finalizeGpuResources()
     if (m_flags & GpuTimerAvailable) {
         m_gpuTimer.finalize();
     }
+    if (m_flags & OpenGLCountersAvailable) {
+        QuickenOpenGLCounters::uninstall();
+    }
     m_overlay.finalize();
+    QuickenThreadSampler::removeThreadTags(QuickenThreadMetrics::Render);
 
     m_frameMetrics.frame.number = 0;
-    m_flags &= ~(GpuResourcesInitialized | GpuTimerAvailable);
+    m_flags &= ~(GpuResourcesInitialized | GpuTimerAvailable | OpenGLCountersAvailable
+                 | OpenGLCountersUnavailable);
+}
+
+// Installs the OpenGL counters when the logging filter or the overlay require
+// them and uninstalls them otherwise, so that Qt's function table is only
+// hooked when needed. Must be called from the render thread with the context
+// current.
+void WindowMonitor::updateOpenGLCounters()
+{
+    const bool counters = (m_flags
+        & (QuickenApplicationMonitor::OpenGLMetrics | QuickenApplicationMonitor::TextureMetrics))
+        || ((m_flags & QuickenApplicationMonitorPrivate::Overlay)
+            && (m_overlay.requirements() & QuickenOverlay::OpenGLCountersRequired));
+    if (counters && !(m_flags & (OpenGLCountersAvailable | OpenGLCountersUnavailable))) {
+        m_flags |= QuickenOpenGLCounters::install()
+            ? OpenGLCountersAvailable : OpenGLCountersUnavailable;
+    } else if (!counters && (m_flags & OpenGLCountersAvailable)) {
+        QuickenOpenGLCounters::uninstall();
+        m_flags &= ~OpenGLCountersAvailable;
+        m_frameMetrics.frame.drawCalls = 0;
+        m_frameMetrics.frame.vertexBytes = 0;
+        m_frameMetrics.frame.indexBytes = 0;
+        memset(&m_textureMetrics.texture, 0, sizeof(m_textureMetrics.texture));
+        m_textureMetrics.texture.window = m_id;
+    }
 }
 
 void WindowMonitor::windowSceneGraphInvalidated()
@@ -794,10 +1502,167 @@ void WindowMonitor::windowSceneGraphInvalidated()
     }
 }
 
+// Gets the QML engine of the window or of its root item.
+static QQmlEngine* windowEngine(QQuickWindow* window)
+{
+    if (QQmlEngine* engine = qmlEngine(window)) {
+        return engine;
+    }
+    const QList<QQuickItem*> items = window->contentItem()->childItems();
+    for (int i = 0; i < items.size(); ++i) {
+        if (QQmlEngine* engine = qmlEngine(items[i])) {
+            return engine;
+        }
+    }
+    return nullptr;
+}
+
+// Samples the JavaScript heap of the window's engine in the GUI thread, once
+// animations have been advanced and right before the scene graph is synchronized
+// for the next frame. The V4 memory manager doesn't report collections, so a
+// sentinel QObject only referenced by a JavaScript wrapper is used to detect
+// them: collections queue unreferenced JavaScript owned objects for deletion.
+// A detected collection ran on the GUI thread since the previous check, the
+// CPU time the thread used since then bounds its duration.
+void WindowMonitor::updateJavaScriptMetrics()
+{
+    DASSERT(m_engine);
+
+    const QV4::MemoryManager* memoryManager = QV8Engine::getV4(m_engine.data())->memoryManager;
+    QuickenJavaScriptMetrics& javaScript = m_javaScriptMetrics.javaScript;
+    const quint32 usedMemory = memoryManager->getUsedMem() / 1024;
+    const quint64 cpuTime = QuickenMetricsUtils::threadCpuTime();
+    const bool collected =
+        m_collectionSentinelCreated && QQmlData::wasDeleted(m_collectionSentinel.data());
+    javaScript.collections = collected ? 1 : 0;
+    javaScript.collectionCount += javaScript.collections;
+    javaScript.collectionTimeBound = collected ? cpuTime - m_collectionSentinelCpuTime : 0;
+    m_collectionSentinelCpuTime = cpuTime;
+    javaScript.reclaimedMemory =
+        (collected && javaScript.usedMemory > usedMemory) ? javaScript.usedMemory - usedMemory : 0;
+    javaScript.usedMemory = usedMemory;
+    javaScript.largeItemMemory = memoryManager->getLargeItemsMem() / 1024;
+    javaScript.allocatedMemory = memoryManager->getAllocatedMem() / 1024;
+    m_javaScriptMetrics.timeStamp = QuickenMetricsUtils::timeStamp();
+    m_javaScriptMetricsPending = true;
+
+    if (collected || !m_collectionSentinelCreated) {
+        // The wrapper returned isn't kept, parentless objects get the
+        // JavaScript ownership.
+        QObject* sentinel = new QObject;
+        m_engine->newQObject(sentinel);
+        m_collectionSentinel = sentinel;
+        m_collectionSentinelCreated = true;
+    }
+}
+
+// Reads the animation ticks of the GUI thread since the previous frame of the
+// window, the animations having just been advanced for the frame.
+void WindowMonitor::updateAnimationMetrics()
+{
+    if (!QuickenAnimationTracker::install()) {
+        return;
+    }
+    const QuickenAnimationCounts& counts = QuickenAnimationTracker::counts();
+    if (m_animationCountsValid) {
+        QuickenAnimationMetrics& animation = m_animationMetrics.animation;
+        animation.runningAnimationCount = QuickenAnimationTracker::runningAnimationCount();
+        animation.tickCount = counts.tickCount - m_animationCounts.tickCount;
+        animation.advanceTime = counts.advanceTime - m_animationCounts.advanceTime;
+        animation.animationTime = counts.animationTime - m_animationCounts.animationTime;
+        animation.wallTime = counts.wallTime - m_animationCounts.wallTime;
+        animation.drift = static_cast<qint64>(animation.animationTime - animation.wallTime);
+        animation.totalDrift += animation.drift;
+        m_animationMetrics.timeStamp = QuickenMetricsUtils::timeStamp();
+        m_animationMetricsPending = true;
+    }
+    m_animationCounts = counts;
+    m_animationCountsValid = true;
+}
+
+void WindowMonitor::windowAfterAnimating()
+{
+    // The binding profiler and the animation tracker are removed by the
+    // application monitor as soon as their logging is disabled, its flags are
+    // checked instead of the window monitor ones, updated later by a render
+    // job, to not add them again.
+    QuickenApplicationMonitorPrivate* applicationMonitor =
+        QuickenApplicationMonitorPrivate::get(m_applicationMonitor);
+    const bool javaScriptLogging = (m_flags & QuickenApplicationMonitorPrivate::Logging)
+        && (m_flags & QuickenApplicationMonitor::JavaScriptMetrics);
+    const bool bindingLogging =
+        (applicationMonitor->m_flags & QuickenApplicationMonitorPrivate::Logging)
+        && (applicationMonitor->m_flags & QuickenApplicationMonitor::BindingMetrics);
+    const bool animationLogging =
+        (applicationMonitor->m_flags & QuickenApplicationMonitorPrivate::Logging)
+        && (applicationMonitor->m_flags & QuickenApplicationMonitor::AnimationMetrics);
+
+    if (animationLogging) {
+        updateAnimationMetrics();
+    }
+
+    if (javaScriptLogging || bindingLogging) {
+        if (!m_engine) {
+            m_engine = windowEngine(m_window);
+            if (!m_engine) {
+                return;
+            }
+        }
+        if (javaScriptLogging) {
+            updateJavaScriptMetrics();
+        }
+        if (bindingLogging) {
+            applicationMonitor->m_bindingProfiler.update(m_engine.data());
+        }
+    }
+}
+
+// Called by the GUI thread for each input event delivered to the window.
+void WindowMonitor::addInputEvent(
+    QuickenInputMetrics::Type type, QuickenInputMetrics::Action action, quint64 timeStamp,
+    quint64 queueingDelay)
+{
+    // Events arriving faster than frames (high frequency mice for instance)
+    // are dropped once the queue is full.
+    if (m_pendingInputEvents.size() < maxPendingInputEvents) {
+        const InputEvent inputEvent = { timeStamp, queueingDelay, type, action };
+        m_pendingInputEvents.append(inputEvent);
+    }
+}
+
 void WindowMonitor::windowBeforeSynchronizing()
 {
+    // The GUI thread is blocked while synchronizing, the JavaScript and
+    // animation metrics and the input events it has just set can be read.
+    if (m_javaScriptMetricsPending) {
+        m_javaScriptMetrics.javaScript.frame = m_frameMetrics.frame.number + 1;
+        m_loggingThread->push(&m_javaScriptMetrics);
+        m_javaScriptMetricsPending = false;
+    }
+    if (m_animationMetricsPending) {
+        m_animationMetrics.animation.frame = m_frameMetrics.frame.number + 1;
+        m_loggingThread->push(&m_animationMetrics);
+        m_animationMetricsPending = false;
+    }
+    if (!m_pendingInputEvents.isEmpty()) {
+        // Events that didn't lead to a frame in time are considered not to
+        // have changed anything on screen, the frame synchronized now being
+        // unrelated.
+        const quint64 timeStamp = QuickenMetricsUtils::timeStamp();
+        const int size = m_pendingInputEvents.size();
+        for (int i = 0; i < size; ++i) {
+            if (timeStamp - m_pendingInputEvents[i].timeStamp < maxInputLatency) {
+                m_syncedInputEvents.append(m_pendingInputEvents[i]);
+            }
+        }
+        m_pendingInputEvents.resize(0);
+    }
+
     if (m_flags & GpuResourcesInitialized) {
+        updateOpenGLCounters();
         m_sceneGraphTimer.start();
+        m_openGLCounts = QuickenOpenGLCounters::threadCounts();
+        m_flags |= Synchronized;
     }
 }
 
@@ -805,6 +1670,17 @@ void WindowMonitor::windowAfterSynchronizing()
 {
     if (m_flags & GpuResourcesInitialized) {
         m_frameMetrics.frame.syncTime = m_sceneGraphTimer.nsecsElapsed();
+        if (((m_flags & QuickenApplicationMonitor::SceneGraphMetrics)
+             && (m_flags & QuickenApplicationMonitorPrivate::Logging)
+             && (m_flags & QuickenApplicationMonitor::FrameMetrics))
+            || ((m_flags & QuickenApplicationMonitorPrivate::Overlay)
+                && (m_overlay.requirements() & QuickenOverlay::SceneGraphRequired))) {
+            updateSceneGraphMetrics();
+        } else {
+            m_frameMetrics.frame.opaqueNodes = 0;
+            m_frameMetrics.frame.alphaNodes = 0;
+            m_frameMetrics.frame.unmergeableNodes = 0;
+        }
     }
 }
 
@@ -827,6 +1703,10 @@ void WindowMonitor::windowBeforeRendering()
     }
 
     if (m_flags & GpuResourcesInitialized) {
+        // The render thread can render a frame without synchronizing first.
+        if (!(m_flags & Synchronized)) {
+            m_openGLCounts = QuickenOpenGLCounters::threadCounts();
+        }
         m_sceneGraphTimer.start();
         if (m_flags & GpuTimerAvailable) {
             m_gpuTimer.start();
@@ -840,26 +1720,224 @@ void WindowMonitor::windowAfterRendering()
         m_frameMetrics.frame.renderTime = m_sceneGraphTimer.nsecsElapsed();
         m_frameMetrics.frame.gpuTime = (m_flags & GpuTimerAvailable) ? m_gpuTimer.stop() : 0;
         m_frameMetrics.frame.number++;
+        m_flags &= ~Synchronized;
+        if (m_flags & OpenGLCountersAvailable) {
+            updateOpenGLMetrics();
+        }
         if (m_flags & QuickenApplicationMonitorPrivate::Overlay) {
             m_mutex.lock();
-            m_overlay.render(m_frameMetrics, m_frameSize);
+            m_overlay.render(m_frameMetrics, m_textureMetrics, m_frameSize);
             m_mutex.unlock();
         }
         m_sceneGraphTimer.start();
     }
 }
 
+static inline quint16 saturate16(quint64 value)
+{
+    return static_cast<quint16>(qMin(value, Q_UINT64_C(0xffff)));
+}
+
+static inline quint32 saturate32(quint64 value)
+{
+    return static_cast<quint32>(qMin(value, Q_UINT64_C(0xffffffff)));
+}
+
+static bool isTranslation(const QMatrix4x4& matrix)
+{
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 3; ++column) {
+            if (matrix(row, column) != (row == column ? 1.0f : 0.0f)) {
+                return false;
+            }
+        }
+    }
+    return matrix(3, 3) == 1.0f;
+}
+
+// Follows the criteria used by the batch renderer of Qt 5 to decide whether
+// the nodes of a batch can be merged in a single draw call.
+static bool isMergeable(
+    const QSGGeometry* geometry, QSGMaterial::Flags materialFlags, bool translateOnly)
+{
+    const unsigned int mode = geometry->drawingMode();
+    if ((mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_LINES
+         && mode != GL_POINTS) || geometry->indexType() != GL_UNSIGNED_SHORT) {
+        return false;
+    }
+    const int fullMatrix =
+        QSGMaterial::RequiresFullMatrix & ~QSGMaterial::RequiresFullMatrixExceptTranslate;
+    if ((materialFlags & (QSGMaterial::CustomCompileStep | fullMatrix))
+        || ((materialFlags & QSGMaterial::RequiresFullMatrixExceptTranslate) && !translateOnly)) {
+        return false;
+    }
+    // Vertices are merged by transforming a 2D float position attribute.
+    const QSGGeometry::Attribute* attributes = geometry->attributes();
+    for (int i = 0; i < geometry->attributeCount(); ++i) {
+        if (attributes[i].isVertexCoordinate && attributes[i].tupleSize == 2
+            && attributes[i].type == GL_FLOAT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct SceneGraphCounts
+{
+    quint32 opaqueNodes;
+    quint32 alphaNodes;
+    quint32 unmergeableNodes;
+};
+
+static void countGeometryNodes(QSGNode* node, bool translateOnly, SceneGraphCounts* counts)
+{
+    // Same limit as the batch renderer.
+    const float opaqueLimit = 0.999f;
+
+    if (node->isSubtreeBlocked()) {
+        return;
+    }
+    if (node->type() == QSGNode::TransformNodeType) {
+        translateOnly =
+            translateOnly && isTranslation(static_cast<QSGTransformNode*>(node)->matrix());
+    } else if (node->type() == QSGNode::GeometryNodeType) {
+        QSGGeometryNode* geometryNode = static_cast<QSGGeometryNode*>(node);
+        const QSGGeometry* geometry = geometryNode->geometry();
+        const QSGMaterial* material = geometryNode->activeMaterial();
+        if (geometry && material && geometry->vertexCount() > 0) {
+            const QSGMaterial::Flags flags = material->flags();
+            if (geometryNode->inheritedOpacity() > opaqueLimit
+                && !(flags & QSGMaterial::Blending)) {
+                counts->opaqueNodes++;
+            } else {
+                counts->alphaNodes++;
+            }
+            if (!isMergeable(geometry, flags, translateOnly)) {
+                counts->unmergeableNodes++;
+            }
+        }
+    }
+    for (QSGNode* child = node->firstChild(); child; child = child->nextSibling()) {
+        countGeometryNodes(child, translateOnly, counts);
+    }
+}
+
+// Walks the scene graph once synchronized, which has a cost proportional to the
+// number of nodes. The batches themselves are private to the batch renderer,
+// the geometry nodes are what they're built from.
+void WindowMonitor::updateSceneGraphMetrics()
+{
+    SceneGraphCounts counts = { 0, 0, 0 };
+    QSGRenderer* renderer = QQuickWindowPrivate::get(m_window)->renderer;
+    if (renderer && renderer->rootNode()) {
+        countGeometryNodes(renderer->rootNode(), true, &counts);
+    }
+    m_frameMetrics.frame.opaqueNodes = saturate16(counts.opaqueNodes);
+    m_frameMetrics.frame.alphaNodes = saturate16(counts.alphaNodes);
+    m_frameMetrics.frame.unmergeableNodes = saturate16(counts.unmergeableNodes);
+}
+
+// Sets the OpenGL calls of the render thread since the frame started, the
+// overlay being rendered afterwards isn't taken into account.
+void WindowMonitor::updateOpenGLMetrics()
+{
+    const QuickenOpenGLCounts& counts = QuickenOpenGLCounters::threadCounts();
+    m_frameMetrics.frame.drawCalls = saturate16(counts.drawCalls - m_openGLCounts.drawCalls);
+    m_frameMetrics.frame.vertexBytes =
+        saturate32(counts.vertexBytes - m_openGLCounts.vertexBytes);
+    m_frameMetrics.frame.indexBytes = saturate32(counts.indexBytes - m_openGLCounts.indexBytes);
+
+    QuickenTextureMetrics& texture = m_textureMetrics.texture;
+    texture.frame = m_frameMetrics.frame.number;
+    texture.uploadCount = counts.textureUploads - m_openGLCounts.textureUploads;
+    texture.uploadedBytes = counts.textureUploadedBytes - m_openGLCounts.textureUploadedBytes;
+    texture.atlasUploadCount = counts.atlasUploads - m_openGLCounts.atlasUploads;
+    texture.atlasUploadedBytes = counts.atlasUploadedBytes - m_openGLCounts.atlasUploadedBytes;
+    const QuickenOpenGLTextureCounts textureCounts = QuickenOpenGLCounters::textureCounts();
+    texture.textureCount = textureCounts.textureCount;
+    texture.textureMemory = textureCounts.textureMemory / 1024;
+    texture.atlasCount = textureCounts.atlasCount;
+    texture.atlasMemory = textureCounts.atlasMemory / 1024;
+}
+
+// Sets the allocation deltas of both the render and GUI threads since the last
+// frame swap. The GUI thread counters are read while it's possibly allocating,
+// which is fine since each counter is atomic.
+void WindowMonitor::updateAllocationMetrics()
+{
+    QuickenAllocationCounts renderCounts, guiCounts;
+    QuickenAllocationTracker::readCounters(
+        QuickenAllocationTracker::threadCounters(), &renderCounts);
+    QuickenAllocationTracker::readCounters(m_guiAllocationCounters, &guiCounts);
+
+    QuickenFrameMetrics& frame = m_frameMetrics.frame;
+    frame.renderAllocations =
+        renderCounts.allocationCount - m_renderAllocationCounts.allocationCount;
+    frame.renderFrees = renderCounts.freeCount - m_renderAllocationCounts.freeCount;
+    frame.renderAllocatedBytes =
+        renderCounts.allocatedBytes - m_renderAllocationCounts.allocatedBytes;
+    frame.guiAllocations = guiCounts.allocationCount - m_guiAllocationCounts.allocationCount;
+    frame.guiFrees = guiCounts.freeCount - m_guiAllocationCounts.freeCount;
+    frame.guiAllocatedBytes = guiCounts.allocatedBytes - m_guiAllocationCounts.allocatedBytes;
+    m_renderAllocationCounts = renderCounts;
+    m_guiAllocationCounts = guiCounts;
+}
+
+// Logs the latency of the input events synchronized for the frame just
+// swapped.
+void WindowMonitor::updateInputMetrics()
+{
+    QuickenMetrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.type = QuickenMetrics::Input;
+    metrics.timeStamp = QuickenMetricsUtils::timeStamp();
+    metrics.input.window = m_id;
+    metrics.input.frame = m_frameMetrics.frame.number;
+    const int size = m_syncedInputEvents.size();
+    for (int i = 0; i < size; ++i) {
+        const InputEvent& inputEvent = m_syncedInputEvents[i];
+        metrics.input.queueingDelay = inputEvent.queueingDelay;
+        metrics.input.latency =
+            metrics.timeStamp - inputEvent.timeStamp + inputEvent.queueingDelay;
+        metrics.input.type = inputEvent.type;
+        metrics.input.action = inputEvent.action;
+        m_loggingThread->push(&metrics);
+    }
+}
+
 void WindowMonitor::windowFrameSwapped()
 {
     if (m_flags & GpuResourcesInitialized) {
+        const quint64 cpuTime = QuickenMetricsUtils::processCpuTime();
         m_frameMetrics.frame.deltaTime = m_deltaTimer.isValid() ? m_deltaTimer.nsecsElapsed() : 0;
+        m_frameMetrics.frame.cpuTime = m_deltaTimer.isValid() ? cpuTime - m_cpuTime : 0;
         m_deltaTimer.start();
+        m_cpuTime = cpuTime;
+        updateAllocationMetrics();
         if ((m_flags & QuickenApplicationMonitorPrivate::Logging) &&
             (m_flags & QuickenApplicationMonitor::FrameMetrics)) {
             m_frameMetrics.frame.swapTime = m_sceneGraphTimer.nsecsElapsed();
             m_frameMetrics.timeStamp = QuickenMetricsUtils::timeStamp();
             m_loggingThread->push(&m_frameMetrics);
         }
+        if ((m_flags & QuickenApplicationMonitorPrivate::Logging)
+            && (m_flags & QuickenApplicationMonitor::TextureMetrics)
+            && (m_flags & OpenGLCountersAvailable)) {
+            m_textureMetrics.timeStamp = QuickenMetricsUtils::timeStamp();
+            m_loggingThread->push(&m_textureMetrics);
+        }
+        if (!m_syncedInputEvents.isEmpty()) {
+            if ((m_flags & QuickenApplicationMonitorPrivate::Logging)
+                && (m_flags & QuickenApplicationMonitor::InputMetrics)) {
+                updateInputMetrics();
+            }
+            m_syncedInputEvents.resize(0);
+        }
+        if (m_flags & FirstFrameMilestone) {
+            m_flags &= ~FirstFrameMilestone;
+            QuickenStartupTimeline::add(QuickenStartupMetrics::FirstFrameSwapped);
+            logStartupMilestones();
+        }
     } else {
         initializeGpuResources();  // Get everything ready for the next frame.
         if (m_flags & QuickenApplicationMonitorPrivate::Overlay) {
@@ -894,3 +1972,25 @@ void WindowMonitor::setProcessMetrics(const QuickenMetrics& metrics)
         m_window->update();
     }
 }
+
+void WindowMonitor::setMemoryMetrics(const QuickenMetrics& metrics)
+{
+    DASSERT(metrics.type == QuickenMetrics::Memory);
+
+    if (m_flags & QuickenApplicationMonitorPrivate::Overlay) {
+        m_mutex.lock();
+        m_overlay.setMemoryMetrics(metrics);
+        m_mutex.unlock();
+        m_window->update();
+    }
+}
+
+// Doesn't trigger a window update, expected to be followed by setProcessMetrics().
+void WindowMonitor::setThreadMetrics(const QVector<QuickenMetrics>& metrics)
+{
+    if (m_flags & QuickenApplicationMonitorPrivate::Overlay) {
+        m_mutex.lock();
+        m_overlay.setThreadMetrics(metrics.constData(), metrics.size());
+        m_mutex.unlock();
+    }
+}
@@ -25,18 +25,84 @@ class QUICKEN_EXPORT QuickenApplicationMonitor : public QObject
 public:
     enum LoggingFilter {
         // Allow process metrics logging.
-        ProcessMetrics = (1 << 0),
+        ProcessMetrics    = (1 << 0),
         // Allow window metrics logging.
-        WindowMetrics  = (1 << 1),
+        WindowMetrics     = (1 << 1),
         // Allow frame metrics logging.
-        FrameMetrics   = (1 << 2),
+        FrameMetrics      = (1 << 2),
         // Allow generic metrics logging.
-        GenericMetrics = (1 << 3),
-        // Allow all metrics logging.
-        AllMetrics     = (ProcessMetrics | WindowMetrics | FrameMetrics | GenericMetrics)
+        GenericMetrics    = (1 << 3),
+        // Allow thread metrics logging.
+        ThreadMetrics     = (1 << 4),
+        // Allow memory metrics logging.
+        MemoryMetrics     = (1 << 5),
+        // Allow texture metrics logging. Not part of AllMetrics since it
+        // counts the OpenGL calls like OpenGLMetrics.
+        TextureMetrics    = (1 << 6),
+        // Allow JavaScript metrics logging. Not part of AllMetrics since it
+        // samples the JavaScript heap at each frame and injects a sentinel
+        // QObject in the QML engine of each window to detect collections.
+        JavaScriptMetrics = (1 << 7),
+        // Allow binding metrics logging. Not part of AllMetrics since it
+        // profiles every binding evaluation of the QML engines, which has a
+        // cost. Requires Qt to be built with the QML debugging
+        // infrastructure.
+        BindingMetrics    = (1 << 8),
+        // Allow animation metrics logging. Not part of AllMetrics since it
+        // hooks the unified animation timer of the GUI thread.
+        AnimationMetrics  = (1 << 9),
+        // Allow input metrics logging. Not part of AllMetrics since it keeps
+        // track of each input event delivered to a window until its frame is
+        // swapped.
+        InputMetrics      = (1 << 10),
+        // Allow startup metrics logging. Milestones are one-off records,
+        // they're recorded anyway and logged once allowed.
+        StartupMetrics    = (1 << 11),
+        // Allow the draw calls and the vertex and index bytes of frame
+        // metrics. Not part of AllMetrics since the OpenGL calls are counted
+        // by hooking entries of the function table Qt shares between the
+        // QOpenGLFunctions of a context share group, restored once no window
+        // counts them anymore. Texture metrics count them too. The overlay
+        // counts them regardless of the filter when its text shows them.
+        OpenGLMetrics     = (1 << 12),
+        // Allow the geometry node counts of frame metrics. Not part of
+        // AllMetrics since the scene graph is walked after each
+        // synchronization, which adds to the sync time. The overlay walks it
+        // regardless of the filter when its text shows them.
+        SceneGraphMetrics = (1 << 13),
+        // Allow the logging of the metrics that don't add instrumentation:
+        // process, window, frame, generic, thread, memory and startup metrics.
+        AllMetrics        = (ProcessMetrics | WindowMetrics | FrameMetrics | GenericMetrics
+                             | ThreadMetrics | MemoryMetrics | StartupMetrics)
     };
     Q_DECLARE_FLAGS(LoggingFilters, LoggingFilter)
 
+    // The policy applies to the queue shared by all the loggers. With
+    // BlockProducer, a full logger queue blocks the delivery to all the
+    // loggers, and in turn the threads logging metrics once the shared queue
+    // is full. With the other policies, metrics that don't fit in a logger
+    // queue are dropped for that logger only (see loggerStatistics()).
+    enum LoggingQueuePolicy {
+        // Block the thread logging metrics until there's room in the queue.
+        BlockProducer = 0,
+        // Drop the metrics being logged.
+        DropNewest    = 1,
+        // Drop the oldest metrics not yet delivered to the loggers to make
+        // room. The metrics being logged are dropped instead if the oldest ones
+        // are being delivered.
+        DropOldest    = 2
+    };
+
+    // Statistics of the delivery of metrics to an installed logger.
+    struct LoggerStatistics {
+        // Number of metrics queued for the logger but not delivered yet.
+        quint32 pendingCount;
+        // Number of metrics dropped because the logger's queue was full.
+        quint32 droppedCount;
+        // Number of metrics delivered to the logger.
+        quint64 deliveredCount;
+    };
+
     // Get the unique QuickenApplicationMonitor instance. A QGuiApplication instance
     // must be running.
     static QuickenApplicationMonitor* instance() {
@@ -51,16 +117,45 @@ public:
     void setLogging(bool logging);
     bool logging();
 
-    // Set the logging filter. All metrics are logged by default.
+    // Set the logging filter. Default is AllMetrics, the metrics requiring
+    // additional instrumentation must be explicitly allowed.
     void setLoggingFilter(LoggingFilters filter);
     LoggingFilters loggingFilter();
 
-    // Set the loggers. Empty by default, max number of loggers is 8.
+    // Set the loggers. Empty by default, a logger can only be installed once.
+    // Each logger is fed by its own thread from its own queue, of the logging
+    // queue size, so that a slow logger doesn't delay the others unless the
+    // logging queue policy is BlockProducer. A logger removed while monitoring
+    // still gets its pending metrics. When freed, it's deleted asynchronously
+    // once they're delivered. Otherwise, removeLogger() and clearLoggers()
+    // block until they're delivered so that the caller can delete it.
     QList<QuickenLogger*> loggers();
     bool installLogger(QuickenLogger* logger);
     bool removeLogger(QuickenLogger* logger, bool free = true);
     void clearLoggers(bool free = true);
 
+    // Get the delivery statistics of an installed logger since monitoring
+    // started. Returns false if the logger isn't installed or if monitoring
+    // isn't started.
+    bool loggerStatistics(QuickenLogger* logger, LoggerStatistics* statistics);
+
+    // Set the size of the queue storing metrics until they are delivered to the
+    // loggers. The size is rounded up to the next power of two and bounded to
+    // [4, 65536], it's applied the next time monitoring starts. Default is 16.
+    void setLoggingQueueSize(int size);
+    int loggingQueueSize();
+
+    // Set what happens when logging metrics while the queue is full. Default is
+    // BlockProducer.
+    void setLoggingQueuePolicy(LoggingQueuePolicy policy);
+    LoggingQueuePolicy loggingQueuePolicy();
+
+    // Get the number of metrics dropped because the queue was full since
+    // monitoring started. Also reported in the process metrics. Metrics
+    // dropped by the queue of a logger, which never happens with the
+    // BlockProducer policy, are reported by loggerStatistics().
+    quint32 droppedMetricsCount();
+
     // Generic system allowing to log application specific
     // metrics. registerGenericMetrics() returns a unique integer id to be used
     // as first argument to logGenericMetrics(). logGenericMetrics() logs a
@@ -74,22 +169,51 @@ public:
     bool logGenericMetrics(quint32 id, const char* string, quint32 size);
 
     // Set the time in milliseconds between two updates of metrics of a given
-    // type. -1 to disable updates. Only QuickenMetrics::Process is accepted so
-    // far as metrics type, default value is 1000. Note that when the overlay is
-    // enabled, a process update triggers a frame update.
+    // type. -1 to disable updates. Only QuickenMetrics::Process,
+    // QuickenMetrics::Memory and QuickenMetrics::Binding are accepted so far as
+    // metrics types, default values are respectively 1000, -1 (memory metrics
+    // are expensive to update, see QuickenMetricsUtils::updateMemoryMetrics())
+    // and 1000. Thread metrics are updated along with process metrics, binding
+    // metrics only while they're logged. Note that when the overlay is
+    // enabled, a process or memory update triggers a frame update.
     void setUpdateInterval(QuickenMetrics::Type type, int interval);
     int updateInterval(QuickenMetrics::Type type);
 
+    // Set the number of binding metrics logged at each binding update, the
+    // bindings that took the most time since the previous update. Default is
+    // 10.
+    void setBindingHotspotCount(int count);
+    int bindingHotspotCount();
+
+    // Record a startup milestone, logged as startup metrics with the time
+    // elapsed since the start of the process. The library load, the
+    // application creation, the first window shown (if monitoring started
+    // before), the scene graph initialization and the first frame swap are
+    // recorded automatically, the other predefined milestones are left to the
+    // application. Predefined milestones are only recorded once. Custom
+    // milestones are described by a null-terminated name cut at
+    // QuickenStartupMetrics::maxNameSize. Milestones recorded while logging is
+    // disabled are logged once it's enabled, the ones recorded from threads
+    // other than the GUI thread are logged at the next process metrics update.
+    // Can be called before the QGuiApplication is created.
+    static void addStartupMilestone(
+        QuickenStartupMetrics::Milestone milestone, const char* name = nullptr);
+
 Q_SIGNALS:
     void overlayChanged();
     void loggingChanged();
     void loggingFilterChanged();
     void loggersChanged();
+    void loggingQueueSizeChanged();
+    void loggingQueuePolicyChanged();
     void updateIntervalChanged(QuickenMetrics::Type type);
+    void bindingHotspotCountChanged();
 
 private Q_SLOTS:
     void closeDown();
     void processTimeout();
+    void memoryTimeout();
+    void bindingTimeout();
 
 private:
     static QuickenApplicationMonitor* self;
@@ -16,20 +16,37 @@
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QRunnable>
 #include <QtCore/QAtomicInteger>
-
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QPointer>
+#include <QtCore/QVector>
+
+#include <Quicken/private/quickenallocationtracker_p.h>
+#include <Quicken/private/quickenanimationtracker_p.h>
+#include <Quicken/private/quickenbindingprofiler_p.h>
+#include <Quicken/private/quickenmetrics_p.h>
+#include <Quicken/private/quickenopenglcounters_p.h>
 #include <Quicken/private/quickenoverlay_p.h>
+#include <Quicken/private/quickenstartuptimeline_p.h>
 #include <Quicken/private/quickengputimer_p.h>
 #include <Quicken/private/quickenglobal_p.h>
 
 class LoggingThread;
 class WindowMonitor;
 class QQuickWindow;
+class QQmlEngine;
+
+// Immutable snapshot of the window monitors. A new snapshot is published at
+// each change and the previous one is freed once no reader can use it anymore.
+struct MonitorRegistry
+{
+    QVector<WindowMonitor*> monitors;
+};
 
 class QUICKEN_PRIVATE_EXPORT QuickenApplicationMonitorPrivate
 {
 public:
-    static const int maxMonitors = 16;
-    static const int maxLoggers = 8;
+    static const int minLoggingQueueSize = 4;
+    static const int maxLoggingQueueSize = 65536;
 
     static inline QuickenApplicationMonitorPrivate* get(
         QuickenApplicationMonitor* applicationMonitor) {
@@ -37,15 +54,15 @@ public:
     }
 
     enum {
-        // Lower bit allowed is (1 << 8).
-        Overlay     = (1 << 8),
-        Logging     = (1 << 9),
-        Started     = (1 << 10),
-        ClosingDown = (1 << 11),
-        // Higher bit allowed is (1 << 15).
-        FilterMask             = 0x000000ff,
-        ApplicationMonitorMask = 0x0000ff00,
-        WindowMonitorMask      = 0xffff0000
+        // Lower bit allowed is (1 << 14).
+        Overlay     = (1 << 14),
+        Logging     = (1 << 15),
+        Started     = (1 << 16),
+        ClosingDown = (1 << 17),
+        // Higher bit allowed is (1 << 17).
+        FilterMask             = 0x00003fff,
+        ApplicationMonitorMask = 0x0003c000,
+        WindowMonitorMask      = 0xfffc0000
     };
 
     QuickenApplicationMonitorPrivate(QuickenApplicationMonitor* applicationMonitor);
@@ -57,36 +74,124 @@ public:
     void stopMonitoring(WindowMonitor* monitor);
     void stop();
     bool hasMonitor(WindowMonitor* monitor);
+    QVector<WindowMonitor*> monitors();
+    void publishMonitors(MonitorRegistry* registry);
+    void setProcessUpdates(quint32 flags);
+    void updateBindingTimer();
     void setMonitoringFlags(quint32 flags);
     void processTimeout();
+    void memoryTimeout();
+    void bindingTimeout();
+    void logStartupMilestones();
 
     QuickenApplicationMonitor* const q_ptr;
     Q_DECLARE_PUBLIC(QuickenApplicationMonitor)
 
-    WindowMonitor* m_monitors[maxMonitors];
-    QuickenLogger* m_loggers[maxLoggers];
+    // The monitor registry can be read without locking from any thread, see
+    // MonitorRegistryReader. Writers are serialized by m_monitorsMutex.
+    QAtomicPointer<MonitorRegistry> m_monitorRegistry;
+    QAtomicInteger<quint32> m_registryEpoch;
+    QAtomicInteger<quint32> m_registryReaders[2];
+    QVector<QuickenLogger*> m_loggers;
     LoggingThread* m_loggingThread;
 #if !defined(QT_NO_DEBUG)
     QGuiApplication* m_application;
 #endif
     QuickenMetricsUtils m_metricsUtils;
+    QuickenThreadSampler m_threadSampler;
+    QVector<QuickenMetrics> m_threadMetrics;
     QTimer m_processTimer;
+    QTimer m_memoryTimer;
+    QTimer m_bindingTimer;
+    QuickenBindingProfiler m_bindingProfiler;
+    QVector<QuickenMetrics> m_bindingMetrics;
     QMutex m_monitorsMutex;
-    int m_monitorCount;
-    int m_loggerCount;
     int m_updateInterval[QuickenMetrics::TypeCount];
+    int m_bindingHotspotCount;
+    int m_loggingQueueSize;
+    QuickenApplicationMonitor::LoggingQueuePolicy m_loggingQueuePolicy;
     quint32 m_flags;
+    bool m_processUpdates;
     alignas(64) QuickenMetrics m_processMetrics;
+    alignas(64) QuickenMetrics m_memoryMetrics;
+};
+
+// Scoped lock-free read access to the monitor registry. Readers announce
+// themselves in the reader count of the current epoch, writers publish a new
+// registry, flip the epoch and wait for the readers of the previous epoch to
+// leave before freeing the previous registry. Monitors must not be added or
+// removed by the reading thread while the reader is alive.
+class QUICKEN_PRIVATE_EXPORT MonitorRegistryReader
+{
+public:
+    MonitorRegistryReader(QuickenApplicationMonitorPrivate* applicationMonitor);
+    ~MonitorRegistryReader();
+
+    const QVector<WindowMonitor*>& monitors() const { return m_registry->monitors; }
+
+private:
+    QuickenApplicationMonitorPrivate* m_applicationMonitor;
+    const MonitorRegistry* m_registry;
+    quint32 m_epoch;
+};
+
+// Thread delivering the metrics to a single logger. Metrics are copied by the
+// logging thread to a bounded lock-free single-producer single-consumer ring.
+// Metrics that don't fit are dropped for that logger only, or the logging
+// thread waits for room with the BlockProducer policy.
+class QUICKEN_PRIVATE_EXPORT LoggerWorker : public QThread
+{
+public:
+    LoggerWorker(QuickenLogger* logger, int queueSize);
+    ~LoggerWorker();
+
+    void run() override;
+    void push(const QuickenMetrics* metrics, int count, bool block);
+    void release(bool freeLogger);
+    QuickenLogger* logger() const { return m_logger; }
+    void statistics(QuickenApplicationMonitor::LoggerStatistics* statistics) const;
+
+private:
+    enum {
+        Waiting         = (1 << 0),
+        JoinRequested   = (1 << 1),
+        ProducerWaiting = (1 << 2),
+        FreeLogger      = (1 << 3)
+    };
+
+    QuickenLogger* m_logger;
+    QuickenMetrics* m_queue;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QWaitCondition m_spaceCondition;  // Wakes up the logging thread.
+    QAtomicInteger<quint32> m_flags;
+    QAtomicInteger<quint32> m_droppedCount;
+    QAtomicInteger<quint64> m_deliveredCount;
+    quint32 m_queueSize;
+    quint32 m_queueMask;
+    alignas(64) QAtomicInteger<quint32> m_queueTail;  // Written by the logging thread.
+    alignas(64) QAtomicInteger<quint32> m_queueHead;  // Written by the worker.
 };
 
+// Thread dispatching the metrics to the loggers. Metrics are pushed to a bounded
+// lock-free multi-producer single-consumer ring so that the render threads and
+// the GUI thread never take a lock to publish metrics. The thread wakes up once
+// half of the ring is filled or at a regular interval and hands contiguous
+// batches of metrics to the logger workers.
 class QUICKEN_PRIVATE_EXPORT LoggingThread : public QThread
 {
 public:
-    LoggingThread();
+    LoggingThread(int queueSize, QuickenApplicationMonitor::LoggingQueuePolicy policy);
 
     void run() override;
     void push(const QuickenMetrics* metrics);
-    void setLoggers(QuickenLogger** loggers, int count);
+    void setLoggers(const QVector<QuickenLogger*>& loggers, bool free = false);
+    bool loggerStatistics(
+        QuickenLogger* logger, QuickenApplicationMonitor::LoggerStatistics* statistics);
+    void setPolicy(QuickenApplicationMonitor::LoggingQueuePolicy policy) {
+        m_policy.storeRelease(policy);
+    }
+    quint32 droppedCount() const { return m_droppedCount.loadAcquire(); }
     LoggingThread* ref();
     void deref();
 
@@ -98,15 +203,31 @@ private:
 
     ~LoggingThread();
 
+    bool claim(quint32 position);
+    bool claimHead();
+    int deliver();
+
+    // Slot i of the ring is free for a producer at position p when its
+    // sequence equals p, it's ready to be read by the consumer when it equals
+    // p + 1 and it's being read when it equals p + 2. A slot at position p
+    // whose sequence is at least p + queueSize has been dropped.
     QuickenMetrics* m_queue;
-    QuickenLogger* m_loggers[QuickenApplicationMonitorPrivate::maxLoggers];
-    int m_loggerCount;
-    QMutex m_mutex;
+    QAtomicInteger<quint32>* m_queueSequences;
+    QVector<LoggerWorker*> m_workers;
+    QVector<LoggerWorker*> m_releasedWorkers;  // Delivering their last metrics.
+    QMutex m_mutex;  // Only taken by producers to wake up a waiting consumer.
+    QMutex m_workersMutex;
     QWaitCondition m_condition;
     QAtomicInteger<quint32> m_refCount;
-    qint8 m_queueIndex;
-    qint8 m_queueSize;
-    quint8 m_flags;
+    QAtomicInteger<quint32> m_flags;
+    QAtomicInteger<quint32> m_policy;
+    QAtomicInteger<quint32> m_droppedCount;
+    quint32 m_queueSize;
+    quint32 m_queueMask;
+    quint32 m_batchSize;
+    QAtomicInteger<quint32> m_queueWaitingHead;
+    alignas(64) QAtomicInteger<quint32> m_queueTail;  // Written by producers.
+    alignas(64) quint32 m_queueHead;  // Written by the consumer.
 };
 
 class QUICKEN_PRIVATE_EXPORT WindowMonitorDeleter : public QRunnable
@@ -160,10 +281,15 @@ public:
 
     QQuickWindow* window() const { return m_window; }
     void setProcessMetrics(const QuickenMetrics& metrics);
+    void setThreadMetrics(const QVector<QuickenMetrics>& metrics);
+    void setMemoryMetrics(const QuickenMetrics& metrics);
+    void addInputEvent(QuickenInputMetrics::Type type, QuickenInputMetrics::Action action,
+                       quint64 timeStamp, quint64 queueingDelay);
 
 private Q_SLOTS:
     void windowSceneGraphInitialized();
     void windowSceneGraphInvalidated();
+    void windowAfterAnimating();
     void windowBeforeSynchronizing();
     void windowAfterSynchronizing();
     void windowBeforeRendering();
@@ -173,19 +299,40 @@ private Q_SLOTS:
 
 private:
     enum {
-        // Lower bit allowed is (1 << 16).
-        GpuResourcesInitialized = (1 << 16),
-        GpuTimerAvailable       = (1 << 17),
-        SizeChanged             = (1 << 18)
+        // Lower bit allowed is (1 << 18).
+        GpuResourcesInitialized   = (1 << 18),
+        GpuTimerAvailable         = (1 << 19),
+        SizeChanged               = (1 << 20),
+        Synchronized              = (1 << 21),
+        OpenGLCountersAvailable   = (1 << 22),
+        FirstFrameMilestone       = (1 << 23),
+        OpenGLCountersUnavailable = (1 << 24)
         // Higher bit allowed is (1 << 31).
     };
 
+    // Input events delivered to the window and waiting for a frame.
+    struct InputEvent {
+        quint64 timeStamp;  // Time stamp of the delivery.
+        quint64 queueingDelay;
+        QuickenInputMetrics::Type type;
+        QuickenInputMetrics::Action action;
+    };
+    static const int maxPendingInputEvents = 64;
+
     bool gpuResourcesInitialized() const { return m_flags & GpuResourcesInitialized; }
     void setFlags(quint32 flags) {
         m_flags = (m_flags & QuickenApplicationMonitorPrivate::WindowMonitorMask) | flags;
     }
     void initializeGpuResources();
     void finalizeGpuResources();
+    void updateAllocationMetrics();
+    void updateOpenGLCounters();
+    void updateSceneGraphMetrics();
+    void updateOpenGLMetrics();
+    void updateJavaScriptMetrics();
+    void updateAnimationMetrics();
+    void updateInputMetrics();
+    void logStartupMilestones();
 
     QuickenApplicationMonitor* m_applicationMonitor;
     LoggingThread* m_loggingThread;
@@ -195,10 +342,28 @@ private:
     QMutex m_mutex;
     QElapsedTimer m_sceneGraphTimer;
     QElapsedTimer m_deltaTimer;
+    quint64 m_cpuTime;
+    const QuickenAllocationCounters* m_guiAllocationCounters;
+    QuickenAllocationCounts m_renderAllocationCounts;
+    QuickenAllocationCounts m_guiAllocationCounts;
+    QuickenOpenGLCounts m_openGLCounts;
     quint32 m_id;
     quint32 m_flags;
     QSize m_frameSize;
     QuickenMetrics m_frameMetrics;
+    QuickenMetrics m_textureMetrics;
+    QuickenMetrics m_javaScriptMetrics;  // Written by the GUI thread before sync.
+    QuickenMetrics m_animationMetrics;  // Written by the GUI thread before sync.
+    QuickenAnimationCounts m_animationCounts;
+    QVector<InputEvent> m_pendingInputEvents;  // Written by the GUI thread before sync.
+    QVector<InputEvent> m_syncedInputEvents;  // Read by the render thread at swap.
+    QPointer<QQmlEngine> m_engine;
+    QPointer<QObject> m_collectionSentinel;
+    quint64 m_collectionSentinelCpuTime;  // GUI thread CPU time at the last check.
+    bool m_collectionSentinelCreated;
+    bool m_javaScriptMetricsPending;
+    bool m_animationCountsValid;
+    bool m_animationMetricsPending;
 
     friend class WindowMonitorDeleter;
     friend class WindowMonitorFlagSetter;
@@ -0,0 +1,125 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenbinarylogreader_p.h"
+
+#include <QtCore/QDir>
+
+#include "quickenglobal_p.h"
+
+QuickenBinaryLogReader::QuickenBinaryLogReader(const QString& fileName)
+    : d_ptr(new QuickenBinaryLogReaderPrivate(fileName))
+{
+}
+
+QuickenBinaryLogReaderPrivate::QuickenBinaryLogReaderPrivate(const QString& fileName)
+    : m_header(nullptr)
+    , m_records(nullptr)
+    , m_count(0)
+    , m_first(0)
+    , m_capacity(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        WARN("BinaryLogReader: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        return;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(QuickenBinaryLogHeader))) {
+        WARN("BinaryLogReader: File '%s' is too small.", fileName.toLatin1().constData());
+        return;
+    }
+
+    uchar* map = m_file.map(0, fileSize);
+    if (!map) {
+        WARN("BinaryLogReader: Can't map file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        return;
+    }
+
+    // Records must be aligned on 8 bytes to be accessed in place.
+    const QuickenBinaryLogHeader* header = reinterpret_cast<const QuickenBinaryLogHeader*>(map);
+    if (!header->isCompatible() || (header->headerSize & 7) || header->headerSize > fileSize) {
+        WARN("BinaryLogReader: File '%s' has an incompatible format.",
+             fileName.toLatin1().constData());
+        m_file.unmap(map);
+        return;
+    }
+
+    const qint64 recordCount = (fileSize - header->headerSize) / header->recordSize;
+    if (header->ringCapacity == 0) {
+        m_count = recordCount;
+    } else {
+        if (header->ringCapacity > static_cast<quint64>(recordCount)) {
+            WARN("BinaryLogReader: File '%s' is truncated.", fileName.toLatin1().constData());
+            m_file.unmap(map);
+            return;
+        }
+        // Once wrapped, the record at the write cursor might have been torn by
+        // a crash while being overwritten.
+        m_capacity = header->ringCapacity;
+        const quint64 writeCount = header->ringWriteCount;
+        if (writeCount < header->ringCapacity) {
+            m_count = writeCount;
+        } else {
+            m_count = m_capacity - 1;
+            m_first = (writeCount + 1) % header->ringCapacity;
+        }
+    }
+
+    m_header = header;
+    m_records = reinterpret_cast<const QuickenMetrics*>(map + header->headerSize);
+}
+
+QuickenBinaryLogReader::~QuickenBinaryLogReader()
+{
+    // The mapping is released when closing the file.
+    delete d_ptr;
+}
+
+bool QuickenBinaryLogReader::isOpen()
+{
+    return !!d_func()->m_header;
+}
+
+const QuickenBinaryLogHeader* QuickenBinaryLogReader::header()
+{
+    return d_func()->m_header;
+}
+
+bool QuickenBinaryLogReader::isRing()
+{
+    return d_func()->m_capacity > 0;
+}
+
+const QuickenMetrics& QuickenBinaryLogReader::at(qint64 index)
+{
+    Q_D(QuickenBinaryLogReader);
+    DASSERT(index >= 0);
+    DASSERT(index < d->m_count);
+
+    if (d->m_capacity == 0) {
+        return d->m_records[index];
+    } else {
+        return d->m_records[(d->m_first + index) % d->m_capacity];
+    }
+}
+
+const QuickenMetrics* QuickenBinaryLogReader::records()
+{
+    return d_func()->m_records;
+}
+
+qint64 QuickenBinaryLogReader::count()
+{
+    return d_func()->m_count;
+}
@@ -0,0 +1,77 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef BINARYLOGREADER_H
+#define BINARYLOGREADER_H
+
+#include <QtCore/QString>
+
+#include <Quicken/quickenlogger.h>
+#include <Quicken/quickenmetrics.h>
+#include <Quicken/quickenglobal.h>
+
+class QuickenBinaryLogReaderPrivate;
+
+// Read a file written by QuickenBinaryLogger or QuickenFlightRecorderLogger. The
+// file is memory-mapped and its records can be directly accessed in place.
+class QUICKEN_EXPORT QuickenBinaryLogReader
+{
+public:
+    QuickenBinaryLogReader(const QString& fileName);
+    ~QuickenBinaryLogReader();
+
+    // Get whether the file has been mapped successfully and has been written
+    // with a compatible layout.
+    bool isOpen();
+
+    // Get the file header, nullptr if not open.
+    const QuickenBinaryLogHeader* header();
+
+    // Get whether the file is a flight recorder ring.
+    bool isRing();
+
+    // Get the number of valid records. A record partially written at the end
+    // of a file, or right after the write cursor of a ring, is not counted.
+    qint64 count();
+
+    // Get the record at the given index in chronological order.
+    const QuickenMetrics& at(qint64 index);
+
+    // Get the array of records. Records are in chronological order, except for
+    // rings that wrapped around, at() or the iterators must be used in that
+    // case.
+    const QuickenMetrics* records();
+
+    // Iterator over the records in chronological order. For rings that
+    // wrapped around, iteration starts at the oldest record, right after the
+    // write cursor, and wraps at the end of the ring.
+    class const_iterator
+    {
+    public:
+        const_iterator(QuickenBinaryLogReader* reader, qint64 index)
+            : m_reader(reader), m_index(index) {}
+
+        const QuickenMetrics& operator*() const { return m_reader->at(m_index); }
+        const QuickenMetrics* operator->() const { return &m_reader->at(m_index); }
+        const_iterator& operator++() { ++m_index; return *this; }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+
+    private:
+        QuickenBinaryLogReader* m_reader;
+        qint64 m_index;
+    };
+
+    // Allow range-based for loops over the records, in chronological order.
+    const_iterator begin() { return const_iterator(this, 0); }
+    const_iterator end() { return const_iterator(this, count()); }
+
+private:
+    QuickenBinaryLogReaderPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenBinaryLogReader)
+    Q_DISABLE_COPY(QuickenBinaryLogReader)
+};
+
+#endif  // BINARYLOGREADER_H
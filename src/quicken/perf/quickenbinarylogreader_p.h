@@ -0,0 +1,28 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef BINARYLOGREADER_P_H
+#define BINARYLOGREADER_P_H
+
+#include <Quicken/quickenbinarylogreader.h>
+
+#include <QtCore/QFile>
+
+#include <Quicken/private/quickenglobal_p.h>
+
+class QUICKEN_PRIVATE_EXPORT QuickenBinaryLogReaderPrivate
+{
+public:
+    QuickenBinaryLogReaderPrivate(const QString& fileName);
+
+    QFile m_file;
+    const QuickenBinaryLogHeader* m_header;
+    const QuickenMetrics* m_records;
+    qint64 m_count;
+    qint64 m_first;  // Index of the oldest record in the ring.
+    qint64 m_capacity;
+};
+
+#endif  // BINARYLOGREADER_P_H
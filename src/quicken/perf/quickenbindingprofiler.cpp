@@ -0,0 +1,328 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenbindingprofiler_p.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QPointer>
+#include <QtQml/QQmlEngine>
+#include <QtQml/private/qqmlengine_p.h>
+#include <QtQml/private/qqmlprofiler_p.h>
+
+#if QT_CONFIG(qml_debug)
+
+// Profiles the bindings of an engine with a QML profiler only enabling binding
+// ranges. A binding evaluation can trigger the evaluation of other bindings,
+// the ranges being nested, the time of nested evaluations is excluded from the
+// time of the outer one.
+class BindingEngineProfiler : public QObject
+{
+public:
+    BindingEngineProfiler(QuickenBindingProfiler* bindingProfiler, QQmlEngine* engine)
+        : m_bindingProfiler(bindingProfiler)
+        , m_engine(engine)
+        , m_enginePrivate(QQmlEnginePrivate::get(engine))
+        , m_profiler(nullptr) {}
+    ~BindingEngineProfiler();
+
+    QQmlEngine* engine() const { return m_engine.data(); }
+    bool attach();
+    void update();
+    void engineDestroyed();
+    void dataReady(
+        const QVector<QQmlProfilerData>& data, const QQmlProfiler::LocationHash& locations);
+
+private:
+    struct Range {
+        int index;
+        qint64 start;
+        qint64 nestedTime;
+    };
+
+    QuickenBindingProfiler* m_bindingProfiler;
+    QPointer<QQmlEngine> m_engine;
+    QQmlEnginePrivate* m_enginePrivate;
+    QQmlProfiler* m_profiler;
+    QHash<quintptr, int> m_statisticsIndices;  // Indexed by profiler location id.
+    QVector<Range> m_ranges;
+};
+
+BindingEngineProfiler::~BindingEngineProfiler()
+{
+    if (m_profiler) {
+        DASSERT(m_engine);
+        // The QML profiler service can replace the engine profiler, which is
+        // then left untouched.
+        if (m_enginePrivate->profiler == m_profiler) {
+            m_enginePrivate->profiler = nullptr;
+        }
+        delete m_profiler;
+    }
+}
+
+bool BindingEngineProfiler::attach()
+{
+    DASSERT(m_engine);
+    DASSERT(!m_profiler);
+
+    if (m_enginePrivate->profiler) {
+        return false;
+    }
+
+    // The QML profiler time stamps are only used to compute durations.
+    QElapsedTimer timer;
+    timer.start();
+    m_profiler = new QQmlProfiler;
+    m_profiler->setTimer(timer);
+    QObject::connect(m_profiler, &QQmlProfiler::dataReady, this,
+                     &BindingEngineProfiler::dataReady, Qt::DirectConnection);
+    // The engine deletes its profiler, it must be detached before.
+    QObject::connect(m_engine.data(), &QObject::destroyed, this,
+                     &BindingEngineProfiler::engineDestroyed, Qt::DirectConnection);
+    m_profiler->startProfiling(Q_UINT64_C(1) << QQmlProfilerDefinitions::ProfileBinding);
+    m_enginePrivate->profiler = m_profiler;
+    return true;
+}
+
+void BindingEngineProfiler::update()
+{
+    if (m_profiler) {
+        // Emits dataReady() synchronously. Locations are only reported once.
+        m_profiler->reportData(true);
+    }
+}
+
+void BindingEngineProfiler::engineDestroyed()
+{
+    // The private engine is still alive while the destroyed() signal is
+    // emitted.
+    if (m_profiler) {
+        if (m_enginePrivate->profiler == m_profiler) {
+            m_enginePrivate->profiler = nullptr;
+        }
+        delete m_profiler;
+        m_profiler = nullptr;
+    }
+}
+
+void BindingEngineProfiler::dataReady(
+    const QVector<QQmlProfilerData>& data, const QQmlProfiler::LocationHash& locations)
+{
+    for (QQmlProfiler::LocationHash::const_iterator it = locations.constBegin();
+         it != locations.constEnd(); ++it) {
+        const QQmlSourceLocation& location = it.value().location;
+        m_statisticsIndices.insert(
+            it.key(), m_bindingProfiler->statisticsIndex(
+                location.sourceFile, location.line, location.column));
+    }
+
+    const int size = data.size();
+    for (int i = 0; i < size; ++i) {
+        const QQmlProfilerData& event = data[i];
+        if (event.detailType != QQmlProfilerDefinitions::Binding) {
+            continue;
+        }
+        if (event.messageType & (1 << QQmlProfilerDefinitions::RangeStart)) {
+            const Range range = { m_statisticsIndices.value(event.locationId, -1), event.time, 0 };
+            m_ranges.append(range);
+        } else if ((event.messageType & (1 << QQmlProfilerDefinitions::RangeEnd))
+                   && !m_ranges.isEmpty()) {
+            const Range range = m_ranges.takeLast();
+            const qint64 time = event.time - range.start;
+            if (range.index != -1) {
+                m_bindingProfiler->addEvaluation(range.index, time - range.nestedTime);
+            }
+            if (!m_ranges.isEmpty()) {
+                m_ranges.last().nestedTime += time;
+            }
+        }
+    }
+}
+
+#endif  // QT_CONFIG(qml_debug)
+
+QuickenBindingProfiler::QuickenBindingProfiler()
+{
+}
+
+QuickenBindingProfiler::~QuickenBindingProfiler()
+{
+    detach();
+}
+
+// static.
+bool QuickenBindingProfiler::isAvailable()
+{
+#if QT_CONFIG(qml_debug)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if QT_CONFIG(qml_debug)
+
+BindingEngineProfiler* QuickenBindingProfiler::attach(QQmlEngine* engine)
+{
+    DASSERT(engine);
+
+    // Engines already profiled are kept in the list so that the warning is
+    // only emitted once.
+    BindingEngineProfiler* engineProfiler = new BindingEngineProfiler(this, engine);
+    if (!engineProfiler->attach()) {
+        WARN("BindingProfiler: QML engine already profiled, bindings can't be profiled.");
+    }
+    m_engines.append(engineProfiler);
+    return engineProfiler;
+}
+
+void QuickenBindingProfiler::update(QQmlEngine* engine)
+{
+    DASSERT(engine);
+
+    BindingEngineProfiler* engineProfiler = nullptr;
+    for (int i = m_engines.size() - 1; i >= 0; --i) {
+        if (!m_engines[i]->engine()) {
+            delete m_engines.takeAt(i);
+        } else if (m_engines[i]->engine() == engine) {
+            engineProfiler = m_engines[i];
+        }
+    }
+    if (!engineProfiler) {
+        engineProfiler = attach(engine);
+    }
+
+    engineProfiler->update();
+    endFrame();
+}
+
+void QuickenBindingProfiler::detach()
+{
+    for (int i = 0; i < m_engines.size(); ++i) {
+        delete m_engines[i];
+    }
+    m_engines.clear();
+    endFrame();
+}
+
+#else
+
+void QuickenBindingProfiler::update(QQmlEngine* engine)
+{
+    Q_UNUSED(engine);
+}
+
+void QuickenBindingProfiler::detach()
+{
+}
+
+#endif  // QT_CONFIG(qml_debug)
+
+int QuickenBindingProfiler::statisticsIndex(const QString& file, int line, int column)
+{
+    // Local files are identified by their path.
+    const QString location =
+        QStringLiteral("%1:%2:%3")
+        .arg(file.startsWith(QStringLiteral("file://")) ? file.mid(7) : file)
+        .arg(line).arg(column);
+    QHash<QString, int>::const_iterator it = m_statisticsIndices.constFind(location);
+    if (it != m_statisticsIndices.constEnd()) {
+        return it.value();
+    }
+
+    // The end of the location is the most relevant part, the beginning of long
+    // file paths is cut.
+    Statistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    const QByteArray utf8 = location.toUtf8();
+    const int maxSize = QuickenBindingMetrics::maxLocationSize - 1;
+    const int offset = qMax(0, utf8.size() - maxSize);
+    memcpy(statistics.location, utf8.constData() + offset, utf8.size() - offset);
+    const int index = m_statistics.size();
+    m_statistics.append(statistics);
+    m_statisticsIndices.insert(location, index);
+    return index;
+}
+
+void QuickenBindingProfiler::addEvaluation(int index, quint64 time)
+{
+    DASSERT(index >= 0 && index < m_statistics.size());
+
+    Statistics& statistics = m_statistics[index];
+    if (statistics.frameEvaluationCount == 0) {
+        m_frameIndices.append(index);
+    }
+    statistics.frameEvaluationCount++;
+    statistics.frameTime += time;
+}
+
+void QuickenBindingProfiler::endFrame()
+{
+    const int size = m_frameIndices.size();
+    for (int i = 0; i < size; ++i) {
+        Statistics& statistics = m_statistics[m_frameIndices[i]];
+        if (statistics.evaluationCount == 0) {
+            m_updateIndices.append(m_frameIndices[i]);
+        }
+        statistics.evaluationCount += statistics.frameEvaluationCount;
+        statistics.time += statistics.frameTime;
+        statistics.maxFrameEvaluationCount =
+            qMax(statistics.maxFrameEvaluationCount, statistics.frameEvaluationCount);
+        statistics.maxFrameTime = qMax(statistics.maxFrameTime, statistics.frameTime);
+        statistics.totalEvaluationCount += statistics.frameEvaluationCount;
+        statistics.totalTime += statistics.frameTime;
+        statistics.frameEvaluationCount = 0;
+        statistics.frameTime = 0;
+    }
+    m_frameIndices.clear();
+}
+
+// Orders statistics indices by decreasing time.
+struct QuickenBindingProfiler::TimeGreater
+{
+    TimeGreater(const QVector<Statistics>& statistics) : m_statistics(statistics) {}
+    bool operator()(int a, int b) const { return m_statistics[a].time > m_statistics[b].time; }
+    const QVector<Statistics>& m_statistics;
+};
+
+int QuickenBindingProfiler::takeHotspots(QuickenMetrics* metrics, int count, quint64 timeStamp)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    const int hotspotCount = qMin(count, m_updateIndices.size());
+    std::partial_sort(m_updateIndices.begin(), m_updateIndices.begin() + hotspotCount,
+                      m_updateIndices.end(), TimeGreater(m_statistics));
+    for (int i = 0; i < hotspotCount; ++i) {
+        const Statistics& statistics = m_statistics[m_updateIndices[i]];
+        memset(&metrics[i], 0, sizeof(QuickenMetrics));
+        metrics[i].type = QuickenMetrics::Binding;
+        metrics[i].timeStamp = timeStamp;
+        metrics[i].binding.rank = i + 1;
+        metrics[i].binding.evaluationCount = statistics.evaluationCount;
+        metrics[i].binding.time = statistics.time;
+        metrics[i].binding.maxFrameTime = statistics.maxFrameTime;
+        metrics[i].binding.totalTime = statistics.totalTime;
+        metrics[i].binding.maxFrameEvaluationCount = statistics.maxFrameEvaluationCount;
+        metrics[i].binding.totalEvaluationCount = statistics.totalEvaluationCount;
+        memcpy(metrics[i].binding.location, statistics.location,
+               QuickenBindingMetrics::maxLocationSize);
+    }
+
+    const int size = m_updateIndices.size();
+    for (int i = 0; i < size; ++i) {
+        Statistics& statistics = m_statistics[m_updateIndices[i]];
+        statistics.evaluationCount = 0;
+        statistics.time = 0;
+        statistics.maxFrameEvaluationCount = 0;
+        statistics.maxFrameTime = 0;
+    }
+    m_updateIndices.clear();
+
+    return hotspotCount;
+}
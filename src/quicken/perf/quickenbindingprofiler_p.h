@@ -0,0 +1,74 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef BINDINGPROFILER_P_H
+#define BINDINGPROFILER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <Quicken/quickenmetrics.h>
+#include <Quicken/private/quickenglobal_p.h>
+
+class QQmlEngine;
+class BindingEngineProfiler;
+
+// Profiles the binding evaluations of QML engines, aggregated per binding
+// location (file, line and column). Relies on the binding ranges of the QML
+// profiler, which requires Qt to be built with the QML debugging
+// infrastructure. An engine can only have one QML profiler, engines already
+// profiled by the QML debugger are skipped. Must be used from the GUI thread.
+class QUICKEN_PRIVATE_EXPORT QuickenBindingProfiler
+{
+public:
+    QuickenBindingProfiler();
+    ~QuickenBindingProfiler();
+
+    // Whether Qt has been built with the QML debugging infrastructure.
+    static bool isAvailable();
+
+    // Collect the binding evaluations of the given engine since the previous
+    // call and end the frame. The engine is profiled starting from the first
+    // call.
+    void update(QQmlEngine* engine);
+
+    // Stop profiling the engines. Statistics are kept.
+    void detach();
+
+    // Fill metrics with the bindings that took the most time since the
+    // previous call, by decreasing time. Returns the number of metrics filled,
+    // at most count.
+    int takeHotspots(QuickenMetrics* metrics, int count, quint64 timeStamp);
+
+private:
+    struct Statistics {
+        char location[QuickenBindingMetrics::maxLocationSize];
+        quint64 frameTime;
+        quint64 time;
+        quint64 maxFrameTime;
+        quint64 totalTime;
+        quint32 frameEvaluationCount;
+        quint32 evaluationCount;
+        quint32 maxFrameEvaluationCount;
+        quint32 totalEvaluationCount;
+    };
+    struct TimeGreater;
+
+    BindingEngineProfiler* attach(QQmlEngine* engine);
+    int statisticsIndex(const QString& file, int line, int column);
+    void addEvaluation(int index, quint64 time);
+    void endFrame();
+
+    QVector<BindingEngineProfiler*> m_engines;
+    QVector<Statistics> m_statistics;
+    QHash<QString, int> m_statisticsIndices;  // Indexed by location.
+    QVector<int> m_frameIndices;  // Bindings evaluated during the frame.
+    QVector<int> m_updateIndices;  // Bindings evaluated since the previous hotspots.
+
+    friend class BindingEngineProfiler;
+};
+
+#endif  // BINDINGPROFILER_P_H
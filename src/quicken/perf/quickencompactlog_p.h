@@ -0,0 +1,405 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef COMPACTLOG_P_H
+#define COMPACTLOG_P_H
+
+#include <string.h>
+
+#include <QtCore/QByteArray>
+
+#include <Quicken/quickenmetrics.h>
+#include <Quicken/private/quickenglobal_p.h>
+
+// The compact log format, written by QuickenCompactLogger and read by
+// QuickenCompactLogReader, is a QuickenCompactLogHeader followed by blocks.
+// A block stores up to compactBlockSize records of a single metrics type (and
+// of a single window for frame metrics or of a single thread for thread
+// metrics) as a QuickenCompactBlockHeader
+// followed by a zlib compressed payload. The payload stores each field in its
+// own column, every value being encoded as the zigzag varint of its difference
+// with the previous record's value. Blocks don't depend on each other, which
+// allows random access and bounds the loss to the pending blocks in case of
+// crash. Header fields are stored in the byte order of the writer.
+
+const quint16 compactLogVersion = 1;
+const int compactBlockSize = 4096;  // In records.
+const quint64 compactBlockDuration = Q_UINT64_C(60000000000);  // In nanoseconds.
+const int maxCompactFieldCount = 32;
+
+struct QuickenCompactLogHeader
+{
+    char magic[8];  // "QUICKENC".
+    quint16 version;
+    quint8 endianness;  // QuickenBinaryLogHeader::Endianness.
+    quint8 __reserved0;
+    quint32 processId;
+    quint64 clockOrigin;  // See QuickenBinaryLogHeader::clockOrigin.
+    quint8 __reserved[8];
+};
+Q_STATIC_ASSERT(sizeof(QuickenCompactLogHeader) == 32);
+
+struct QuickenCompactBlockHeader
+{
+    static const quint32 magicNumber = 0x4b424351;  // "QCBK".
+
+    quint32 magic;
+    quint8 type;
+    quint8 fieldCount;
+    quint16 __reserved0;
+    quint32 window;  // Window id for frame metrics, thread id for thread metrics, 0 otherwise.
+    quint32 recordCount;
+    quint64 firstTimeStamp;
+    quint64 lastTimeStamp;
+    quint32 payloadSize;  // Size of the compressed payload following the header.
+    quint8 __reserved[4];
+};
+Q_STATIC_ASSERT(sizeof(QuickenCompactBlockHeader) == 40);
+
+// Number of fields stored for a metrics type. The generic metrics string is
+// stored in an additional column after the fields.
+static inline int compactFieldCount(QuickenMetrics::Type type)
+{
+    const int fieldCount[QuickenMetrics::TypeCount] = {
+        14, 5, 21, 3, 10, 7, 11, 10, 16, 10, 7, 11
+    };
+    return fieldCount[type];
+}
+
+static inline void compactFields(const QuickenMetrics& metrics, quint64* fields)
+{
+    fields[0] = metrics.timeStamp;
+    switch (metrics.type) {
+    case QuickenMetrics::Process:
+        fields[1] = metrics.process.cpuUsage;
+        fields[2] = metrics.process.vszMemory;
+        fields[3] = metrics.process.rssMemory;
+        fields[4] = metrics.process.threadCount;
+        fields[5] = metrics.process.droppedCount;
+        fields[6] = metrics.process.minorFaults;
+        fields[7] = metrics.process.majorFaults;
+        fields[8] = metrics.process.voluntarySwitches;
+        fields[9] = metrics.process.involuntarySwitches;
+        fields[10] = metrics.process.readBytes;
+        fields[11] = metrics.process.writeBytes;
+        fields[12] = metrics.process.preciseCpuUsage;
+        fields[13] = metrics.process.cpuTime;
+        break;
+    case QuickenMetrics::Window:
+        fields[1] = metrics.window.id;
+        fields[2] = metrics.window.state;
+        fields[3] = metrics.window.width;
+        fields[4] = metrics.window.height;
+        break;
+    case QuickenMetrics::Frame:
+        fields[1] = metrics.frame.number;
+        fields[2] = metrics.frame.deltaTime;
+        fields[3] = metrics.frame.syncTime;
+        fields[4] = metrics.frame.renderTime;
+        fields[5] = metrics.frame.gpuTime;
+        fields[6] = metrics.frame.swapTime;
+        fields[7] = metrics.frame.window;
+        fields[8] = metrics.frame.cpuTime;
+        fields[9] = metrics.frame.renderAllocations;
+        fields[10] = metrics.frame.renderFrees;
+        fields[11] = metrics.frame.renderAllocatedBytes;
+        fields[12] = metrics.frame.guiAllocations;
+        fields[13] = metrics.frame.guiFrees;
+        fields[14] = metrics.frame.guiAllocatedBytes;
+        fields[15] = metrics.frame.opaqueNodes;
+        fields[16] = metrics.frame.alphaNodes;
+        fields[17] = metrics.frame.unmergeableNodes;
+        fields[18] = metrics.frame.drawCalls;
+        fields[19] = metrics.frame.vertexBytes;
+        fields[20] = metrics.frame.indexBytes;
+        break;
+    case QuickenMetrics::Generic:
+        fields[1] = metrics.generic.id;
+        fields[2] = metrics.generic.stringSize;
+        break;
+    case QuickenMetrics::Thread: {
+        quint64 name[2];
+        Q_STATIC_ASSERT(sizeof(name) == QuickenThreadMetrics::maxNameSize);
+        memcpy(name, metrics.thread.name, sizeof(name));
+        fields[1] = metrics.thread.id;
+        fields[2] = metrics.thread.tags;
+        fields[3] = metrics.thread.window;
+        fields[4] = metrics.thread.cpuUsage;
+        fields[5] = metrics.thread.cpuTime;
+        fields[6] = metrics.thread.waitTime;
+        fields[7] = metrics.thread.sliceCount;
+        fields[8] = name[0];
+        fields[9] = name[1];
+        break;
+    }
+    case QuickenMetrics::Memory:
+        fields[1] = metrics.memory.pssMemory;
+        fields[2] = metrics.memory.privateCleanMemory;
+        fields[3] = metrics.memory.privateDirtyMemory;
+        fields[4] = metrics.memory.sharedMemory;
+        fields[5] = metrics.memory.anonymousMemory;
+        fields[6] = metrics.memory.swapMemory;
+        break;
+    case QuickenMetrics::Texture:
+        fields[1] = metrics.texture.window;
+        fields[2] = metrics.texture.frame;
+        fields[3] = metrics.texture.uploadCount;
+        fields[4] = metrics.texture.uploadedBytes;
+        fields[5] = metrics.texture.atlasUploadCount;
+        fields[6] = metrics.texture.atlasUploadedBytes;
+        fields[7] = metrics.texture.textureCount;
+        fields[8] = metrics.texture.textureMemory;
+        fields[9] = metrics.texture.atlasCount;
+        fields[10] = metrics.texture.atlasMemory;
+        break;
+    case QuickenMetrics::JavaScript:
+        fields[1] = metrics.javaScript.window;
+        fields[2] = metrics.javaScript.frame;
+        fields[3] = metrics.javaScript.usedMemory;
+        fields[4] = metrics.javaScript.largeItemMemory;
+        fields[5] = metrics.javaScript.allocatedMemory;
+        fields[6] = metrics.javaScript.collections;
+        fields[7] = metrics.javaScript.collectionCount;
+        fields[8] = metrics.javaScript.reclaimedMemory;
+        fields[9] = metrics.javaScript.collectionTimeBound;
+        break;
+    case QuickenMetrics::Binding: {
+        quint64 location[8];
+        Q_STATIC_ASSERT(sizeof(location) == QuickenBindingMetrics::maxLocationSize);
+        memcpy(location, metrics.binding.location, sizeof(location));
+        fields[1] = metrics.binding.rank;
+        fields[2] = metrics.binding.evaluationCount;
+        fields[3] = metrics.binding.time;
+        fields[4] = metrics.binding.maxFrameEvaluationCount;
+        fields[5] = metrics.binding.maxFrameTime;
+        fields[6] = metrics.binding.totalEvaluationCount;
+        fields[7] = metrics.binding.totalTime;
+        for (int i = 0; i < 8; ++i) {
+            fields[8 + i] = location[i];
+        }
+        break;
+    }
+    case QuickenMetrics::Animation:
+        fields[1] = metrics.animation.window;
+        fields[2] = metrics.animation.frame;
+        fields[3] = metrics.animation.runningAnimationCount;
+        fields[4] = metrics.animation.tickCount;
+        fields[5] = metrics.animation.advanceTime;
+        fields[6] = metrics.animation.animationTime;
+        fields[7] = metrics.animation.wallTime;
+        fields[8] = metrics.animation.drift;
+        fields[9] = metrics.animation.totalDrift;
+        break;
+    case QuickenMetrics::Input:
+        fields[1] = metrics.input.window;
+        fields[2] = metrics.input.frame;
+        fields[3] = metrics.input.type;
+        fields[4] = metrics.input.action;
+        fields[5] = metrics.input.queueingDelay;
+        fields[6] = metrics.input.latency;
+        break;
+    case QuickenMetrics::Startup: {
+        quint64 name[8];
+        Q_STATIC_ASSERT(sizeof(name) == QuickenStartupMetrics::maxNameSize);
+        memcpy(name, metrics.startup.name, sizeof(name));
+        fields[1] = metrics.startup.milestone;
+        fields[2] = metrics.startup.time;
+        for (int i = 0; i < 8; ++i) {
+            fields[3 + i] = name[i];
+        }
+        break;
+    }
+    default:
+        DNOT_REACHED();
+        break;
+    }
+}
+
+static inline void setCompactFields(QuickenMetrics* metrics, const quint64* fields)
+{
+    metrics->timeStamp = fields[0];
+    switch (metrics->type) {
+    case QuickenMetrics::Process:
+        metrics->process.cpuUsage = fields[1];
+        metrics->process.vszMemory = fields[2];
+        metrics->process.rssMemory = fields[3];
+        metrics->process.threadCount = fields[4];
+        metrics->process.droppedCount = fields[5];
+        metrics->process.minorFaults = fields[6];
+        metrics->process.majorFaults = fields[7];
+        metrics->process.voluntarySwitches = fields[8];
+        metrics->process.involuntarySwitches = fields[9];
+        metrics->process.readBytes = fields[10];
+        metrics->process.writeBytes = fields[11];
+        metrics->process.preciseCpuUsage = fields[12];
+        metrics->process.cpuTime = fields[13];
+        break;
+    case QuickenMetrics::Window:
+        metrics->window.id = fields[1];
+        metrics->window.state = static_cast<QuickenWindowMetrics::State>(fields[2]);
+        metrics->window.width = fields[3];
+        metrics->window.height = fields[4];
+        break;
+    case QuickenMetrics::Frame:
+        metrics->frame.number = fields[1];
+        metrics->frame.deltaTime = fields[2];
+        metrics->frame.syncTime = fields[3];
+        metrics->frame.renderTime = fields[4];
+        metrics->frame.gpuTime = fields[5];
+        metrics->frame.swapTime = fields[6];
+        metrics->frame.window = fields[7];
+        metrics->frame.cpuTime = fields[8];
+        metrics->frame.renderAllocations = fields[9];
+        metrics->frame.renderFrees = fields[10];
+        metrics->frame.renderAllocatedBytes = fields[11];
+        metrics->frame.guiAllocations = fields[12];
+        metrics->frame.guiFrees = fields[13];
+        metrics->frame.guiAllocatedBytes = fields[14];
+        metrics->frame.opaqueNodes = fields[15];
+        metrics->frame.alphaNodes = fields[16];
+        metrics->frame.unmergeableNodes = fields[17];
+        metrics->frame.drawCalls = fields[18];
+        metrics->frame.vertexBytes = fields[19];
+        metrics->frame.indexBytes = fields[20];
+        break;
+    case QuickenMetrics::Generic:
+        metrics->generic.id = fields[1];
+        metrics->generic.stringSize =
+            qMin(fields[2], static_cast<quint64>(QuickenGenericMetrics::maxStringSize));
+        break;
+    case QuickenMetrics::Thread: {
+        // The name is stored as two raw 8 bytes fields, constant in a block.
+        const quint64 name[2] = { fields[8], fields[9] };
+        metrics->thread.id = fields[1];
+        metrics->thread.tags = fields[2];
+        metrics->thread.window = fields[3];
+        metrics->thread.cpuUsage = fields[4];
+        metrics->thread.cpuTime = fields[5];
+        metrics->thread.waitTime = fields[6];
+        metrics->thread.sliceCount = fields[7];
+        memcpy(metrics->thread.name, name, sizeof(name));
+        metrics->thread.name[QuickenThreadMetrics::maxNameSize - 1] = '\0';
+        break;
+    }
+    case QuickenMetrics::Memory:
+        metrics->memory.pssMemory = fields[1];
+        metrics->memory.privateCleanMemory = fields[2];
+        metrics->memory.privateDirtyMemory = fields[3];
+        metrics->memory.sharedMemory = fields[4];
+        metrics->memory.anonymousMemory = fields[5];
+        metrics->memory.swapMemory = fields[6];
+        break;
+    case QuickenMetrics::Texture:
+        metrics->texture.window = fields[1];
+        metrics->texture.frame = fields[2];
+        metrics->texture.uploadCount = fields[3];
+        metrics->texture.uploadedBytes = fields[4];
+        metrics->texture.atlasUploadCount = fields[5];
+        metrics->texture.atlasUploadedBytes = fields[6];
+        metrics->texture.textureCount = fields[7];
+        metrics->texture.textureMemory = fields[8];
+        metrics->texture.atlasCount = fields[9];
+        metrics->texture.atlasMemory = fields[10];
+        break;
+    case QuickenMetrics::JavaScript:
+        metrics->javaScript.window = fields[1];
+        metrics->javaScript.frame = fields[2];
+        metrics->javaScript.usedMemory = fields[3];
+        metrics->javaScript.largeItemMemory = fields[4];
+        metrics->javaScript.allocatedMemory = fields[5];
+        metrics->javaScript.collections = fields[6];
+        metrics->javaScript.collectionCount = fields[7];
+        metrics->javaScript.reclaimedMemory = fields[8];
+        metrics->javaScript.collectionTimeBound = fields[9];
+        break;
+    case QuickenMetrics::Binding: {
+        // The location is stored as eight raw 8 bytes fields.
+        quint64 location[8];
+        for (int i = 0; i < 8; ++i) {
+            location[i] = fields[8 + i];
+        }
+        metrics->binding.rank = fields[1];
+        metrics->binding.evaluationCount = fields[2];
+        metrics->binding.time = fields[3];
+        metrics->binding.maxFrameEvaluationCount = fields[4];
+        metrics->binding.maxFrameTime = fields[5];
+        metrics->binding.totalEvaluationCount = fields[6];
+        metrics->binding.totalTime = fields[7];
+        memcpy(metrics->binding.location, location, sizeof(location));
+        metrics->binding.location[QuickenBindingMetrics::maxLocationSize - 1] = '\0';
+        break;
+    }
+    case QuickenMetrics::Animation:
+        metrics->animation.window = fields[1];
+        metrics->animation.frame = fields[2];
+        metrics->animation.runningAnimationCount = fields[3];
+        metrics->animation.tickCount = fields[4];
+        metrics->animation.advanceTime = fields[5];
+        metrics->animation.animationTime = fields[6];
+        metrics->animation.wallTime = fields[7];
+        metrics->animation.drift = static_cast<qint64>(fields[8]);
+        metrics->animation.totalDrift = static_cast<qint64>(fields[9]);
+        break;
+    case QuickenMetrics::Input:
+        metrics->input.window = fields[1];
+        metrics->input.frame = fields[2];
+        metrics->input.type = static_cast<QuickenInputMetrics::Type>(fields[3]);
+        metrics->input.action = static_cast<QuickenInputMetrics::Action>(fields[4]);
+        metrics->input.queueingDelay = fields[5];
+        metrics->input.latency = fields[6];
+        break;
+    case QuickenMetrics::Startup: {
+        // The name is stored as eight raw 8 bytes fields.
+        quint64 name[8];
+        for (int i = 0; i < 8; ++i) {
+            name[i] = fields[3 + i];
+        }
+        metrics->startup.milestone = static_cast<QuickenStartupMetrics::Milestone>(fields[1]);
+        metrics->startup.time = fields[2];
+        memcpy(metrics->startup.name, name, sizeof(name));
+        metrics->startup.name[QuickenStartupMetrics::maxNameSize - 1] = '\0';
+        break;
+    }
+    default:
+        DNOT_REACHED();
+        break;
+    }
+}
+
+static inline void appendVarint(QByteArray* column, quint64 value)
+{
+    while (value >= 0x80) {
+        column->append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    column->append(static_cast<char>(value));
+}
+
+// Reads a varint, returns nullptr if it overflows the given end.
+static inline const uchar* readVarint(const uchar* data, const uchar* end, quint64* value)
+{
+    quint64 result = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        const uchar byte = *data++;
+        result |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return data;
+        }
+    }
+    return nullptr;
+}
+
+static inline quint64 zigzagEncode(quint64 delta)
+{
+    return (delta << 1) ^ static_cast<quint64>(static_cast<qint64>(delta) >> 63);
+}
+
+static inline quint64 zigzagDecode(quint64 value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+#endif  // COMPACTLOG_P_H
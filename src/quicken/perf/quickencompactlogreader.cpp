@@ -0,0 +1,203 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickencompactlogreader_p.h"
+
+#include <string.h>
+
+#include <QtCore/QDir>
+
+#include "quickenlogger.h"
+#include "quickenglobal_p.h"
+
+QuickenCompactLogReader::QuickenCompactLogReader(const QString& fileName)
+    : d_ptr(new QuickenCompactLogReaderPrivate(fileName))
+{
+}
+
+QuickenCompactLogReaderPrivate::QuickenCompactLogReaderPrivate(const QString& fileName)
+    : m_data(nullptr)
+    , m_clockOrigin(0)
+    , m_processId(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        WARN("CompactLogReader: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        return;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(QuickenCompactLogHeader))) {
+        WARN("CompactLogReader: File '%s' is too small.", fileName.toLatin1().constData());
+        return;
+    }
+
+    uchar* map = m_file.map(0, fileSize);
+    if (!map) {
+        WARN("CompactLogReader: Can't map file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        return;
+    }
+
+    QuickenCompactLogHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, "QUICKENC", sizeof(header.magic))
+        || header.version != compactLogVersion
+        || header.endianness != (Q_BYTE_ORDER == Q_LITTLE_ENDIAN ?
+                                 QuickenBinaryLogHeader::LittleEndian :
+                                 QuickenBinaryLogHeader::BigEndian)) {
+        WARN("CompactLogReader: File '%s' has an incompatible format.",
+             fileName.toLatin1().constData());
+        m_file.unmap(map);
+        return;
+    }
+
+    // Index the blocks, stopping at the first incomplete or corrupted one.
+    // Blocks of metrics types unknown to the running library are skipped.
+    // Blocks are not aligned so headers are copied before being read.
+    qint64 offset = sizeof(header);
+    while (fileSize - offset >= static_cast<qint64>(sizeof(QuickenCompactBlockHeader))) {
+        QuickenCompactBlockHeader blockHeader;
+        memcpy(&blockHeader, map + offset, sizeof(blockHeader));
+        offset += sizeof(blockHeader);
+        if (blockHeader.magic != QuickenCompactBlockHeader::magicNumber
+            || blockHeader.fieldCount > maxCompactFieldCount
+            || blockHeader.recordCount > static_cast<quint32>(compactBlockSize)
+            || fileSize - offset < blockHeader.payloadSize) {
+            break;
+        }
+        if (blockHeader.type >= QuickenMetrics::TypeCount) {
+            offset += blockHeader.payloadSize;
+            continue;
+        }
+        Block block;
+        block.info.type = static_cast<QuickenMetrics::Type>(blockHeader.type);
+        block.info.window = blockHeader.window;
+        block.info.count = blockHeader.recordCount;
+        block.info.firstTimeStamp = blockHeader.firstTimeStamp;
+        block.info.lastTimeStamp = blockHeader.lastTimeStamp;
+        block.payloadOffset = offset;
+        block.payloadSize = blockHeader.payloadSize;
+        block.fieldCount = blockHeader.fieldCount;
+        m_blocks.append(block);
+        offset += blockHeader.payloadSize;
+    }
+
+    m_data = map;
+    m_clockOrigin = header.clockOrigin;
+    m_processId = header.processId;
+}
+
+QuickenCompactLogReader::~QuickenCompactLogReader()
+{
+    // The mapping is released when closing the file.
+    delete d_ptr;
+}
+
+bool QuickenCompactLogReader::isOpen()
+{
+    return !!d_func()->m_data;
+}
+
+quint32 QuickenCompactLogReader::processId()
+{
+    return d_func()->m_processId;
+}
+
+quint64 QuickenCompactLogReader::clockOrigin()
+{
+    return d_func()->m_clockOrigin;
+}
+
+int QuickenCompactLogReader::blockCount()
+{
+    return d_func()->m_blocks.size();
+}
+
+QuickenCompactLogReader::BlockInfo QuickenCompactLogReader::blockInfo(int index)
+{
+    Q_D(QuickenCompactLogReader);
+    DASSERT(index >= 0);
+    DASSERT(index < d->m_blocks.size());
+
+    return d->m_blocks[index].info;
+}
+
+bool QuickenCompactLogReader::readBlock(int index, QVector<QuickenMetrics>* records)
+{
+    Q_D(QuickenCompactLogReader);
+    DASSERT(index >= 0);
+    DASSERT(index < d->m_blocks.size());
+    DASSERT(records);
+
+    const QuickenCompactLogReaderPrivate::Block& block = d->m_blocks[index];
+    const QByteArray payload =
+        qUncompress(d->m_data + block.payloadOffset, static_cast<int>(block.payloadSize));
+    if (payload.isEmpty()) {
+        return false;
+    }
+    const uchar* data = reinterpret_cast<const uchar*>(payload.constData());
+    const uchar* const end = data + payload.size();
+
+    // Values are decoded field by field. Fields unknown to the running library
+    // are skipped, fields missing from the file are left to 0.
+    const int count = block.info.count;
+    const int fieldCount = compactFieldCount(block.info.type);
+    QVector<quint64> values(count * maxCompactFieldCount, 0);
+    for (int field = 0; field < block.fieldCount; ++field) {
+        quint64 size;
+        if (!(data = readVarint(data, end, &size)) || size > static_cast<quint64>(end - data)) {
+            return false;
+        }
+        if (field < fieldCount) {
+            const uchar* column = data;
+            quint64 previous = 0;
+            for (int i = 0; i < count; ++i) {
+                quint64 delta;
+                if (!(column = readVarint(column, data + size, &delta))) {
+                    return false;
+                }
+                previous += zigzagDecode(delta);
+                values[i * maxCompactFieldCount + field] = previous;
+            }
+        }
+        data += size;
+    }
+
+    const int first = records->size();
+    records->resize(first + count);
+    QuickenMetrics* metrics = records->data() + first;
+    memset(metrics, 0, count * sizeof(QuickenMetrics));
+    for (int i = 0; i < count; ++i) {
+        metrics[i].type = block.info.type;
+        setCompactFields(&metrics[i], values.constData() + i * maxCompactFieldCount);
+    }
+
+    if (block.info.type == QuickenMetrics::Generic) {
+        quint64 size;
+        if (!(data = readVarint(data, end, &size)) || size > static_cast<quint64>(end - data)) {
+            records->resize(first);
+            return false;
+        }
+        const uchar* const stringsEnd = data + size;
+        for (int i = 0; i < count; ++i) {
+            const quint32 stringSize = metrics[i].generic.stringSize;
+            if (stringSize > static_cast<quint32>(stringsEnd - data)) {
+                records->resize(first);
+                return false;
+            }
+            memcpy(metrics[i].generic.string, data, stringSize);
+            data += stringSize;
+        }
+    }
+
+    return true;
+}
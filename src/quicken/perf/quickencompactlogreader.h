@@ -0,0 +1,61 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef COMPACTLOGREADER_H
+#define COMPACTLOGREADER_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <Quicken/quickenmetrics.h>
+#include <Quicken/quickenglobal.h>
+
+class QuickenCompactLogReaderPrivate;
+
+// Read a file written by QuickenCompactLogger. The file is memory-mapped and
+// its blocks are indexed at construction, each block can then be decoded
+// independently of the others.
+class QUICKEN_EXPORT QuickenCompactLogReader
+{
+public:
+    struct BlockInfo {
+        QuickenMetrics::Type type;
+        quint32 window;  // Window id for frame metrics, thread id for thread metrics, 0 otherwise.
+        int count;
+        quint64 firstTimeStamp;
+        quint64 lastTimeStamp;
+    };
+
+    QuickenCompactLogReader(const QString& fileName);
+    ~QuickenCompactLogReader();
+
+    // Get whether the file has been mapped successfully and has been written
+    // with a compatible format.
+    bool isOpen();
+
+    // Get the id of the logged process and the CLOCK_REALTIME value in
+    // nanoseconds corresponding to a metrics time stamp of 0.
+    quint32 processId();
+    quint64 clockOrigin();
+
+    // Get the number of complete blocks. A block partially written at the end
+    // of the file is not counted. Blocks are in write order, which means that
+    // blocks of different types or windows overlap in time.
+    int blockCount();
+
+    // Get the description of the block at the given index.
+    BlockInfo blockInfo(int index);
+
+    // Decode the records of the block at the given index and append them to
+    // records in chronological order. Returns false if the block is corrupted.
+    bool readBlock(int index, QVector<QuickenMetrics>* records);
+
+private:
+    QuickenCompactLogReaderPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenCompactLogReader)
+    Q_DISABLE_COPY(QuickenCompactLogReader)
+};
+
+#endif  // COMPACTLOGREADER_H
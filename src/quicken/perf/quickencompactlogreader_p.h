@@ -0,0 +1,35 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef COMPACTLOGREADER_P_H
+#define COMPACTLOGREADER_P_H
+
+#include <Quicken/quickencompactlogreader.h>
+
+#include <QtCore/QFile>
+
+#include <Quicken/private/quickenglobal_p.h>
+#include <Quicken/private/quickencompactlog_p.h>
+
+class QUICKEN_PRIVATE_EXPORT QuickenCompactLogReaderPrivate
+{
+public:
+    struct Block {
+        QuickenCompactLogReader::BlockInfo info;
+        qint64 payloadOffset;
+        quint32 payloadSize;
+        int fieldCount;
+    };
+
+    QuickenCompactLogReaderPrivate(const QString& fileName);
+
+    QFile m_file;
+    QVector<Block> m_blocks;
+    const uchar* m_data;  // nullptr if not open.
+    quint64 m_clockOrigin;
+    quint32 m_processId;
+};
+
+#endif  // COMPACTLOGREADER_P_H
@@ -6,18 +6,56 @@
 
 #include "quickenlogger_p.h"
 
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
-#include <QtCore/QTime>
+#include <QtCore/QFileInfo>
 
+#include <zlib.h>
+
+#include "quickenallocationtracker_p.h"
 #include "quickenmetrics.h"
 #include "quickenglobal_p.h"
 
+void QuickenLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    for (int i = 0; i < count; ++i) {
+        log(metrics[i]);
+    }
+}
+
+const int fileBufferSize = 64 * 1024;
+const int maxFileLineSize = 1024;  // Max size of a formatted metrics line.
+
 QuickenFileLogger::QuickenFileLogger(const QString& fileName, bool parsable)
     : d_ptr(new QuickenFileLoggerPrivate(fileName, parsable))
 {
 }
 
 QuickenFileLoggerPrivate::QuickenFileLoggerPrivate(const QString& fileName, bool parsable)
+    : m_buffer(new char [fileBufferSize])
+    , m_bufferSize(0)
+    , m_flushSize(0)
+    , m_flushInterval(-1)
+    , m_segmentSize(0)
+    , m_rotationSize(0)
+    , m_rotationAge(0)
+    , m_maxSegmentCount(0)
+    , m_segmentIndex(-1)
+    , m_segmentCompression(false)
 {
     if (QDir::isRelativePath(fileName)) {
         m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
@@ -26,14 +64,13 @@ QuickenFileLoggerPrivate::QuickenFileLoggerPrivate(const QString& fileName, bool
     }
 
     if (m_file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Unbuffered)) {
-        m_textStream.setDevice(&m_file);
-        m_textStream.setCodec("ISO 8859-1");
-        m_textStream.setRealNumberPrecision(2);
-        m_textStream.setRealNumberNotation(QTextStream::FixedNotation);
-        m_flags = Open | Parsable;
+        m_flags = Open | Parsable | FlushOnWindowHide;
         if (parsable) {
             m_flags |= Parsable;
         }
+        m_flushTimer.start();
+        m_segmentTimer.start();
+        m_segmentPool.setMaxThreadCount(1);
     } else {
         m_flags = 0;
         WARN("FileLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
@@ -47,21 +84,28 @@ QuickenFileLogger::QuickenFileLogger(FILE* fileHandle, bool parsable)
 }
 
 QuickenFileLoggerPrivate::QuickenFileLoggerPrivate(FILE* fileHandle, bool parsable)
+    : m_buffer(new char [fileBufferSize])
+    , m_bufferSize(0)
+    , m_flushSize(0)
+    , m_flushInterval(-1)
+    , m_segmentSize(0)
+    , m_rotationSize(0)
+    , m_rotationAge(0)
+    , m_maxSegmentCount(0)
+    , m_segmentIndex(-1)
+    , m_segmentCompression(false)
 {
     if (m_file.open(fileHandle, QIODevice::WriteOnly | QIODevice::Text | QIODevice::Unbuffered)) {
-        m_textStream.setDevice(&m_file);
-        m_textStream.setCodec("ISO 8859-1");
-        m_textStream.setRealNumberPrecision(2);
-        m_textStream.setRealNumberNotation(QTextStream::FixedNotation);
         if ((fileHandle == stdout || fileHandle == stderr) &&
             !qEnvironmentVariableIsSet("QUICKEN_NO_LOGGER_COLOR")) {
-            m_flags = Open | Colored;
+            m_flags = Open | Colored | FlushOnWindowHide;
         } else {
-            m_flags = Open;
+            m_flags = Open | FlushOnWindowHide;
         }
         if (parsable) {
             m_flags |= Parsable;
         }
+        m_flushTimer.start();
     } else {
         m_flags = 0;
         WARN("FileLogger: Can't open file handle '%s'.",
@@ -74,127 +118,914 @@ QuickenFileLogger::~QuickenFileLogger()
     delete d_ptr;
 }
 
+QuickenFileLoggerPrivate::~QuickenFileLoggerPrivate()
+{
+    if (m_flags & Open) {
+        flush();
+    }
+    m_segmentPool.waitForDone();
+    delete [] m_buffer;
+}
+
 bool QuickenFileLogger::isOpen()
 {
     return !!(d_func()->m_flags & QuickenFileLoggerPrivate::Open);
 }
 
-// FIXME(loicm) We should maybe get rid of QTextStream and directly write to the
-//     device for efficiency reasons.
-
 void QuickenFileLogger::log(const QuickenMetrics& metrics)
 {
-    d_func()->log(metrics);
+    Q_D(QuickenFileLogger);
+
+    if (d->m_flags & QuickenFileLoggerPrivate::Open) {
+        d->log(metrics);
+        d->flushIfNeeded();
+    }
 }
 
-void QuickenFileLoggerPrivate::log(const QuickenMetrics& metrics)
+void QuickenFileLogger::logBatch(const QuickenMetrics* metrics, int count)
 {
-    if (m_flags & Open) {
-        // ANSI/VT100 terminal codes.
-        const char* const dim = m_flags & Colored ? "\033[02m" : "";
-        const char* const reset = m_flags & Colored ? "\033[00m" : "";
-        const char* const dimColon = m_flags & Colored ? "\033[02m:\033[00m" : "=";
-
-        QTime timeStamp = QTime(0, 0).addMSecs(metrics.timeStamp / 1000000);
-        QString timeString = !timeStamp.hour()
-            ? timeStamp.toString(QStringLiteral("mm:ss:zzz"))
-            : timeStamp.toString(QStringLiteral("hh:mm:ss:zzz"));
-
-        switch (metrics.type) {
-        case QuickenMetrics::Process: {
-            if (m_flags & Parsable) {
-                m_textStream
-                    << "P "
-                    << metrics.timeStamp << ' '
-                    << metrics.process.cpuUsage << ' '
-                    << metrics.process.vszMemory << ' '
-                    << metrics.process.rssMemory << ' '
-                    << metrics.process.threadCount << '\n' << flush;
-            } else {
-                m_textStream
-                    << (m_flags & Colored ? "\033[33mP\033[00m " : "P ")
-                    << dim << timeString << reset << ' '
-                    << "CPU" << dimColon << metrics.process.cpuUsage << "% "
-                    << "VSZ" << dimColon << metrics.process.vszMemory << "kB "
-                    << "RSS" << dimColon << metrics.process.rssMemory << "kB "
-                    << "Threads" << dimColon << metrics.process.threadCount
-                    << '\n' << flush;
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+    Q_D(QuickenFileLogger);
+
+    if (d->m_flags & QuickenFileLoggerPrivate::Open) {
+        for (int i = 0; i < count; ++i) {
+            d->log(metrics[i]);
+        }
+        d->flushIfNeeded();
+    }
+}
+
+void QuickenFileLogger::flush()
+{
+    Q_D(QuickenFileLogger);
+
+    if (d->m_flags & QuickenFileLoggerPrivate::Open) {
+        d->flush();
+    }
+}
+
+void QuickenFileLoggerPrivate::flush()
+{
+    DASSERT(m_flags & Open);
+
+    if (m_bufferSize > 0) {
+        if (rotationNeeded()) {
+            rotate();
+            if (!(m_flags & Open)) {
+                m_bufferSize = 0;
+                return;
             }
+        }
+        if (m_segmentSize == 0 && rotationEnabled()) {
+            writeSegmentHeader();
+        }
+        if (m_file.write(m_buffer, m_bufferSize) != m_bufferSize) {
+            WARN("FileLogger: Can't write to file '%s'.",
+                 m_file.errorString().toLatin1().constData());
+        }
+        m_segmentSize += m_bufferSize;
+        m_bufferSize = 0;
+    }
+    m_flags &= ~FlushRequested;
+    m_flushTimer.start();
+}
+
+void QuickenFileLoggerPrivate::flushIfNeeded()
+{
+    if (m_bufferSize >= m_flushSize || (m_flags & FlushRequested)
+        || (m_flushInterval >= 0 && m_flushTimer.hasExpired(m_flushInterval))) {
+        flush();
+    }
+}
+
+bool QuickenFileLoggerPrivate::rotationEnabled()
+{
+    // File handles have no file name and can't be rotated.
+    return (m_rotationSize > 0 || m_rotationAge > 0) && !m_file.fileName().isEmpty();
+}
+
+bool QuickenFileLoggerPrivate::rotationNeeded()
+{
+    // Segments are only rotated between buffer writes, a segment can therefore
+    // exceed the rotation size by less than a buffer.
+    return m_segmentSize > 0 && rotationEnabled()
+        && ((m_rotationSize > 0 && m_segmentSize + m_bufferSize > m_rotationSize)
+            || (m_rotationAge > 0 && m_segmentTimer.hasExpired(m_rotationAge)));
+}
+
+// Get the sorted indices of the closed segments of a log file, compressed or
+// not.
+static QList<qint64> segmentIndices(const QString& fileName)
+{
+    const QFileInfo fileInfo(fileName);
+    const QString prefix = fileInfo.fileName() + QLatin1Char('.');
+    const QStringList entries =
+        fileInfo.dir().entryList(QStringList(prefix + QLatin1Char('*')), QDir::Files);
+
+    QList<qint64> indices;
+    for (int i = 0; i < entries.size(); ++i) {
+        QStringRef suffix = entries[i].midRef(prefix.size());
+        if (suffix.endsWith(QLatin1String(".gz"))) {
+            suffix = suffix.left(suffix.size() - 3);
+        }
+        bool ok;
+        const qint64 index = suffix.toLongLong(&ok);
+        if (ok && index >= 0 && !indices.contains(index)) {
+            indices.append(index);
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+void QuickenFileLoggerPrivate::rotate()
+{
+    DASSERT(m_flags & Open);
+
+    // Segments of previous runs are kept, indices start after the last one.
+    const QString fileName = m_file.fileName();
+    if (m_segmentIndex < 0) {
+        const QList<qint64> indices = segmentIndices(fileName);
+        m_segmentIndex = indices.isEmpty() ? 0 : indices.last();
+    }
+    const QString segmentName =
+        fileName + QLatin1Char('.') + QString::number(++m_segmentIndex);
+
+    m_file.close();
+    if (!QFile::rename(fileName, segmentName)) {
+        WARN("FileLogger: Can't rename file '%s' to '%s'.", fileName.toLatin1().constData(),
+             segmentName.toLatin1().constData());
+    } else {
+        m_segmentPool.start(new FileLoggerSegmentJob(
+            fileName, segmentName, m_maxSegmentCount, m_segmentCompression));
+    }
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Unbuffered)) {
+        m_flags &= ~Open;
+        WARN("FileLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+    }
+    m_segmentSize = 0;
+    m_segmentTimer.start();
+}
+
+void QuickenFileLoggerPrivate::writeSegmentHeader()
+{
+    char header[128];
+    const int size = qsnprintf(
+        header, sizeof(header), "# Quicken metrics log pid %u clock origin %llu\n",
+        static_cast<unsigned int>(QCoreApplication::applicationPid()),
+        static_cast<unsigned long long>(QuickenMetricsUtils::timeStampOrigin()));
+    if (m_file.write(header, size) == size) {
+        m_segmentSize += size;
+    } else {
+        WARN("FileLogger: Can't write to file '%s'.",
+             m_file.errorString().toLatin1().constData());
+    }
+}
+
+const int segmentChunkSize = 64 * 1024;
+
+// Compresses a file to a gzip file chunk by chunk, so that the memory used
+// doesn't depend on the size of the file. Returns false on error.
+static bool gzipCompress(QFile* input, QFile* output)
+{
+    // A window size above 15 makes zlib write a gzip header and trailer
+    // instead of the zlib ones, so that the segments can be read with standard
+    // tools.
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    QByteArray inputChunk(segmentChunkSize, Qt::Uninitialized);
+    QByteArray outputChunk(segmentChunkSize, Qt::Uninitialized);
+    bool success = true;
+    int flush;
+    do {
+        const qint64 size = input->read(inputChunk.data(), segmentChunkSize);
+        if (size < 0) {
+            success = false;
             break;
         }
+        flush = input->atEnd() || size == 0 ? Z_FINISH : Z_NO_FLUSH;
+        stream.next_in = reinterpret_cast<Bytef*>(inputChunk.data());
+        stream.avail_in = static_cast<uInt>(size);
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(outputChunk.data());
+            stream.avail_out = segmentChunkSize;
+            deflate(&stream, flush);
+            const qint64 outputSize = segmentChunkSize - stream.avail_out;
+            if (output->write(outputChunk.constData(), outputSize) != outputSize) {
+                success = false;
+                break;
+            }
+        } while (stream.avail_out == 0);
+    } while (success && flush != Z_FINISH);
+
+    deflateEnd(&stream);
+    return success;
+}
 
-        case QuickenMetrics::Frame:
-            if (m_flags & Parsable) {
-                m_textStream
-                    << "F "
-                    << metrics.timeStamp << ' '
-                    << metrics.frame.window << ' '
-                    << metrics.frame.number << ' '
-                    << metrics.frame.deltaTime << ' '
-                    << metrics.frame.syncTime << ' '
-                    << metrics.frame.renderTime << ' '
-                    << metrics.frame.gpuTime << ' '
-                    << metrics.frame.swapTime << '\n' << flush;
+void FileLoggerSegmentJob::run()
+{
+    if (m_compression) {
+        QFile segment(m_segmentName);
+        QFile compressedSegment(m_segmentName + QLatin1String(".gz"));
+        if (segment.open(QIODevice::ReadOnly)) {
+            if (compressedSegment.open(QIODevice::WriteOnly)
+                && gzipCompress(&segment, &compressedSegment)) {
+                compressedSegment.close();
+                segment.close();
+                segment.remove();
             } else {
-                m_textStream
-                    << (m_flags & Colored ? "\033[36mF\033[00m " : "F ")
-                    << dim << timeString << reset << ' '
-                    << "Win" << dimColon << metrics.frame.window << ' '
-                    << "N" << dimColon << metrics.frame.number << ' '
-                    << "Delta" << dimColon << metrics.frame.deltaTime / 1000000.0f << "ms "
-                    << "Sync" << dimColon << metrics.frame.syncTime / 1000000.0f << "ms "
-                    << "Render" << dimColon << metrics.frame.renderTime / 1000000.0f << "ms "
-                    << "GPU" << dimColon << metrics.frame.gpuTime / 1000000.0f << "ms "
-                    << "Swap" << dimColon << metrics.frame.swapTime / 1000000.0f << "ms\n" << flush;
+                WARN("FileLogger: Can't compress segment '%s'.",
+                     m_segmentName.toLatin1().constData());
+                compressedSegment.remove();
             }
-            break;
+        }
+    }
 
-        case QuickenMetrics::Window: {
-            if (m_flags & Parsable) {
-                m_textStream
-                    << "W "
-                    << metrics.timeStamp << ' '
-                    << metrics.window.id << ' '
-                    << metrics.window.state << ' '
-                    << metrics.window.width << ' '
-                    << metrics.window.height << '\n' << flush;
-            } else {
-                const char* const stateString[] = { "Hidden", "Shown", "Resized" };
-                Q_STATIC_ASSERT(ARRAY_SIZE(stateString) == QuickenWindowMetrics::StateCount);
-                m_textStream
-                    << (m_flags & Colored ? "\033[35mW\033[00m " : "W ")
-                    << dim << timeString << reset << ' '
-                    << "Id" << dimColon << metrics.window.id << ' '
-                    << "State" << dimColon << stateString[metrics.window.state] << ' '
-                    << "Size" << dimColon << metrics.window.width << 'x' << metrics.window.height
-                    << '\n' << flush;
+    if (m_maxSegmentCount > 0) {
+        const QList<qint64> indices = segmentIndices(m_fileName);
+        for (int i = 0; i < indices.size() - m_maxSegmentCount; ++i) {
+            const QString segmentName = m_fileName + QLatin1Char('.') + QString::number(indices[i]);
+            QFile::remove(segmentName);
+            QFile::remove(segmentName + QLatin1String(".gz"));
+        }
+    }
+}
+
+static char* writeString(char* text, const char* string)
+{
+    while (*string != '\0') {
+        *text++ = *string++;
+    }
+    return text;
+}
+
+static char* writeInteger(char* text, quint64 value)
+{
+    char digits[20];
+    int digitCount = 0;
+    do {
+        digits[digitCount++] = (value % 10) + '0';
+        value /= 10;
+    } while (value != 0);
+    do {
+        *text++ = digits[--digitCount];
+    } while (digitCount > 0);
+    return text;
+}
+
+static char* writeSignedInteger(char* text, qint64 value)
+{
+    if (value < 0) {
+        *text++ = '-';
+    }
+    return writeInteger(text, value < 0 ? -static_cast<quint64>(value) : value);
+}
+
+// Writes a zero padded integer.
+static char* writePaddedInteger(char* text, quint32 value, int width)
+{
+    for (int i = width - 1; i >= 0; --i) {
+        text[i] = (value % 10) + '0';
+        value /= 10;
+    }
+    return text + width;
+}
+
+// Writes a time in nanoseconds as milliseconds with two decimal digits. The
+// conversion to milliseconds is done in single precision and the rounding of
+// the decimal part is done half up to output exactly what QTextStream did.
+static char* writeTime(char* text, quint64 time)
+{
+    const double value = static_cast<double>(time / 1000000.0f) * 100.0;  // Exact.
+    quint64 hundredths = static_cast<quint64>(value);
+    if (value - static_cast<double>(hundredths) >= 0.5) {
+        hundredths++;
+    }
+    text = writeInteger(text, hundredths / 100);
+    *text++ = '.';
+    return writePaddedInteger(text, static_cast<quint32>(hundredths % 100), 2);
+}
+
+static char* writeSignedTime(char* text, qint64 time)
+{
+    if (time < 0) {
+        *text++ = '-';
+    }
+    return writeTime(text, time < 0 ? -static_cast<quint64>(time) : time);
+}
+
+// Writes a time stamp in nanoseconds as "mm:ss:zzz", or "hh:mm:ss:zzz" past the
+// first hour, wrapping every day like QTime did.
+static char* writeTimeStamp(char* text, quint64 timeStamp)
+{
+    const int msecsPerDay = 86400000;
+    const int msecs = static_cast<int>(timeStamp / 1000000);
+    const quint32 dayMsecs = ((msecs % msecsPerDay) + msecsPerDay) % msecsPerDay;
+    const quint32 hours = dayMsecs / 3600000;
+    if (hours != 0) {
+        text = writePaddedInteger(text, hours, 2);
+        *text++ = ':';
+    }
+    text = writePaddedInteger(text, (dayMsecs / 60000) % 60, 2);
+    *text++ = ':';
+    text = writePaddedInteger(text, (dayMsecs / 1000) % 60, 2);
+    *text++ = ':';
+    return writePaddedInteger(text, dayMsecs % 1000, 3);
+}
+
+void QuickenFileLoggerPrivate::log(const QuickenMetrics& metrics)
+{
+    DASSERT(m_flags & Open);
+
+    if (fileBufferSize - m_bufferSize < maxFileLineSize) {
+        flush();
+    }
+
+    // ANSI/VT100 terminal codes.
+    const char* const dim = m_flags & Colored ? "\033[02m" : "";
+    const char* const reset = m_flags & Colored ? "\033[00m" : "";
+    const char* const dimColon = m_flags & Colored ? "\033[02m:\033[00m" : "=";
+    const bool parsable = m_flags & Parsable;
+    char* text = &m_buffer[m_bufferSize];
+
+    if (!parsable) {
+        const char* const typeString[] = {
+            "\033[33mP\033[00m ", "\033[35mW\033[00m ", "\033[36mF\033[00m ",
+            "\033[32mG\033[00m ", "\033[34mT\033[00m ", "\033[31mM\033[00m ",
+            "\033[37mX\033[00m ", "\033[94mJ\033[00m ", "\033[93mB\033[00m ",
+            "\033[92mA\033[00m ", "\033[91mI\033[00m ", "\033[96mS\033[00m "
+        };
+        Q_STATIC_ASSERT(ARRAY_SIZE(typeString) == QuickenMetrics::TypeCount);
+        DASSERT(metrics.type < QuickenMetrics::TypeCount);
+        if (m_flags & Colored) {
+            text = writeString(text, typeString[metrics.type]);
+        } else {
+            *text++ = "PWFGTMXJBAIS"[metrics.type];
+            *text++ = ' ';
+        }
+        text = writeString(text, dim);
+        text = writeTimeStamp(text, metrics.timeStamp);
+        text = writeString(text, reset);
+        *text++ = ' ';
+    }
+
+    switch (metrics.type) {
+    case QuickenMetrics::Process:
+        if (parsable) {
+            text = writeString(text, "P ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.cpuUsage);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.vszMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.rssMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.threadCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.droppedCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.minorFaults);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.majorFaults);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.voluntarySwitches);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.involuntarySwitches);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.readBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.writeBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.preciseCpuUsage);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.process.cpuTime);
+        } else {
+            text = writeString(writeString(text, "CPU"), dimColon);
+            text = writeInteger(text, metrics.process.preciseCpuUsage / 100);
+            *text++ = '.';
+            text = writePaddedInteger(text, metrics.process.preciseCpuUsage % 100, 2);
+            text = writeString(text, "% ");
+            text = writeString(writeString(text, "VSZ"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.vszMemory), "kB ");
+            text = writeString(writeString(text, "RSS"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.rssMemory), "kB ");
+            text = writeString(writeString(text, "Threads"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.threadCount), " ");
+            text = writeString(writeString(text, "Dropped"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.droppedCount), " ");
+            text = writeString(writeString(text, "Faults"), dimColon);
+            text = writeInteger(text, metrics.process.minorFaults);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.process.majorFaults), " ");
+            text = writeString(writeString(text, "Switches"), dimColon);
+            text = writeInteger(text, metrics.process.voluntarySwitches);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.process.involuntarySwitches), " ");
+            text = writeString(writeString(text, "Read"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.readBytes), "B ");
+            text = writeString(writeString(text, "Write"), dimColon);
+            text = writeString(writeInteger(text, metrics.process.writeBytes), "B");
+        }
+        break;
+
+    case QuickenMetrics::Frame:
+        if (parsable) {
+            text = writeString(text, "F ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.number);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.deltaTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.syncTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.renderTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.gpuTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.swapTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.cpuTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.renderAllocations);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.renderFrees);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.renderAllocatedBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.guiAllocations);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.guiFrees);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.guiAllocatedBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.opaqueNodes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.alphaNodes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.unmergeableNodes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.drawCalls);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.vertexBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.frame.indexBytes);
+        } else {
+            text = writeString(writeString(text, "Win"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.window), " ");
+            text = writeString(writeString(text, "N"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.number), " ");
+            text = writeString(writeString(text, "Delta"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.deltaTime), "ms ");
+            text = writeString(writeString(text, "Sync"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.syncTime), "ms ");
+            text = writeString(writeString(text, "Render"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.renderTime), "ms ");
+            text = writeString(writeString(text, "GPU"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.gpuTime), "ms ");
+            text = writeString(writeString(text, "Swap"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.swapTime), "ms ");
+            text = writeString(writeString(text, "CPU"), dimColon);
+            text = writeString(writeTime(text, metrics.frame.cpuTime), "ms ");
+            text = writeString(writeString(text, "Opaque"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.opaqueNodes), " ");
+            text = writeString(writeString(text, "Alpha"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.alphaNodes), " ");
+            text = writeString(writeString(text, "Unmergeable"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.unmergeableNodes), " ");
+            text = writeString(writeString(text, "Draws"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.drawCalls), " ");
+            text = writeString(writeString(text, "Vertices"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.vertexBytes), "B ");
+            text = writeString(writeString(text, "Indices"), dimColon);
+            text = writeString(writeInteger(text, metrics.frame.indexBytes), "B");
+            if (QuickenAllocationTracker::isAvailable()) {
+                // Render thread counts followed by GUI thread counts.
+                text = writeString(writeString(text, " Allocs"), dimColon);
+                text = writeInteger(text, metrics.frame.renderAllocations);
+                *text++ = '/';
+                text = writeString(writeInteger(text, metrics.frame.guiAllocations), " ");
+                text = writeString(writeString(text, "Frees"), dimColon);
+                text = writeInteger(text, metrics.frame.renderFrees);
+                *text++ = '/';
+                text = writeString(writeInteger(text, metrics.frame.guiFrees), " ");
+                text = writeString(writeString(text, "Allocated"), dimColon);
+                text = writeString(writeInteger(text, metrics.frame.renderAllocatedBytes), "B/");
+                text = writeString(writeInteger(text, metrics.frame.guiAllocatedBytes), "B");
             }
-            break;
         }
+        break;
 
-        case QuickenMetrics::Generic: {
-            if (m_flags & Parsable) {
-                m_textStream
-                    << "G "
-                    << metrics.timeStamp << ' '
-                    << metrics.generic.id << ' '
-                    << metrics.generic.string << '\n' << flush;
-            } else {
-                m_textStream
-                    << (m_flags & Colored ? "\033[32mG\033[00m " : "G ")
-                    << dim << timeString << reset << ' '
-                    << "Id" << dimColon << metrics.generic.id << ' '
-                    << "String" << dimColon << '"' << metrics.generic.string << '"'
-                    << '\n' << flush;
+    case QuickenMetrics::Window:
+        if (parsable) {
+            text = writeString(text, "W ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.window.id);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.window.state);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.window.width);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.window.height);
+        } else {
+            const char* const stateString[] = { "Hidden", "Shown", "Resized" };
+            Q_STATIC_ASSERT(ARRAY_SIZE(stateString) == QuickenWindowMetrics::StateCount);
+            text = writeString(writeString(text, "Id"), dimColon);
+            text = writeString(writeInteger(text, metrics.window.id), " ");
+            text = writeString(writeString(text, "State"), dimColon);
+            text = writeString(writeString(text, stateString[metrics.window.state]), " ");
+            text = writeString(writeString(text, "Size"), dimColon);
+            text = writeInteger(text, metrics.window.width);
+            *text++ = 'x';
+            text = writeInteger(text, metrics.window.height);
+        }
+        if ((metrics.window.state == QuickenWindowMetrics::Hidden)
+            && (m_flags & FlushOnWindowHide)) {
+            m_flags |= FlushRequested;
+        }
+        break;
+
+    case QuickenMetrics::Generic: {
+        const int stringSize = static_cast<int>(
+            strnlen(metrics.generic.string, QuickenGenericMetrics::maxStringSize));
+        if (parsable) {
+            text = writeString(text, "G ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.generic.id);
+            *text++ = ' ';
+        } else {
+            text = writeString(writeString(text, "Id"), dimColon);
+            text = writeString(writeInteger(text, metrics.generic.id), " ");
+            text = writeString(writeString(text, "String"), dimColon);
+            *text++ = '"';
+        }
+        memcpy(text, metrics.generic.string, stringSize);
+        text += stringSize;
+        if (!parsable) {
+            *text++ = '"';
+        }
+        break;
+    }
+
+    case QuickenMetrics::Thread: {
+        const int nameSize = static_cast<int>(
+            strnlen(metrics.thread.name, QuickenThreadMetrics::maxNameSize));
+        if (parsable) {
+            text = writeString(text, "T ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.id);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.tags);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.cpuUsage);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.cpuTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.waitTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.thread.sliceCount);
+            *text++ = ' ';
+            memcpy(text, metrics.thread.name, nameSize);
+            text += nameSize;
+        } else {
+            const char* const tagString[] = { "Gui", "Render", "Logging", "Logger" };
+            text = writeString(writeString(text, "Id"), dimColon);
+            text = writeString(writeInteger(text, metrics.thread.id), " ");
+            text = writeString(writeString(text, "Name"), dimColon);
+            *text++ = '"';
+            memcpy(text, metrics.thread.name, nameSize);
+            text += nameSize;
+            text = writeString(text, "\" ");
+            if (metrics.thread.tags) {
+                text = writeString(writeString(text, "Tags"), dimColon);
+                bool first = true;
+                for (int i = 0; i < static_cast<int>(ARRAY_SIZE(tagString)); ++i) {
+                    if (metrics.thread.tags & (1 << i)) {
+                        if (!first) {
+                            *text++ = ',';
+                        }
+                        text = writeString(text, tagString[i]);
+                        first = false;
+                    }
+                }
+                *text++ = ' ';
             }
-            break;
+            if (metrics.thread.tags & QuickenThreadMetrics::Render) {
+                text = writeString(writeString(text, "Win"), dimColon);
+                text = writeString(writeInteger(text, metrics.thread.window), " ");
+            }
+            text = writeString(writeString(text, "CPU"), dimColon);
+            text = writeString(writeInteger(text, metrics.thread.cpuUsage), "% ");
+            text = writeString(writeString(text, "Run"), dimColon);
+            text = writeString(writeTime(text, metrics.thread.cpuTime), "ms ");
+            text = writeString(writeString(text, "Wait"), dimColon);
+            text = writeString(writeTime(text, metrics.thread.waitTime), "ms ");
+            text = writeString(writeString(text, "Slices"), dimColon);
+            text = writeInteger(text, metrics.thread.sliceCount);
         }
+        break;
+    }
 
-        default:
-            DNOT_REACHED();
-            break;
+    case QuickenMetrics::Memory:
+        if (parsable) {
+            text = writeString(text, "M ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.pssMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.privateCleanMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.privateDirtyMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.sharedMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.anonymousMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.memory.swapMemory);
+        } else {
+            text = writeString(writeString(text, "PSS"), dimColon);
+            text = writeString(writeInteger(text, metrics.memory.pssMemory), "kB ");
+            text = writeString(writeString(text, "Private"), dimColon);
+            text = writeInteger(text, metrics.memory.privateCleanMemory);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.memory.privateDirtyMemory), "kB ");
+            text = writeString(writeString(text, "Shared"), dimColon);
+            text = writeString(writeInteger(text, metrics.memory.sharedMemory), "kB ");
+            text = writeString(writeString(text, "Anon"), dimColon);
+            text = writeString(writeInteger(text, metrics.memory.anonymousMemory), "kB ");
+            text = writeString(writeString(text, "Swap"), dimColon);
+            text = writeString(writeInteger(text, metrics.memory.swapMemory), "kB");
+        }
+        break;
+
+    case QuickenMetrics::Texture:
+        if (parsable) {
+            text = writeString(text, "X ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.frame);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.uploadCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.uploadedBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.atlasUploadCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.atlasUploadedBytes);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.textureCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.textureMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.atlasCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.texture.atlasMemory);
+        } else {
+            text = writeString(writeString(text, "Win"), dimColon);
+            text = writeString(writeInteger(text, metrics.texture.window), " ");
+            text = writeString(writeString(text, "N"), dimColon);
+            text = writeString(writeInteger(text, metrics.texture.frame), " ");
+            text = writeString(writeString(text, "Uploads"), dimColon);
+            text = writeInteger(text, metrics.texture.uploadCount);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.texture.uploadedBytes), "B ");
+            text = writeString(writeString(text, "AtlasUploads"), dimColon);
+            text = writeInteger(text, metrics.texture.atlasUploadCount);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.texture.atlasUploadedBytes), "B ");
+            text = writeString(writeString(text, "Textures"), dimColon);
+            text = writeInteger(text, metrics.texture.textureCount);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.texture.textureMemory), "kB ");
+            text = writeString(writeString(text, "Atlases"), dimColon);
+            text = writeInteger(text, metrics.texture.atlasCount);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.texture.atlasMemory), "kB");
         }
+        break;
+
+    case QuickenMetrics::JavaScript:
+        if (parsable) {
+            text = writeString(text, "J ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.frame);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.usedMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.largeItemMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.allocatedMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.collections);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.collectionCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.reclaimedMemory);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.javaScript.collectionTimeBound);
+        } else {
+            text = writeString(writeString(text, "Win"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.window), " ");
+            text = writeString(writeString(text, "N"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.frame), " ");
+            text = writeString(writeString(text, "Used"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.usedMemory), "kB ");
+            text = writeString(writeString(text, "Large"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.largeItemMemory), "kB ");
+            text = writeString(writeString(text, "Allocated"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.allocatedMemory), "kB ");
+            text = writeString(writeString(text, "GC"), dimColon);
+            text = writeInteger(text, metrics.javaScript.collections);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.javaScript.collectionCount), " ");
+            text = writeString(writeString(text, "Reclaimed"), dimColon);
+            text = writeString(writeInteger(text, metrics.javaScript.reclaimedMemory), "kB ");
+            text = writeString(writeString(text, "GCBound"), dimColon);
+            text = writeString(writeTime(text, metrics.javaScript.collectionTimeBound), "ms");
+        }
+        break;
+
+    case QuickenMetrics::Binding: {
+        const int locationSize = static_cast<int>(
+            strnlen(metrics.binding.location, QuickenBindingMetrics::maxLocationSize));
+        if (parsable) {
+            text = writeString(text, "B ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.rank);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.evaluationCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.time);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.maxFrameEvaluationCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.maxFrameTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.totalEvaluationCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.binding.totalTime);
+            *text++ = ' ';
+            memcpy(text, metrics.binding.location, locationSize);
+            text += locationSize;
+        } else {
+            // Counts and times since the previous update followed by the
+            // highest ones in a single frame and by the ones since profiling
+            // started.
+            text = writeString(writeString(text, "Rank"), dimColon);
+            text = writeString(writeInteger(text, metrics.binding.rank), " ");
+            text = writeString(writeString(text, "Location"), dimColon);
+            *text++ = '"';
+            memcpy(text, metrics.binding.location, locationSize);
+            text += locationSize;
+            text = writeString(text, "\" ");
+            text = writeString(writeString(text, "Evals"), dimColon);
+            text = writeInteger(text, metrics.binding.evaluationCount);
+            *text++ = '/';
+            text = writeInteger(text, metrics.binding.maxFrameEvaluationCount);
+            *text++ = '/';
+            text = writeString(writeInteger(text, metrics.binding.totalEvaluationCount), " ");
+            text = writeString(writeString(text, "Time"), dimColon);
+            text = writeString(writeTime(text, metrics.binding.time), "ms/");
+            text = writeString(writeTime(text, metrics.binding.maxFrameTime), "ms/");
+            text = writeString(writeTime(text, metrics.binding.totalTime), "ms");
+        }
+        break;
+    }
+
+    case QuickenMetrics::Animation:
+        if (parsable) {
+            text = writeString(text, "A ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.frame);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.runningAnimationCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.tickCount);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.advanceTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.animationTime);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.animation.wallTime);
+            *text++ = ' ';
+            text = writeSignedInteger(text, metrics.animation.drift);
+            *text++ = ' ';
+            text = writeSignedInteger(text, metrics.animation.totalDrift);
+        } else {
+            text = writeString(writeString(text, "Win"), dimColon);
+            text = writeString(writeInteger(text, metrics.animation.window), " ");
+            text = writeString(writeString(text, "N"), dimColon);
+            text = writeString(writeInteger(text, metrics.animation.frame), " ");
+            text = writeString(writeString(text, "Running"), dimColon);
+            text = writeString(writeInteger(text, metrics.animation.runningAnimationCount), " ");
+            text = writeString(writeString(text, "Ticks"), dimColon);
+            text = writeString(writeInteger(text, metrics.animation.tickCount), " ");
+            text = writeString(writeString(text, "Advance"), dimColon);
+            text = writeString(writeTime(text, metrics.animation.advanceTime), "ms ");
+            // Animation clock followed by wall clock.
+            text = writeString(writeString(text, "Clock"), dimColon);
+            text = writeString(writeTime(text, metrics.animation.animationTime), "ms/");
+            text = writeString(writeTime(text, metrics.animation.wallTime), "ms ");
+            text = writeString(writeString(text, "Drift"), dimColon);
+            text = writeString(writeSignedTime(text, metrics.animation.drift), "ms/");
+            text = writeString(writeSignedTime(text, metrics.animation.totalDrift), "ms");
+        }
+        break;
+
+    case QuickenMetrics::Input:
+        if (parsable) {
+            text = writeString(text, "I ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.window);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.frame);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.type);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.action);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.queueingDelay);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.input.latency);
+        } else {
+            const char* const typeString[] = { "Touch", "Mouse", "Key" };
+            Q_STATIC_ASSERT(ARRAY_SIZE(typeString) == QuickenInputMetrics::TypeCount);
+            const char* const actionString[] = { "Press", "Move", "Release" };
+            Q_STATIC_ASSERT(ARRAY_SIZE(actionString) == QuickenInputMetrics::ActionCount);
+            text = writeString(writeString(text, "Win"), dimColon);
+            text = writeString(writeInteger(text, metrics.input.window), " ");
+            text = writeString(writeString(text, "N"), dimColon);
+            text = writeString(writeInteger(text, metrics.input.frame), " ");
+            text = writeString(writeString(text, "Event"), dimColon);
+            text = writeString(text, typeString[metrics.input.type]);
+            text = writeString(writeString(text, actionString[metrics.input.action]), " ");
+            text = writeString(writeString(text, "Queue"), dimColon);
+            text = writeString(writeTime(text, metrics.input.queueingDelay), "ms ");
+            text = writeString(writeString(text, "Latency"), dimColon);
+            text = writeString(writeTime(text, metrics.input.latency), "ms");
+        }
+        break;
+
+    case QuickenMetrics::Startup: {
+        const int nameSize = static_cast<int>(
+            strnlen(metrics.startup.name, QuickenStartupMetrics::maxNameSize));
+        if (parsable) {
+            text = writeString(text, "S ");
+            text = writeInteger(text, metrics.timeStamp);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.startup.milestone);
+            *text++ = ' ';
+            text = writeInteger(text, metrics.startup.time);
+            *text++ = ' ';
+            memcpy(text, metrics.startup.name, nameSize);
+            text += nameSize;
+        } else {
+            // Time since the start of the process.
+            text = writeString(writeString(text, "Milestone"), dimColon);
+            *text++ = '"';
+            memcpy(text, metrics.startup.name, nameSize);
+            text += nameSize;
+            text = writeString(text, "\" ");
+            text = writeString(writeString(text, "Time"), dimColon);
+            text = writeString(writeTime(text, metrics.startup.time), "ms");
+        }
+        break;
+    }
+
+    default:
+        DNOT_REACHED();
+        break;
     }
+
+    *text++ = '\n';
+    DASSERT(text - &m_buffer[m_bufferSize] <= maxFileLineSize);
+    m_bufferSize = text - m_buffer;
+    DASSERT(m_bufferSize <= fileBufferSize);
 }
 
 void QuickenFileLogger::setParsable(bool parsable)
@@ -212,3 +1043,1160 @@ bool QuickenFileLogger::parsable()
 {
     return !!(d_func()->m_flags & QuickenFileLoggerPrivate::Parsable);
 }
+
+const int binaryBufferSize = 2048;  // In records (256 kB).
+const int binaryBufferAlignment = 64;
+
+void QuickenBinaryLogHeader::initialize()
+{
+    memset(this, 0, sizeof(QuickenBinaryLogHeader));
+    memcpy(magic, "QUICKENB", sizeof(magic));
+    version = currentVersion;
+    endianness = Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? LittleEndian : BigEndian;
+    typeCount = QuickenMetrics::TypeCount;
+    headerSize = sizeof(QuickenBinaryLogHeader);
+    recordSize = sizeof(QuickenMetrics);
+    timeStampOffset = offsetof(QuickenMetrics, timeStamp);
+    dataOffset = offsetof(QuickenMetrics, process);
+    processId = static_cast<quint32>(QCoreApplication::applicationPid());
+    clockOrigin = QuickenMetricsUtils::timeStampOrigin();
+}
+
+bool QuickenBinaryLogHeader::isCompatible() const
+{
+    return !memcmp(magic, "QUICKENB", sizeof(magic))
+        && version == currentVersion
+        && endianness == (Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? LittleEndian : BigEndian)
+        && typeCount <= QuickenMetrics::TypeCount
+        && headerSize >= static_cast<quint16>(sizeof(QuickenBinaryLogHeader))
+        && recordSize == static_cast<quint16>(sizeof(QuickenMetrics))
+        && timeStampOffset == static_cast<quint16>(offsetof(QuickenMetrics, timeStamp))
+        && dataOffset == static_cast<quint16>(offsetof(QuickenMetrics, process));
+}
+
+QuickenBinaryLogger::QuickenBinaryLogger(const QString& fileName)
+    : d_ptr(new QuickenBinaryLoggerPrivate(fileName))
+{
+}
+
+QuickenBinaryLoggerPrivate::QuickenBinaryLoggerPrivate(const QString& fileName)
+    : m_buffer(nullptr)
+    , m_bufferCount(0)
+    , m_flushInterval(1000)
+    , m_flags(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        QuickenBinaryLogHeader header;
+        header.initialize();
+        const qint64 headerSize = sizeof(header);
+        if (m_file.write(reinterpret_cast<const char*>(&header), headerSize) == headerSize) {
+            m_buffer = static_cast<QuickenMetrics*>(
+                alignedAlloc(binaryBufferAlignment, binaryBufferSize * sizeof(QuickenMetrics)));
+            m_flushTimer.start();
+            m_flags = Open;
+        } else {
+            WARN("BinaryLogger: Can't write header to file '%s'.",
+                 fileName.toLatin1().constData());
+            m_file.close();
+        }
+    } else {
+        WARN("BinaryLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+    }
+}
+
+QuickenBinaryLogger::~QuickenBinaryLogger()
+{
+    delete d_ptr;
+}
+
+QuickenBinaryLoggerPrivate::~QuickenBinaryLoggerPrivate()
+{
+    if (m_flags & Open) {
+        flush();
+    }
+    free(m_buffer);
+}
+
+void QuickenBinaryLogger::log(const QuickenMetrics& metrics)
+{
+    d_func()->write(&metrics, 1);
+}
+
+void QuickenBinaryLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    d_func()->write(metrics, count);
+}
+
+void QuickenBinaryLoggerPrivate::write(const QuickenMetrics* metrics, int count)
+{
+    if (m_flags & Open) {
+        while (count > 0) {
+            const int size = qMin(count, binaryBufferSize - m_bufferCount);
+            memcpy(&m_buffer[m_bufferCount], metrics, size * sizeof(QuickenMetrics));
+            m_bufferCount += size;
+            metrics += size;
+            count -= size;
+            if (m_bufferCount == binaryBufferSize) {
+                flush();
+            }
+        }
+        if (m_flushInterval >= 0 && m_bufferCount > 0
+            && m_flushTimer.hasExpired(m_flushInterval)) {
+            flush();
+        }
+    }
+}
+
+void QuickenBinaryLoggerPrivate::flush()
+{
+    DASSERT(m_flags & Open);
+
+    if (m_bufferCount > 0) {
+        const qint64 size = m_bufferCount * sizeof(QuickenMetrics);
+        if (m_file.write(reinterpret_cast<const char*>(m_buffer), size) != size) {
+            WARN("BinaryLogger: Can't write to file '%s'.",
+                 m_file.errorString().toLatin1().constData());
+        }
+        m_bufferCount = 0;
+    }
+    m_flushTimer.start();
+}
+
+void QuickenBinaryLogger::flush()
+{
+    Q_D(QuickenBinaryLogger);
+
+    if (d->m_flags & QuickenBinaryLoggerPrivate::Open) {
+        d->flush();
+    }
+}
+
+void QuickenBinaryLogger::setFlushInterval(int interval)
+{
+    d_func()->m_flushInterval = qMax(-1, interval);
+}
+
+int QuickenBinaryLogger::flushInterval()
+{
+    return d_func()->m_flushInterval;
+}
+
+bool QuickenBinaryLogger::isOpen()
+{
+    return !!(d_func()->m_flags & QuickenBinaryLoggerPrivate::Open);
+}
+
+QuickenFlightRecorderLogger::QuickenFlightRecorderLogger(const QString& fileName, int capacity)
+    : d_ptr(new QuickenFlightRecorderLoggerPrivate(fileName, capacity))
+{
+}
+
+QuickenFlightRecorderLoggerPrivate::QuickenFlightRecorderLoggerPrivate(
+    const QString& fileName, int capacity)
+    : m_header(nullptr)
+    , m_records(nullptr)
+    , m_capacity(qMax(capacity, 2))
+    , m_writeIndex(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    // The whole file is allocated and mapped up front so that logging only
+    // consists of stores to the shared mapping.
+    const qint64 fileSize = sizeof(QuickenBinaryLogHeader) + m_capacity * sizeof(QuickenMetrics);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_file.resize(fileSize)) {
+        WARN("FlightRecorderLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        return;
+    }
+    uchar* map = m_file.map(0, fileSize);
+    if (!map) {
+        WARN("FlightRecorderLogger: Can't map file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+        m_file.close();
+        return;
+    }
+
+    m_header = reinterpret_cast<QuickenBinaryLogHeader*>(map);
+    m_header->initialize();
+    m_header->ringCapacity = m_capacity;
+    m_records = reinterpret_cast<QuickenMetrics*>(map + sizeof(QuickenBinaryLogHeader));
+}
+
+QuickenFlightRecorderLogger::~QuickenFlightRecorderLogger()
+{
+    delete d_ptr;
+}
+
+void QuickenFlightRecorderLogger::log(const QuickenMetrics& metrics)
+{
+    d_func()->write(&metrics, 1);
+}
+
+void QuickenFlightRecorderLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    d_func()->write(metrics, count);
+}
+
+void QuickenFlightRecorderLoggerPrivate::write(const QuickenMetrics* metrics, int count)
+{
+    if (m_header) {
+        // Store each record and then the cursor so that a crash in between
+        // leaves at most the record following the cursor torn.
+        for (int i = 0; i < count; ++i) {
+            memcpy(&m_records[m_writeIndex], &metrics[i], sizeof(QuickenMetrics));
+            if (++m_writeIndex == m_capacity) {
+                m_writeIndex = 0;
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            m_header->ringWriteCount++;
+        }
+    }
+}
+
+bool QuickenFlightRecorderLogger::isOpen()
+{
+    return !!d_func()->m_header;
+}
+
+const int traceBufferSize = 64 * 1024;
+const int maxTraceEventSize = 1024;
+
+// Trace event time stamps and durations are in microseconds.
+#define TRACE_TIME(nsecs) static_cast<unsigned long long>((nsecs) / 1000), \
+        static_cast<unsigned int>((nsecs) % 1000)
+
+// Escapes a UTF-8 string of at most size bytes, stopping at the first null
+// character, to keep valid JSON. Only quotes, backslashes and control
+// characters are escaped, a sequence cut by the size bound is dropped. The
+// output must be able to hold size * 6 + 1 characters. Returns the size of the
+// escaped string.
+static int escapeTraceString(char* output, const char* string, int size)
+{
+    int length = 0;
+    while (length < size && string[length] != '\0') {
+        length++;
+    }
+    // Looks for the lead byte of the last sequence.
+    int lead = length - 1;
+    while (lead >= 0 && lead > length - 4
+           && (static_cast<unsigned char>(string[lead]) & 0xc0) == 0x80) {
+        lead--;
+    }
+    if (lead >= 0) {
+        const unsigned char character = string[lead];
+        const int sequenceSize = character >= 0xf0 ? 4 : character >= 0xe0 ? 3
+            : character >= 0xc0 ? 2 : 1;
+        if (lead + sequenceSize > length) {
+            length = lead;
+        }
+    }
+
+    int outputSize = 0;
+    for (int i = 0; i < length; ++i) {
+        const unsigned char character = string[i];
+        if (character == '"' || character == '\\') {
+            output[outputSize++] = '\\';
+            output[outputSize++] = character;
+        } else if (character < 0x20) {
+            outputSize += sprintf(&output[outputSize], "\\u%04x", character);
+        } else {
+            output[outputSize++] = character;
+        }
+    }
+    output[outputSize] = '\0';
+    return outputSize;
+}
+
+QuickenTraceLogger::QuickenTraceLogger(const QString& fileName)
+    : d_ptr(new QuickenTraceLoggerPrivate(fileName))
+{
+}
+
+QuickenTraceLoggerPrivate::QuickenTraceLoggerPrivate(const QString& fileName)
+    : m_buffer(new char [traceBufferSize])
+    , m_bufferSize(0)
+    , m_processId(static_cast<quint32>(QCoreApplication::applicationPid()))
+    , m_inputEventCount(0)
+    , m_flags(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        m_flags = Open;
+        // The application name is bounded like generic metrics strings.
+        const QByteArray applicationName = QCoreApplication::applicationName().toUtf8();
+        char name[QuickenGenericMetrics::maxStringSize * 6 + 1];
+        escapeTraceString(name, applicationName.constData(),
+                          qMin(applicationName.size(),
+                               static_cast<int>(QuickenGenericMetrics::maxStringSize)));
+        // The JSON array format is used since viewers accept it unterminated,
+        // which happens if the process is killed.
+        append("[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,"
+               "\"args\":{\"name\":\"%s\"}}", m_processId, name);
+    } else {
+        WARN("TraceLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+    }
+}
+
+QuickenTraceLogger::~QuickenTraceLogger()
+{
+    delete d_ptr;
+}
+
+QuickenTraceLoggerPrivate::~QuickenTraceLoggerPrivate()
+{
+    if (m_flags & Open) {
+        append("\n]\n");
+        flush();
+    }
+    delete [] m_buffer;
+}
+
+void QuickenTraceLogger::log(const QuickenMetrics& metrics)
+{
+    Q_D(QuickenTraceLogger);
+
+    if (d->m_flags & QuickenTraceLoggerPrivate::Open) {
+        d->log(metrics);
+        d->flush();
+    }
+}
+
+void QuickenTraceLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+    Q_D(QuickenTraceLogger);
+
+    if (d->m_flags & QuickenTraceLoggerPrivate::Open) {
+        for (int i = 0; i < count; ++i) {
+            d->log(metrics[i]);
+        }
+        d->flush();
+    }
+}
+
+bool QuickenTraceLogger::isOpen()
+{
+    return !!(d_func()->m_flags & QuickenTraceLoggerPrivate::Open);
+}
+
+void QuickenTraceLoggerPrivate::append(const char* format, ...)
+{
+    DASSERT(m_flags & Open);
+
+    if (traceBufferSize - m_bufferSize < maxTraceEventSize) {
+        flush();
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    const int size = vsnprintf(
+        &m_buffer[m_bufferSize], traceBufferSize - m_bufferSize, format, arguments);
+    va_end(arguments);
+    DASSERT(size < maxTraceEventSize);
+    m_bufferSize = qMin(m_bufferSize + size, traceBufferSize - 1);
+}
+
+void QuickenTraceLoggerPrivate::flush()
+{
+    DASSERT(m_flags & Open);
+
+    if (m_bufferSize > 0) {
+        if (m_file.write(m_buffer, m_bufferSize) != m_bufferSize) {
+            WARN("TraceLogger: Can't write to file '%s'.",
+                 m_file.errorString().toLatin1().constData());
+        }
+        m_bufferSize = 0;
+    }
+}
+
+// Windows get two tracks, one for the scene graph passes and one for the GPU.
+static quint32 windowTrack(quint32 windowId) { return windowId * 2; }
+static quint32 gpuTrack(quint32 windowId) { return windowId * 2 + 1; }
+
+void QuickenTraceLoggerPrivate::writeTrackName(quint32 track, const char* name, quint32 windowId)
+{
+    append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+           "\"args\":{\"name\":\"%s %u\"}}", m_processId, track, name, windowId);
+    append(",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+           "\"args\":{\"sort_index\":%u}}", m_processId, track, track);
+}
+
+void QuickenTraceLoggerPrivate::writeSlice(
+    const char* name, quint32 track, quint64 start, quint64 duration)
+{
+    append(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+           "\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+           name, m_processId, track, TRACE_TIME(start), TRACE_TIME(duration));
+}
+
+void QuickenTraceLoggerPrivate::log(const QuickenMetrics& metrics)
+{
+    switch (metrics.type) {
+    case QuickenMetrics::Process:
+        append(",\n{\"name\":\"Memory\",\"ph\":\"C\",\"pid\":%u,\"ts\":%llu.%03u,"
+               "\"args\":{\"VSZ (kB)\":%u,\"RSS (kB)\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.process.vszMemory,
+               metrics.process.rssMemory);
+        append(",\n{\"name\":\"CPU usage (%%)\",\"ph\":\"C\",\"pid\":%u,\"ts\":%llu.%03u,"
+               "\"args\":{\"CPU\":%u.%02u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp),
+               metrics.process.preciseCpuUsage / 100, metrics.process.preciseCpuUsage % 100);
+        append(",\n{\"name\":\"Threads\",\"ph\":\"C\",\"pid\":%u,\"ts\":%llu.%03u,"
+               "\"args\":{\"Threads\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.process.threadCount);
+        append(",\n{\"name\":\"Dropped metrics\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"Dropped\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.process.droppedCount);
+        append(",\n{\"name\":\"Page faults\",\"ph\":\"C\",\"pid\":%u,\"ts\":%llu.%03u,"
+               "\"args\":{\"Minor\":%u,\"Major\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.process.minorFaults,
+               metrics.process.majorFaults);
+        append(",\n{\"name\":\"Context switches\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"Voluntary\":%u,\"Involuntary\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.process.voluntarySwitches,
+               metrics.process.involuntarySwitches);
+        append(",\n{\"name\":\"I/O (bytes)\",\"ph\":\"C\",\"pid\":%u,\"ts\":%llu.%03u,"
+               "\"args\":{\"Read\":%llu,\"Write\":%llu}}",
+               m_processId, TRACE_TIME(metrics.timeStamp),
+               static_cast<unsigned long long>(metrics.process.readBytes),
+               static_cast<unsigned long long>(metrics.process.writeBytes));
+        break;
+
+    case QuickenMetrics::Frame: {
+        const quint32 window = metrics.frame.window;
+        if (!m_namedWindows.contains(window)) {
+            writeTrackName(windowTrack(window), "Window", window);
+            writeTrackName(gpuTrack(window), "GPU window", window);
+            m_namedWindows.insert(window);
+        }
+        // The time stamp is taken at swap completion. Render ends when swap
+        // starts and the GPU starts executing commands when render starts.
+        // Sync is assumed to directly precede render.
+        const quint64 swapStart =
+            metrics.timeStamp - qMin(metrics.frame.swapTime, metrics.timeStamp);
+        const quint64 renderStart = swapStart - qMin(metrics.frame.renderTime, swapStart);
+        const quint64 syncStart = renderStart - qMin(metrics.frame.syncTime, renderStart);
+        writeSlice("Sync", windowTrack(window), syncStart, metrics.frame.syncTime);
+        writeSlice("Render", windowTrack(window), renderStart, metrics.frame.renderTime);
+        writeSlice("Swap", windowTrack(window), swapStart, metrics.frame.swapTime);
+        if (metrics.frame.gpuTime > 0) {
+            writeSlice("GPU", gpuTrack(window), renderStart, metrics.frame.gpuTime);
+        }
+        append(",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"number\":%u,\"delta (ms)\":%llu.%06u,"
+               "\"CPU (ms)\":%llu.%06u}}",
+               m_processId, windowTrack(window), TRACE_TIME(metrics.timeStamp),
+               metrics.frame.number,
+               static_cast<unsigned long long>(metrics.frame.deltaTime / 1000000),
+               static_cast<unsigned int>(metrics.frame.deltaTime % 1000000),
+               static_cast<unsigned long long>(metrics.frame.cpuTime / 1000000),
+               static_cast<unsigned int>(metrics.frame.cpuTime % 1000000));
+        append(",\n{\"name\":\"Window %u scene graph\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"Opaque nodes\":%u,\"Alpha nodes\":%u,"
+               "\"Unmergeable nodes\":%u,\"Draw calls\":%u}}",
+               window, m_processId, TRACE_TIME(metrics.timeStamp), metrics.frame.opaqueNodes,
+               metrics.frame.alphaNodes, metrics.frame.unmergeableNodes,
+               metrics.frame.drawCalls);
+        append(",\n{\"name\":\"Window %u buffer uploads (bytes)\",\"ph\":\"C\","
+               "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"Vertices\":%u,\"Indices\":%u}}",
+               window, m_processId, TRACE_TIME(metrics.timeStamp), metrics.frame.vertexBytes,
+               metrics.frame.indexBytes);
+        if (QuickenAllocationTracker::isAvailable()) {
+            append(",\n{\"name\":\"Window %u allocations\",\"ph\":\"C\",\"pid\":%u,"
+                   "\"ts\":%llu.%03u,\"args\":{\"Render\":%u,\"GUI\":%u}}",
+                   window, m_processId, TRACE_TIME(metrics.timeStamp),
+                   metrics.frame.renderAllocations, metrics.frame.guiAllocations);
+        }
+        break;
+    }
+
+    case QuickenMetrics::Window: {
+        const quint32 window = metrics.window.id;
+        if (!m_namedWindows.contains(window)) {
+            writeTrackName(windowTrack(window), "Window", window);
+            writeTrackName(gpuTrack(window), "GPU window", window);
+            m_namedWindows.insert(window);
+        }
+        const char* const stateString[] = { "Hidden", "Shown", "Resized" };
+        Q_STATIC_ASSERT(ARRAY_SIZE(stateString) == QuickenWindowMetrics::StateCount);
+        append(",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"width\":%u,\"height\":%u}}",
+               stateString[metrics.window.state], m_processId, windowTrack(window),
+               TRACE_TIME(metrics.timeStamp), metrics.window.width, metrics.window.height);
+        break;
+    }
+
+    case QuickenMetrics::Generic: {
+        char string[QuickenGenericMetrics::maxStringSize * 6 + 1];
+        escapeTraceString(string, metrics.generic.string,
+                          qMin(metrics.generic.stringSize,
+                               static_cast<quint32>(QuickenGenericMetrics::maxStringSize)));
+        append(",\n{\"name\":\"%s\",\"cat\":\"generic\",\"ph\":\"i\",\"s\":\"p\","
+               "\"pid\":%u,\"tid\":0,\"ts\":%llu.%03u,\"args\":{\"id\":%u}}",
+               string, m_processId, TRACE_TIME(metrics.timeStamp), metrics.generic.id);
+        break;
+    }
+
+    case QuickenMetrics::Thread: {
+        // Thread names are set by applications, quotes and backslashes are
+        // replaced so that they don't need escaping.
+        char name[QuickenThreadMetrics::maxNameSize];
+        const int nameSize = static_cast<int>(
+            strnlen(metrics.thread.name, QuickenThreadMetrics::maxNameSize - 1));
+        for (int i = 0; i < nameSize; ++i) {
+            const unsigned char character = metrics.thread.name[i];
+            name[i] = (character == '"' || character == '\\' || character < 0x20
+                       || character >= 0x80) ? '_' : character;
+        }
+        name[nameSize] = '\0';
+        append(",\n{\"name\":\"Thread %u CPU usage (%%)\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"%s\":%u}}",
+               metrics.thread.id, m_processId, TRACE_TIME(metrics.timeStamp), name,
+               metrics.thread.cpuUsage);
+        break;
+    }
+
+    case QuickenMetrics::Memory:
+        append(",\n{\"name\":\"Memory breakdown (kB)\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"PSS\":%u,\"Private clean\":%u,"
+               "\"Private dirty\":%u,\"Shared\":%u,\"Anonymous\":%u,\"Swap\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.memory.pssMemory,
+               metrics.memory.privateCleanMemory, metrics.memory.privateDirtyMemory,
+               metrics.memory.sharedMemory, metrics.memory.anonymousMemory,
+               metrics.memory.swapMemory);
+        break;
+
+    case QuickenMetrics::Texture:
+        append(",\n{\"name\":\"Window %u texture uploads (bytes)\",\"ph\":\"C\","
+               "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"All\":%u,\"Atlases\":%u}}",
+               metrics.texture.window, m_processId, TRACE_TIME(metrics.timeStamp),
+               metrics.texture.uploadedBytes, metrics.texture.atlasUploadedBytes);
+        append(",\n{\"name\":\"Window %u textures\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"All\":%u,\"Atlases\":%u}}",
+               metrics.texture.window, m_processId, TRACE_TIME(metrics.timeStamp),
+               metrics.texture.textureCount, metrics.texture.atlasCount);
+        append(",\n{\"name\":\"Window %u texture memory (kB)\",\"ph\":\"C\","
+               "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"All\":%u,\"Atlases\":%u}}",
+               metrics.texture.window, m_processId, TRACE_TIME(metrics.timeStamp),
+               metrics.texture.textureMemory, metrics.texture.atlasMemory);
+        break;
+
+    case QuickenMetrics::JavaScript:
+        append(",\n{\"name\":\"JavaScript heap (kB)\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"Used\":%u,\"Large items\":%u,"
+               "\"Allocated\":%u}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.javaScript.usedMemory,
+               metrics.javaScript.largeItemMemory, metrics.javaScript.allocatedMemory);
+        if (metrics.javaScript.collections > 0) {
+            append(",\n{\"name\":\"Garbage collection\",\"ph\":\"i\",\"s\":\"p\","
+                   "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"window\":%u,\"frame\":%u,"
+                   "\"reclaimed (kB)\":%u,\"time bound (us)\":%llu.%03u}}",
+                   m_processId, TRACE_TIME(metrics.timeStamp), metrics.javaScript.window,
+                   metrics.javaScript.frame, metrics.javaScript.reclaimedMemory,
+                   TRACE_TIME(metrics.javaScript.collectionTimeBound));
+        }
+        break;
+
+    case QuickenMetrics::Binding: {
+        // Locations are file paths, quotes and backslashes are replaced so
+        // that they don't need escaping.
+        char location[QuickenBindingMetrics::maxLocationSize];
+        const int locationSize = static_cast<int>(
+            strnlen(metrics.binding.location, QuickenBindingMetrics::maxLocationSize - 1));
+        for (int i = 0; i < locationSize; ++i) {
+            const unsigned char character = metrics.binding.location[i];
+            location[i] = (character == '"' || character == '\\' || character < 0x20
+                           || character >= 0x80) ? '_' : character;
+        }
+        location[locationSize] = '\0';
+        append(",\n{\"name\":\"Binding hotspot\",\"cat\":\"binding\",\"ph\":\"i\","
+               "\"s\":\"p\",\"pid\":%u,\"tid\":0,\"ts\":%llu.%03u,\"args\":{"
+               "\"rank\":%u,\"location\":\"%s\",\"evaluations\":%u,\"time (ns)\":%llu,"
+               "\"max frame evaluations\":%u,\"max frame time (ns)\":%llu,"
+               "\"total evaluations\":%u,\"total time (ns)\":%llu}}",
+               m_processId, TRACE_TIME(metrics.timeStamp), metrics.binding.rank, location,
+               metrics.binding.evaluationCount,
+               static_cast<unsigned long long>(metrics.binding.time),
+               metrics.binding.maxFrameEvaluationCount,
+               static_cast<unsigned long long>(metrics.binding.maxFrameTime),
+               metrics.binding.totalEvaluationCount,
+               static_cast<unsigned long long>(metrics.binding.totalTime));
+        break;
+    }
+
+    case QuickenMetrics::Animation:
+        append(",\n{\"name\":\"Window %u animations\",\"ph\":\"C\",\"pid\":%u,"
+               "\"ts\":%llu.%03u,\"args\":{\"Running\":%u,\"Ticks\":%u}}",
+               metrics.animation.window, m_processId, TRACE_TIME(metrics.timeStamp),
+               metrics.animation.runningAnimationCount, metrics.animation.tickCount);
+        append(",\n{\"name\":\"Window %u animation timing (us)\",\"ph\":\"C\","
+               "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"Advance\":%llu,\"Drift\":%lld}}",
+               metrics.animation.window, m_processId, TRACE_TIME(metrics.timeStamp),
+               static_cast<unsigned long long>(metrics.animation.advanceTime / 1000),
+               static_cast<long long>(metrics.animation.drift / 1000));
+        break;
+
+    case QuickenMetrics::Input: {
+        // Latencies of successive events overlap, they're written as async
+        // slices from the creation of the event to the frame swap.
+        const char* const typeString[] = { "Touch", "Mouse", "Key" };
+        Q_STATIC_ASSERT(ARRAY_SIZE(typeString) == QuickenInputMetrics::TypeCount);
+        const char* const actionString[] = { "press", "move", "release" };
+        Q_STATIC_ASSERT(ARRAY_SIZE(actionString) == QuickenInputMetrics::ActionCount);
+        const quint64 start = metrics.timeStamp - qMin(metrics.timeStamp, metrics.input.latency);
+        const quint32 id = ++m_inputEventCount;
+        append(",\n{\"name\":\"%s %s\",\"cat\":\"input\",\"ph\":\"b\",\"id\":%u,"
+               "\"pid\":%u,\"ts\":%llu.%03u,\"args\":{\"window\":%u,\"frame\":%u,"
+               "\"queueing delay (us)\":%llu}}",
+               typeString[metrics.input.type], actionString[metrics.input.action], id,
+               m_processId, TRACE_TIME(start), metrics.input.window, metrics.input.frame,
+               static_cast<unsigned long long>(metrics.input.queueingDelay / 1000));
+        append(",\n{\"name\":\"%s %s\",\"cat\":\"input\",\"ph\":\"e\",\"id\":%u,"
+               "\"pid\":%u,\"ts\":%llu.%03u}",
+               typeString[metrics.input.type], actionString[metrics.input.action], id,
+               m_processId, TRACE_TIME(metrics.timeStamp));
+        break;
+    }
+
+    case QuickenMetrics::Startup: {
+        // Quotes and backslashes are replaced so that names don't need
+        // escaping.
+        char name[QuickenStartupMetrics::maxNameSize];
+        const int nameSize = static_cast<int>(
+            strnlen(metrics.startup.name, QuickenStartupMetrics::maxNameSize - 1));
+        for (int i = 0; i < nameSize; ++i) {
+            const unsigned char character = metrics.startup.name[i];
+            name[i] = (character == '"' || character == '\\' || character < 0x20
+                       || character >= 0x80) ? '_' : character;
+        }
+        name[nameSize] = '\0';
+        append(",\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"i\",\"s\":\"p\","
+               "\"pid\":%u,\"tid\":0,\"ts\":%llu.%03u,\"args\":{\"milestone\":%u,"
+               "\"time since process start (us)\":%llu}}",
+               name, m_processId, TRACE_TIME(metrics.timeStamp), metrics.startup.milestone,
+               static_cast<unsigned long long>(metrics.startup.time / 1000));
+        break;
+    }
+
+    default:
+        DNOT_REACHED();
+        break;
+    }
+}
+
+const int compactColumnReserve = 4 * compactBlockSize;
+
+QuickenCompactLogger::QuickenCompactLogger(const QString& fileName)
+    : d_ptr(new QuickenCompactLoggerPrivate(fileName))
+{
+}
+
+QuickenCompactLoggerPrivate::QuickenCompactLoggerPrivate(const QString& fileName)
+    : m_lastBlock(nullptr)
+    , m_releaseTimeStamp(0)
+    , m_flags(0)
+{
+    if (QDir::isRelativePath(fileName)) {
+        m_file.setFileName(QString(QDir::currentPath() + QDir::separator() + fileName));
+    } else {
+        m_file.setFileName(fileName);
+    }
+
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        QuickenCompactLogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "QUICKENC", sizeof(header.magic));
+        header.version = compactLogVersion;
+        header.endianness = Q_BYTE_ORDER == Q_LITTLE_ENDIAN ?
+            QuickenBinaryLogHeader::LittleEndian : QuickenBinaryLogHeader::BigEndian;
+        header.processId = static_cast<quint32>(QCoreApplication::applicationPid());
+        header.clockOrigin = QuickenMetricsUtils::timeStampOrigin();
+        const qint64 headerSize = sizeof(header);
+        if (m_file.write(reinterpret_cast<const char*>(&header), headerSize) == headerSize) {
+            m_flags = Open;
+        } else {
+            WARN("CompactLogger: Can't write header to file '%s'.",
+                 fileName.toLatin1().constData());
+            m_file.close();
+        }
+    } else {
+        WARN("CompactLogger: Can't open file %s '%s'.", fileName.toLatin1().constData(),
+             m_file.errorString().toLatin1().constData());
+    }
+}
+
+QuickenCompactLogger::~QuickenCompactLogger()
+{
+    delete d_ptr;
+}
+
+QuickenCompactLoggerPrivate::~QuickenCompactLoggerPrivate()
+{
+    if (m_flags & Open) {
+        flush();
+    }
+    qDeleteAll(m_blocks);
+}
+
+void QuickenCompactLogger::log(const QuickenMetrics& metrics)
+{
+    d_func()->write(metrics);
+}
+
+void QuickenCompactLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+    Q_D(QuickenCompactLogger);
+
+    for (int i = 0; i < count; ++i) {
+        d->write(metrics[i]);
+    }
+}
+
+bool QuickenCompactLogger::isOpen()
+{
+    return !!(d_func()->m_flags & QuickenCompactLoggerPrivate::Open);
+}
+
+void QuickenCompactLogger::flush()
+{
+    Q_D(QuickenCompactLogger);
+
+    if (d->m_flags & QuickenCompactLoggerPrivate::Open) {
+        d->flush();
+    }
+}
+
+QuickenCompactLoggerPrivate::Block* QuickenCompactLoggerPrivate::block(
+    QuickenMetrics::Type type, quint32 window)
+{
+    // Frames of the same window usually come in a row.
+    if (m_lastBlock && m_lastBlock->type == type && m_lastBlock->window == window) {
+        return m_lastBlock;
+    }
+
+    const quint64 key = (static_cast<quint64>(type) << 32) | window;
+    Block*& block = m_blocks[key];
+    if (block) {
+        m_lastBlock = block;
+        return block;
+    }
+
+    block = new Block;
+    for (int i = 0; i < compactFieldCount(type); ++i) {
+        block->columns[i].reserve(compactColumnReserve);
+    }
+    if (type == QuickenMetrics::Generic) {
+        block->strings.reserve(compactColumnReserve);
+    }
+    block->window = window;
+    block->count = 0;
+    block->type = type;
+    m_lastBlock = block;
+    return block;
+}
+
+// Writes the pending records of the blocks that didn't get new ones for a block
+// duration and frees the blocks idle for a block duration once written, so
+// that the blocks of the threads and windows gone don't pile up. Time stamps
+// of different types can come slightly out of order, hence the signed deltas.
+void QuickenCompactLoggerPrivate::releaseIdleBlocks(quint64 timeStamp)
+{
+    const qint64 duration = static_cast<qint64>(compactBlockDuration);
+    QHash<quint64, Block*>::iterator it = m_blocks.begin();
+    while (it != m_blocks.end()) {
+        Block* block = it.value();
+        if (block->count > 0
+            && static_cast<qint64>(timeStamp - block->firstTimeStamp) >= duration) {
+            writeBlock(block);
+        }
+        if (block->count == 0
+            && static_cast<qint64>(timeStamp - block->lastTimeStamp) >= duration) {
+            if (block == m_lastBlock) {
+                m_lastBlock = nullptr;
+            }
+            delete block;
+            it = m_blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QuickenCompactLoggerPrivate::write(const QuickenMetrics& metrics)
+{
+    if (!(m_flags & Open)) {
+        return;
+    }
+    DASSERT(metrics.type < QuickenMetrics::TypeCount);
+
+    if (static_cast<qint64>(metrics.timeStamp - m_releaseTimeStamp)
+        >= static_cast<qint64>(compactBlockDuration)) {
+        releaseIdleBlocks(metrics.timeStamp);
+        m_releaseTimeStamp = metrics.timeStamp;
+    }
+
+    // Frames are grouped by window and thread metrics by thread.
+    const quint32 window = metrics.type == QuickenMetrics::Frame ? metrics.frame.window
+        : metrics.type == QuickenMetrics::Thread ? metrics.thread.id : 0;
+    Block* block = this->block(metrics.type, window);
+    if (block->count > 0 && metrics.timeStamp - block->firstTimeStamp >= compactBlockDuration) {
+        writeBlock(block);
+    }
+
+    // The first record of a block is stored as deltas against 0, which makes
+    // each block a key frame.
+    if (block->count == 0) {
+        memset(block->previous, 0, sizeof(block->previous));
+        block->firstTimeStamp = metrics.timeStamp;
+    }
+
+    quint64 fields[maxCompactFieldCount];
+    compactFields(metrics, fields);
+    const int fieldCount = compactFieldCount(metrics.type);
+    for (int i = 0; i < fieldCount; ++i) {
+        appendVarint(&block->columns[i], zigzagEncode(fields[i] - block->previous[i]));
+        block->previous[i] = fields[i];
+    }
+    if (metrics.type == QuickenMetrics::Generic) {
+        block->strings.append(metrics.generic.string, metrics.generic.stringSize);
+    }
+
+    block->lastTimeStamp = metrics.timeStamp;
+    if (++block->count == compactBlockSize) {
+        writeBlock(block);
+    }
+}
+
+void QuickenCompactLoggerPrivate::writeBlock(Block* block)
+{
+    DASSERT(m_flags & Open);
+    DASSERT(block->count > 0);
+
+    // Each column is prefixed by its size so that readers can skip unknown
+    // columns. The sizes are reset without releasing the reserved capacity.
+    const int fieldCount = compactFieldCount(block->type);
+    m_payload.resize(0);
+    for (int i = 0; i < fieldCount; ++i) {
+        appendVarint(&m_payload, block->columns[i].size());
+        m_payload.append(block->columns[i]);
+        block->columns[i].resize(0);
+    }
+    if (block->type == QuickenMetrics::Generic) {
+        appendVarint(&m_payload, block->strings.size());
+        m_payload.append(block->strings);
+        block->strings.resize(0);
+    }
+    const QByteArray payload = qCompress(m_payload);
+
+    QuickenCompactBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = QuickenCompactBlockHeader::magicNumber;
+    header.type = block->type;
+    header.fieldCount = fieldCount;
+    header.window = block->window;
+    header.recordCount = block->count;
+    header.firstTimeStamp = block->firstTimeStamp;
+    header.lastTimeStamp = block->lastTimeStamp;
+    header.payloadSize = payload.size();
+    block->count = 0;
+
+    const qint64 headerSize = sizeof(header);
+    if (m_file.write(reinterpret_cast<const char*>(&header), headerSize) != headerSize
+        || m_file.write(payload) != payload.size()) {
+        WARN("CompactLogger: Can't write to file '%s'.",
+             m_file.errorString().toLatin1().constData());
+    }
+}
+
+void QuickenCompactLoggerPrivate::flush()
+{
+    DASSERT(m_flags & Open);
+
+    for (QHash<quint64, Block*>::const_iterator it = m_blocks.constBegin();
+         it != m_blocks.constEnd(); ++it) {
+        if (it.value()->count > 0) {
+            writeBlock(it.value());
+        }
+    }
+}
+
+const qint64 socketRetryInterval = 1000;  // In milliseconds.
+
+QuickenSocketLogger::QuickenSocketLogger(const QString& socketPath, int capacity)
+    : d_ptr(new QuickenSocketLoggerPrivate(socketPath, capacity))
+{
+}
+
+QuickenSocketLoggerPrivate::QuickenSocketLoggerPrivate(const QString& socketPath, int capacity)
+    : m_socketPath(QFile::encodeName(socketPath))
+    , m_buffer(nullptr)
+    , m_capacity(qMax(capacity, 1))
+    , m_bufferCount(0)
+    , m_sendOffset(0)
+    , m_socket(-1)
+    , m_droppedCount(0)
+    , m_flags(0)
+{
+    if (m_socketPath.isEmpty()
+        || m_socketPath.size() >= static_cast<int>(sizeof(sockaddr_un::sun_path))) {
+        WARN("SocketLogger: Invalid socket path '%s'.", socketPath.toLatin1().constData());
+        return;
+    }
+
+    m_buffer = static_cast<QuickenMetrics*>(
+        alignedAlloc(binaryBufferAlignment, m_capacity * sizeof(QuickenMetrics)));
+    m_flags.store(Open);
+    connect();
+}
+
+QuickenSocketLogger::~QuickenSocketLogger()
+{
+    delete d_ptr;
+}
+
+QuickenSocketLoggerPrivate::~QuickenSocketLoggerPrivate()
+{
+    // Pending records are sent if the collector can take them right away.
+    if (m_flags.load() & Connected) {
+        send();
+        if (m_flags.load() & Connected) {
+            close(m_socket);
+        }
+    }
+    free(m_buffer);
+}
+
+void QuickenSocketLogger::log(const QuickenMetrics& metrics)
+{
+    d_func()->write(&metrics, 1);
+}
+
+void QuickenSocketLogger::logBatch(const QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    d_func()->write(metrics, count);
+}
+
+bool QuickenSocketLogger::isOpen()
+{
+    return !!(d_func()->m_flags.load() & QuickenSocketLoggerPrivate::Open);
+}
+
+bool QuickenSocketLogger::isConnected()
+{
+    return !!(d_func()->m_flags.load() & QuickenSocketLoggerPrivate::Connected);
+}
+
+quint32 QuickenSocketLogger::droppedCount()
+{
+    return d_func()->m_droppedCount.loadAcquire();
+}
+
+void QuickenSocketLoggerPrivate::write(const QuickenMetrics* metrics, int count)
+{
+    if (!(m_flags.load() & Open)) {
+        return;
+    }
+
+    if (!(m_flags.load() & Connected) && m_connectTimer.hasExpired(socketRetryInterval)) {
+        connect();
+    }
+
+    // Discard the records already sent before buffering the new ones.
+    const int sentCount = static_cast<int>(m_sendOffset / sizeof(QuickenMetrics));
+    if (sentCount > 0) {
+        memmove(m_buffer, &m_buffer[sentCount],
+                (m_bufferCount - sentCount) * sizeof(QuickenMetrics));
+        m_bufferCount -= sentCount;
+        m_sendOffset -= sentCount * sizeof(QuickenMetrics);
+    }
+    const int size = qMin(count, m_capacity - m_bufferCount);
+    memcpy(&m_buffer[m_bufferCount], metrics, size * sizeof(QuickenMetrics));
+    m_bufferCount += size;
+    if (size < count) {
+        m_droppedCount.fetchAndAddRelease(count - size);
+    }
+
+    if (m_flags.load() & Connected) {
+        send();
+    }
+}
+
+void QuickenSocketLoggerPrivate::connect()
+{
+    DASSERT(!(m_flags.load() & Connected));
+
+    m_connectTimer.start();
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return;
+    }
+
+    // A collector not listening yet is expected, failures are silent.
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, m_socketPath.constData(), m_socketPath.size());
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1) {
+        close(fd);
+        return;
+    }
+
+    // The send buffer of a new connection can always take the header.
+    QuickenBinaryLogHeader header;
+    header.initialize();
+    if (::send(fd, &header, sizeof(header), MSG_NOSIGNAL) != sizeof(header)) {
+        close(fd);
+        return;
+    }
+
+    m_socket = fd;
+    m_flags.fetchAndOrRelaxed(Connected);
+}
+
+void QuickenSocketLoggerPrivate::disconnect()
+{
+    DASSERT(m_flags.load() & Connected);
+
+    close(m_socket);
+    m_socket = -1;
+    m_flags.fetchAndAndRelaxed(~Connected);
+    m_connectTimer.start();
+
+    // The next connection starts with a new header, a partially sent record
+    // is dropped.
+    const qint64 recordSize = sizeof(QuickenMetrics);
+    if (m_sendOffset % recordSize) {
+        m_sendOffset += recordSize - m_sendOffset % recordSize;
+        m_droppedCount.fetchAndAddRelease(1);
+    }
+}
+
+void QuickenSocketLoggerPrivate::send()
+{
+    DASSERT(m_flags.load() & Connected);
+
+    const char* data = reinterpret_cast<const char*>(m_buffer);
+    const qint64 size = m_bufferCount * sizeof(QuickenMetrics);
+    while (m_sendOffset < size) {
+        const ssize_t sentSize = ::send(
+            m_socket, data + m_sendOffset, size - m_sendOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sentSize > 0) {
+            m_sendOffset += sentSize;
+        } else if (sentSize == -1 && errno == EINTR) {
+            continue;
+        } else if (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            disconnect();
+            break;
+        }
+    }
+    if (m_sendOffset == size) {
+        m_bufferCount = 0;
+        m_sendOffset = 0;
+    }
+}
+
+void QuickenFileLogger::setFlushSize(int size)
+{
+    d_func()->m_flushSize = qBound(0, size, fileBufferSize - maxFileLineSize);
+}
+
+int QuickenFileLogger::flushSize()
+{
+    return d_func()->m_flushSize;
+}
+
+void QuickenFileLogger::setFlushInterval(int interval)
+{
+    d_func()->m_flushInterval = qMax(-1, interval);
+}
+
+int QuickenFileLogger::flushInterval()
+{
+    return d_func()->m_flushInterval;
+}
+
+void QuickenFileLogger::setFlushOnWindowHide(bool flush)
+{
+    Q_D(QuickenFileLogger);
+
+    if (flush) {
+        d->m_flags |= QuickenFileLoggerPrivate::FlushOnWindowHide;
+    } else {
+        d->m_flags &= ~QuickenFileLoggerPrivate::FlushOnWindowHide;
+    }
+}
+
+bool QuickenFileLogger::flushOnWindowHide()
+{
+    return !!(d_func()->m_flags & QuickenFileLoggerPrivate::FlushOnWindowHide);
+}
+
+void QuickenFileLogger::setRotationSize(qint64 size)
+{
+    d_func()->m_rotationSize = qMax(Q_INT64_C(0), size);
+}
+
+qint64 QuickenFileLogger::rotationSize()
+{
+    return d_func()->m_rotationSize;
+}
+
+void QuickenFileLogger::setRotationAge(int age)
+{
+    d_func()->m_rotationAge = qMax(0, age);
+}
+
+int QuickenFileLogger::rotationAge()
+{
+    return d_func()->m_rotationAge;
+}
+
+void QuickenFileLogger::setMaxSegmentCount(int count)
+{
+    d_func()->m_maxSegmentCount = qMax(0, count);
+}
+
+int QuickenFileLogger::maxSegmentCount()
+{
+    return d_func()->m_maxSegmentCount;
+}
+
+void QuickenFileLogger::setSegmentCompression(bool compression)
+{
+    d_func()->m_segmentCompression = compression;
+}
+
+bool QuickenFileLogger::segmentCompression()
+{
+    return d_func()->m_segmentCompression;
+}
@@ -12,6 +12,11 @@
 #include <Quicken/quickenglobal.h>
 
 class QuickenFileLoggerPrivate;
+class QuickenBinaryLoggerPrivate;
+class QuickenFlightRecorderLoggerPrivate;
+class QuickenTraceLoggerPrivate;
+class QuickenCompactLoggerPrivate;
+class QuickenSocketLoggerPrivate;
 struct QuickenMetrics;
 
 // Log metrics to a specific device.
@@ -23,11 +28,17 @@ public:
     // Log metrics.
     virtual void log(const QuickenMetrics& metrics) = 0;
 
+    // Log a contiguous array of count metrics. The default implementation calls
+    // log() for each metrics, loggers can override it to amortize the cost of
+    // writing to the device.
+    virtual void logBatch(const QuickenMetrics* metrics, int count);
+
     // Get whether the target device has been opened successfully or not.
     virtual bool isOpen() = 0;
 };
 
-// Log metrics to a file.
+// Log metrics to a file. Lines are formatted into a buffer written to the file
+// depending on the flush settings, by default at each log call.
 class QUICKEN_EXPORT QuickenFileLogger : public QuickenLogger
 {
 public:
@@ -36,14 +47,250 @@ public:
     ~QuickenFileLogger();
 
     void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
     bool isOpen() Q_DECL_OVERRIDE;
 
     void setParsable(bool parsable);
     bool parsable();
 
+    // Set the number of buffered bytes above which the buffer is written to the
+    // file at the end of a log call. Default is 0, bounded to 65024.
+    void setFlushSize(int size);
+    int flushSize();
+
+    // Set the time in milliseconds after which the buffer is written to the
+    // file at the end of a log call, whatever its size. -1, the default,
+    // disables it.
+    void setFlushInterval(int interval);
+    int flushInterval();
+
+    // Write the buffer to the file when a window gets hidden. Default is true.
+    void setFlushOnWindowHide(bool flush);
+    bool flushOnWindowHide();
+
+    // Set the size in bytes above which the log file is rotated. The file is
+    // closed, renamed with an increasing index suffix (for instance
+    // "metrics.log.3") and a new segment is started under the original name.
+    // Each segment starts with a comment line (prefixed by '#') giving the
+    // process id and the clock origin of the time stamps (see
+    // QuickenBinaryLogHeader::clockOrigin) so that it can be parsed on its
+    // own. 0, the default, disables it. Rotation is only supported by loggers
+    // created with a file name.
+    void setRotationSize(qint64 size);
+    qint64 rotationSize();
+
+    // Set the time in milliseconds after which the log file is rotated. 0, the
+    // default, disables it.
+    void setRotationAge(int age);
+    int rotationAge();
+
+    // Set the maximum number of closed segments kept on disk, the oldest ones
+    // being removed. 0, the default, keeps all of them.
+    void setMaxSegmentCount(int count);
+    int maxSegmentCount();
+
+    // Compress closed segments to gzip files (for instance "metrics.log.3.gz").
+    // Compression and removal of old segments are done on a helper thread.
+    // Default is false.
+    void setSegmentCompression(bool compression);
+    bool segmentCompression();
+
+    // Write the buffer to the file.
+    void flush();
+
 private:
     QuickenFileLoggerPrivate* const d_ptr;
     Q_DECLARE_PRIVATE(QuickenFileLogger)
 };
 
+// Header written at the beginning of the files created by QuickenBinaryLogger
+// and QuickenFlightRecorderLogger, followed by an array of raw QuickenMetrics
+// records. The layout fields allow readers to reject files written with an
+// incompatible struct layout.
+struct QUICKEN_EXPORT QuickenBinaryLogHeader
+{
+    enum Endianness { LittleEndian = 0, BigEndian = 1 };
+
+    static const quint16 currentVersion = 1;
+
+    // Magic bytes identifying the file format ("QUICKENB").
+    char magic[8];
+
+    // Version of the file format.
+    quint16 version;
+
+    // Byte order of the records (see Endianness).
+    quint8 endianness;
+
+    // Number of metrics types (QuickenMetrics::TypeCount).
+    quint8 typeCount;
+
+    // Size of that header in bytes, records start right after.
+    quint16 headerSize;
+
+    // Size of a record in bytes (sizeof(QuickenMetrics)).
+    quint16 recordSize;
+
+    // Offset in bytes of the time stamp in a record.
+    quint16 timeStampOffset;
+
+    // Offset in bytes of the metrics type specific data in a record.
+    quint16 dataOffset;
+
+    // Id of the process that wrote the file.
+    quint32 processId;
+
+    // Wall-clock time in nanoseconds since the Unix epoch corresponding to a
+    // record time stamp of 0.
+    quint64 clockOrigin;
+
+    // Number of records of the ring for flight recorder files, 0 otherwise.
+    quint64 ringCapacity;
+
+    // Number of records written to the ring since its creation for flight
+    // recorder files, the next record is written at index ringWriteCount %
+    // ringCapacity. Updated after each record is fully written.
+    quint64 ringWriteCount;
+
+    // The whole struct must take 64 bytes so that records stay aligned.
+    quint8 __reserved[/*48 bytes taken,*/ 16 /*bytes free*/];
+
+    // Fills the header with the layout of the running library.
+    void initialize();
+
+    // Checks whether the header describes a file readable by the running
+    // library.
+    bool isCompatible() const;
+};
+Q_STATIC_ASSERT(sizeof(QuickenBinaryLogHeader) == 64);
+
+// Log raw metrics records to a file. Records are written verbatim after a
+// QuickenBinaryLogHeader, using large buffered writes. Such files can be read
+// back with QuickenBinaryLogReader.
+class QUICKEN_EXPORT QuickenBinaryLogger : public QuickenLogger
+{
+public:
+    QuickenBinaryLogger(const QString& filename);
+    ~QuickenBinaryLogger();
+
+    void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
+    bool isOpen() Q_DECL_OVERRIDE;
+
+    // Set the time in milliseconds after which the buffered records are
+    // written to the file at the end of a log call, whatever their count, so
+    // that a crash loses at most that much of the most recent records. -1
+    // disables it. Default is 1000.
+    void setFlushInterval(int interval);
+    int flushInterval();
+
+    // Write the buffered records to the file. Records are automatically
+    // written when the buffer is full, when the flush interval expired and at
+    // destruction.
+    void flush();
+
+private:
+    QuickenBinaryLoggerPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenBinaryLogger)
+};
+
+// Log the most recent metrics to a fixed-size memory-mapped ring file. The
+// ring is stored in the page cache so that the file still contains the last
+// metrics logged after a crash, a freeze or a SIGKILL of the process. Logging
+// a record doesn't involve any system call. The capacity is given in records
+// rather than in time so that the file has a fixed size and logging never
+// has to look back at older records. The time window kept depends on the rate
+// of metrics, for instance 60 seconds of frames of a single 60 Hz window plus
+// the process metrics need 3660 records. Such files can be read back with
+// QuickenBinaryLogReader.
+class QUICKEN_EXPORT QuickenFlightRecorderLogger : public QuickenLogger
+{
+public:
+    QuickenFlightRecorderLogger(const QString& filename, int capacity);
+    ~QuickenFlightRecorderLogger();
+
+    void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
+    bool isOpen() Q_DECL_OVERRIDE;
+
+private:
+    QuickenFlightRecorderLoggerPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenFlightRecorderLogger)
+};
+
+// Log metrics to a file in the Chrome Trace Event JSON format, which can be
+// opened by timeline viewers like chrome://tracing or Perfetto. The sync,
+// render, swap and GPU intervals of each frame are written as slices on
+// per-window tracks, process metrics as counter tracks and generic metrics as
+// instant events. Events are streamed to the file through a fixed-size buffer.
+class QUICKEN_EXPORT QuickenTraceLogger : public QuickenLogger
+{
+public:
+    QuickenTraceLogger(const QString& filename);
+    ~QuickenTraceLogger();
+
+    void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
+    bool isOpen() Q_DECL_OVERRIDE;
+
+private:
+    QuickenTraceLoggerPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenTraceLogger)
+};
+
+// Log metrics to a file in a compact columnar format suited to long captures.
+// Records are grouped in blocks per metrics type (and per window for frame
+// metrics), each field being stored in its own column as compressed varint
+// deltas. A block is written once it holds 4096 records or spans more than 60
+// seconds, so that a day of frame metrics of a 60 Hz window takes a few
+// megabytes. Blocks are independent from each other and can be randomly
+// accessed with QuickenCompactLogReader.
+class QUICKEN_EXPORT QuickenCompactLogger : public QuickenLogger
+{
+public:
+    QuickenCompactLogger(const QString& filename);
+    ~QuickenCompactLogger();
+
+    void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
+    bool isOpen() Q_DECL_OVERRIDE;
+
+    // Write the pending blocks to the file. Blocks are automatically written
+    // when full and at destruction.
+    void flush();
+
+private:
+    QuickenCompactLoggerPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenCompactLogger)
+};
+
+// Stream raw metrics records to a Unix domain socket, typically listened to by
+// the quicken-collector tool. Each connection starts with a
+// QuickenBinaryLogHeader followed by the records. The socket is non-blocking
+// so that a slow or absent collector never blocks the logging thread, records
+// are buffered up to the given capacity (in records) and the new ones are
+// dropped beyond. Connection is attempted at construction and retried at most
+// once per second while logging.
+class QUICKEN_EXPORT QuickenSocketLogger : public QuickenLogger
+{
+public:
+    QuickenSocketLogger(const QString& socketPath, int capacity = 4096);
+    ~QuickenSocketLogger();
+
+    void log(const QuickenMetrics& metrics) Q_DECL_OVERRIDE;
+    void logBatch(const QuickenMetrics* metrics, int count) Q_DECL_OVERRIDE;
+    bool isOpen() Q_DECL_OVERRIDE;
+
+    // Get whether the logger is currently connected to a collector.
+    bool isConnected();
+
+    // Get the number of records dropped because the buffer was full. Can be
+    // called from any thread.
+    quint32 droppedCount();
+
+private:
+    QuickenSocketLoggerPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE(QuickenSocketLogger)
+};
+
 #endif  // LOGGER_H
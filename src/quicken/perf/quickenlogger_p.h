@@ -9,29 +9,201 @@
 
 #include <Quicken/quickenlogger.h>
 
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
-#include <QtCore/QTextStream>
+#include <QtCore/QHash>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
 
 #include <Quicken/quickenmetrics.h>
 #include <Quicken/private/quickenglobal_p.h>
+#include <Quicken/private/quickencompactlog_p.h>
 
 class QUICKEN_PRIVATE_EXPORT QuickenFileLoggerPrivate
 {
 public:
     enum {
-        Open     = (1 << 0),
-        Colored  = (1 << 1),
-        Parsable = (1 << 2)
+        Open              = (1 << 0),
+        Colored           = (1 << 1),
+        Parsable          = (1 << 2),
+        FlushOnWindowHide = (1 << 3),
+        FlushRequested    = (1 << 4)
     };
 
     QuickenFileLoggerPrivate(const QString& fileName, bool parsable);
     QuickenFileLoggerPrivate(FILE* fileHandle, bool parsable);
+    ~QuickenFileLoggerPrivate();
 
     void log(const QuickenMetrics& metrics);
+    void flush();
+    void flushIfNeeded();
+    bool rotationEnabled();
+    bool rotationNeeded();
+    void rotate();
+    void writeSegmentHeader();
 
     QFile m_file;
-    QTextStream m_textStream;
+    QElapsedTimer m_flushTimer;
+    QElapsedTimer m_segmentTimer;
+    QThreadPool m_segmentPool;
+    char* m_buffer;
+    int m_bufferSize;
+    int m_flushSize;
+    int m_flushInterval;
+    qint64 m_segmentSize;
+    qint64 m_rotationSize;
+    int m_rotationAge;
+    int m_maxSegmentCount;
+    qint64 m_segmentIndex;  // -1 until closed segments are looked up.
+    bool m_segmentCompression;
     quint8 m_flags;
 };
 
+// Compresses and prunes the closed segments of a QuickenFileLogger, run on the
+// logger's segment thread pool.
+class QUICKEN_PRIVATE_EXPORT FileLoggerSegmentJob : public QRunnable
+{
+public:
+    FileLoggerSegmentJob(const QString& fileName, const QString& segmentName,
+                         int maxSegmentCount, bool compression)
+        : m_fileName(fileName)
+        , m_segmentName(segmentName)
+        , m_maxSegmentCount(maxSegmentCount)
+        , m_compression(compression) {}
+
+    void run() override;
+
+private:
+    QString m_fileName;
+    QString m_segmentName;
+    int m_maxSegmentCount;
+    bool m_compression;
+};
+
+class QUICKEN_PRIVATE_EXPORT QuickenBinaryLoggerPrivate
+{
+public:
+    enum {
+        Open = (1 << 0)
+    };
+
+    QuickenBinaryLoggerPrivate(const QString& fileName);
+    ~QuickenBinaryLoggerPrivate();
+
+    void write(const QuickenMetrics* metrics, int count);
+    void flush();
+
+    QFile m_file;
+    QElapsedTimer m_flushTimer;
+    QuickenMetrics* m_buffer;
+    int m_bufferCount;
+    int m_flushInterval;
+    quint8 m_flags;
+};
+
+class QUICKEN_PRIVATE_EXPORT QuickenFlightRecorderLoggerPrivate
+{
+public:
+    QuickenFlightRecorderLoggerPrivate(const QString& fileName, int capacity);
+
+    void write(const QuickenMetrics* metrics, int count);
+
+    QFile m_file;
+    QuickenBinaryLogHeader* m_header;  // nullptr if not open.
+    QuickenMetrics* m_records;
+    quint64 m_capacity;
+    quint64 m_writeIndex;
+};
+
+class QUICKEN_PRIVATE_EXPORT QuickenTraceLoggerPrivate
+{
+public:
+    enum {
+        Open = (1 << 0)
+    };
+
+    QuickenTraceLoggerPrivate(const QString& fileName);
+    ~QuickenTraceLoggerPrivate();
+
+    void log(const QuickenMetrics& metrics);
+    void writeSlice(const char* name, quint32 track, quint64 start, quint64 duration);
+    void writeTrackName(quint32 track, const char* name, quint32 windowId);
+    void append(const char* format, ...) Q_ATTRIBUTE_FORMAT_PRINTF(2, 3);
+    void flush();
+
+    QFile m_file;
+    QSet<quint32> m_namedWindows;
+    char* m_buffer;
+    int m_bufferSize;
+    quint32 m_processId;
+    quint32 m_inputEventCount;
+    quint8 m_flags;
+};
+
+class QUICKEN_PRIVATE_EXPORT QuickenCompactLoggerPrivate
+{
+public:
+    enum {
+        Open = (1 << 0)
+    };
+
+    // Pending records of a metrics type, or of a window for frame metrics.
+    struct Block {
+        QByteArray columns[maxCompactFieldCount];
+        QByteArray strings;
+        quint64 previous[maxCompactFieldCount];
+        quint64 firstTimeStamp;
+        quint64 lastTimeStamp;
+        quint32 window;
+        int count;
+        QuickenMetrics::Type type;
+    };
+
+    QuickenCompactLoggerPrivate(const QString& fileName);
+    ~QuickenCompactLoggerPrivate();
+
+    void write(const QuickenMetrics& metrics);
+    Block* block(QuickenMetrics::Type type, quint32 window);
+    void writeBlock(Block* block);
+    void releaseIdleBlocks(quint64 timeStamp);
+    void flush();
+
+    QFile m_file;
+    QHash<quint64, Block*> m_blocks;  // Keyed by type and window.
+    QByteArray m_payload;
+    Block* m_lastBlock;
+    quint64 m_releaseTimeStamp;
+    quint8 m_flags;
+};
+
+class QUICKEN_PRIVATE_EXPORT QuickenSocketLoggerPrivate
+{
+public:
+    enum {
+        Open      = (1 << 0),
+        Connected = (1 << 1)
+    };
+
+    QuickenSocketLoggerPrivate(const QString& socketPath, int capacity);
+    ~QuickenSocketLoggerPrivate();
+
+    void write(const QuickenMetrics* metrics, int count);
+    void connect();
+    void disconnect();
+    void send();
+
+    QByteArray m_socketPath;
+    QElapsedTimer m_connectTimer;
+    QuickenMetrics* m_buffer;
+    int m_capacity;
+    int m_bufferCount;
+    qint64 m_sendOffset;  // In bytes, from the start of the buffer.
+    int m_socket;
+    QAtomicInteger<quint32> m_droppedCount;
+    QAtomicInteger<quint32> m_flags;
+};
+
 #endif  // LOGGER_P_H
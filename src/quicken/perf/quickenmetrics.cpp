@@ -7,13 +7,20 @@
 #include "quickenmetrics_p.h"
 
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <cstdio>
+#include <cstdlib>
 
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
 
-const int bufferSize = 128;
+const int bufferSize = 256;
+const int memoryBufferSize = 2048;
 const int bufferAlignment = 64;
 
 QuickenMetricsUtils::QuickenMetricsUtils()
@@ -28,10 +35,19 @@ QuickenMetricsUtilsPrivate::QuickenMetricsUtilsPrivate()
 #else
     m_buffer = static_cast<char*>(alignedAlloc(bufferAlignment, bufferSize));
 #endif
-    m_cpuTimer.start();
-    m_cpuTicks = times(&m_cpuTimes);
+    m_minorFaults = 0;
+    m_majorFaults = 0;
+    m_voluntarySwitches = 0;
+    m_involuntarySwitches = 0;
+    m_readBytes = 0;
+    m_writeBytes = 0;
     m_cpuOnlineCores = sysconf(_SC_NPROCESSORS_ONLN);
     m_pageSize = sysconf(_SC_PAGESIZE);
+    m_flags = IoAccounting | SmapsRollup;
+
+    // Initialize the counters so that the first update reports the deltas
+    // since construction.
+    resetDeltas();
 }
 
 QuickenMetricsUtils::~QuickenMetricsUtils()
@@ -53,26 +69,53 @@ void QuickenMetricsUtils::updateProcessMetrics(QuickenMetrics* metrics)
     metrics->timeStamp = QuickenMetricsUtils::timeStamp();
     d->updateCpuUsage(metrics);
     d->updateProcStatMetrics(metrics);
+    d->updateContextSwitches(metrics);
+    d->updateIoMetrics(metrics);
+}
+
+void QuickenMetricsUtils::resetProcessMetrics()
+{
+    Q_D(QuickenMetricsUtils);
+    d->resetDeltas();
+}
+
+void QuickenMetricsUtilsPrivate::resetDeltas()
+{
+    m_cpuTimer.start();
+    m_cpuTime = QuickenMetricsUtils::processCpuTime();
+    QuickenMetrics metrics;
+    updateProcStatMetrics(&metrics);
+    updateContextSwitches(&metrics);
+    updateIoMetrics(&metrics);
+}
+
+void QuickenMetricsUtils::updateMemoryMetrics(QuickenMetrics* metrics)
+{
+    DASSERT(metrics);
+    Q_D(QuickenMetricsUtils);
+
+    metrics->type = QuickenMetrics::Memory;
+    metrics->timeStamp = QuickenMetricsUtils::timeStamp();
+    d->updateMemoryMetrics(metrics);
 }
 
 void QuickenMetricsUtilsPrivate::updateCpuUsage(QuickenMetrics* metrics)
 {
-    // times() is a Linux syscall giving CPU times used by the process. The
-    // granularity of the unit returned by the (some?) kernel (clock ticks)
-    // prevents us from getting precise timings at a high frequency, so we have
-    // to throttle to 200 ms (5 Hz).
-    const qint64 throttlingFrequency = 200;
-    if (m_cpuTimer.elapsed() > throttlingFrequency) {
-        struct tms newCpuTimes;
-        const clock_t newTicks = times(&newCpuTimes);
-        const clock_t ticks = newTicks - m_cpuTicks;
-        const clock_t userTime = newCpuTimes.tms_utime - m_cpuTimes.tms_utime;
-        const clock_t systemTime = newCpuTimes.tms_stime - m_cpuTimes.tms_stime;
-        metrics->process.cpuUsage = ((userTime + systemTime) * 100) / (ticks * m_cpuOnlineCores);
-        m_cpuTimer.start();
-        memcpy(&m_cpuTimes, &newCpuTimes, sizeof(struct tms));
-        m_cpuTicks = newTicks;
+    // The process CPU-time clock has a nanosecond resolution, unlike the clock
+    // ticks returned by times(), so the usage is precise whatever the update
+    // frequency.
+    const quint64 cpuTime = QuickenMetricsUtils::processCpuTime();
+    const quint64 elapsed = m_cpuTimer.nsecsElapsed();
+    m_cpuTimer.start();
+    metrics->process.cpuTime = cpuTime - m_cpuTime;
+    m_cpuTime = cpuTime;
+    if (elapsed > 0) {
+        metrics->process.preciseCpuUsage = static_cast<quint32>(
+            (metrics->process.cpuTime * 10000) / (elapsed * m_cpuOnlineCores));
+    } else {
+        metrics->process.preciseCpuUsage = 0;
     }
+    metrics->process.cpuUsage = (metrics->process.preciseCpuUsage + 50) / 100;
 }
 
 void QuickenMetricsUtilsPrivate::updateProcStatMetrics(QuickenMetrics* metrics)
@@ -90,13 +133,15 @@ void QuickenMetricsUtilsPrivate::updateProcStatMetrics(QuickenMetrics* metrics)
     }
 
     // Entries starting from 1 (as listed by 'man proc').
+    const int minorFaultsEntry = 10;
+    const int majorFaultsEntry = 12;
     const int numThreadsEntry = 20;
     const int vsizeEntry = 23;
     const int rssEntry = 24;
     const int lastEntry = rssEntry;
 
-    // Get the indices of num_threads, vsize and rss entries and check if
-    // the buffer is big enough.
+    // Get the indices of minflt, majflt, num_threads, vsize and rss entries and
+    // check if the buffer is big enough.
     int sourceIndex = 0, spaceCount = 0;
     quint16 entryIndices[lastEntry + 1];
     entryIndices[sourceIndex] = 0;
@@ -113,14 +158,20 @@ void QuickenMetricsUtilsPrivate::updateProcStatMetrics(QuickenMetrics* metrics)
         }
     }
 
-    unsigned long vsize;
+    unsigned long vsize, minorFaults, majorFaults;
     long threadCount, rss;
 #if !defined(QT_NO_DEBUG)
-    int value =  sscanf(&m_buffer[entryIndices[numThreadsEntry-1]], "%ld", &threadCount);
+    int value = sscanf(&m_buffer[entryIndices[minorFaultsEntry-1]], "%lu", &minorFaults);
+    ASSERT(value == 1);
+    value = sscanf(&m_buffer[entryIndices[majorFaultsEntry-1]], "%lu", &majorFaults);
+    ASSERT(value == 1);
+    value =  sscanf(&m_buffer[entryIndices[numThreadsEntry-1]], "%ld", &threadCount);
     ASSERT(value == 1);
     value =  sscanf(&m_buffer[entryIndices[vsizeEntry-1]], "%lu %ld", &vsize, &rss);
     ASSERT(value == 2);
 #else
+    sscanf(&m_buffer[entryIndices[minorFaultsEntry-1]], "%lu", &minorFaults);
+    sscanf(&m_buffer[entryIndices[majorFaultsEntry-1]], "%lu", &majorFaults);
     sscanf(&m_buffer[entryIndices[numThreadsEntry-1]], "%ld", &threadCount);
     sscanf(&m_buffer[entryIndices[vsizeEntry-1]], "%lu %ld", &vsize, &rss);
 #endif
@@ -128,8 +179,137 @@ void QuickenMetricsUtilsPrivate::updateProcStatMetrics(QuickenMetrics* metrics)
     metrics->process.vszMemory = vsize >> 10;
     metrics->process.rssMemory = (rss * m_pageSize) >> 10;
     metrics->process.threadCount = threadCount;
+    metrics->process.minorFaults = minorFaults - m_minorFaults;
+    metrics->process.majorFaults = majorFaults - m_majorFaults;
+    m_minorFaults = minorFaults;
+    m_majorFaults = majorFaults;
+
+    close(fd);
+}
+
+void QuickenMetricsUtilsPrivate::updateContextSwitches(QuickenMetrics* metrics)
+{
+    // getrusage() gives the same counters as the voluntary_ctxt_switches and
+    // nonvoluntary_ctxt_switches entries of '/proc/self/status', summed over
+    // all the threads, without having to parse the whole file.
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1) {
+        DWARN("MetricsUtils: can't get resource usage");
+        return;
+    }
 
+    const quint64 voluntarySwitches = usage.ru_nvcsw;
+    const quint64 involuntarySwitches = usage.ru_nivcsw;
+    metrics->process.voluntarySwitches = voluntarySwitches - m_voluntarySwitches;
+    metrics->process.involuntarySwitches = involuntarySwitches - m_involuntarySwitches;
+    m_voluntarySwitches = voluntarySwitches;
+    m_involuntarySwitches = involuntarySwitches;
+}
+
+void QuickenMetricsUtilsPrivate::updateIoMetrics(QuickenMetrics* metrics)
+{
+    metrics->process.readBytes = 0;
+    metrics->process.writeBytes = 0;
+
+    // '/proc/self/io' is missing on kernels built without task I/O accounting,
+    // don't try again in that case.
+    if (!(m_flags & IoAccounting)) {
+        return;
+    }
+    int fd = open("/proc/self/io", O_RDONLY);
+    if (fd == -1) {
+        DWARN("MetricsUtils: can't open '/proc/self/io'");
+        m_flags &= ~IoAccounting;
+        return;
+    }
+    const int readSize = read(fd, m_buffer, bufferSize - 1);
     close(fd);
+    if (readSize <= 0) {
+        DWARN("MetricsUtils: can't read '/proc/self/io'");
+        m_flags &= ~IoAccounting;
+        return;
+    }
+    m_buffer[readSize] = '\0';
+
+    // Lines are formatted as "name: value".
+    quint64 readBytes = m_readBytes, writeBytes = m_writeBytes;
+    const char* line = m_buffer;
+    while (line) {
+        if (!strncmp(line, "read_bytes: ", sizeof("read_bytes: ") - 1)) {
+            readBytes = strtoull(&line[sizeof("read_bytes: ") - 1], nullptr, 10);
+        } else if (!strncmp(line, "write_bytes: ", sizeof("write_bytes: ") - 1)) {
+            writeBytes = strtoull(&line[sizeof("write_bytes: ") - 1], nullptr, 10);
+        }
+        if ((line = strchr(line, '\n'))) {
+            line++;
+        }
+    }
+
+    metrics->process.readBytes = readBytes - m_readBytes;
+    metrics->process.writeBytes = writeBytes - m_writeBytes;
+    m_readBytes = readBytes;
+    m_writeBytes = writeBytes;
+}
+
+void QuickenMetricsUtilsPrivate::updateMemoryMetrics(QuickenMetrics* metrics)
+{
+    memset(&metrics->memory, 0, sizeof(metrics->memory));
+
+    // '/proc/self/smaps_rollup' is missing on kernels older than 4.14, don't
+    // try again in that case. Summing '/proc/self/smaps' instead would be way
+    // too expensive.
+    if (!(m_flags & SmapsRollup)) {
+        return;
+    }
+
+    int fd = open("/proc/self/smaps_rollup", O_RDONLY);
+    if (fd == -1) {
+        WARN("MetricsUtils: can't open '/proc/self/smaps_rollup', memory metrics disabled");
+        m_flags &= ~SmapsRollup;
+        return;
+    }
+    // The file is about 1 kB, a single read is enough.
+    char buffer[memoryBufferSize];
+    const int readSize = read(fd, buffer, memoryBufferSize - 1);
+    close(fd);
+    if (readSize <= 0) {
+        DWARN("MetricsUtils: can't read '/proc/self/smaps_rollup'");
+        return;
+    }
+    DASSERT(readSize < memoryBufferSize - 1);  // Consider increasing memoryBufferSize.
+    buffer[readSize] = '\0';
+
+    // Lines are formatted as "Name:   value kB", the first one being the
+    // address range header. The colon is part of the names so that prefixes
+    // of other entries (like "Pss_Anon:") don't match.
+    static const struct {
+        const char* const name;
+        int size;
+        quint32 QuickenMemoryMetrics::* field;
+    } entries[] = {
+        { "Pss:", sizeof("Pss:") - 1, &QuickenMemoryMetrics::pssMemory },
+        { "Private_Clean:", sizeof("Private_Clean:") - 1,
+          &QuickenMemoryMetrics::privateCleanMemory },
+        { "Private_Dirty:", sizeof("Private_Dirty:") - 1,
+          &QuickenMemoryMetrics::privateDirtyMemory },
+        { "Shared_Clean:", sizeof("Shared_Clean:") - 1, &QuickenMemoryMetrics::sharedMemory },
+        { "Shared_Dirty:", sizeof("Shared_Dirty:") - 1, &QuickenMemoryMetrics::sharedMemory },
+        { "Anonymous:", sizeof("Anonymous:") - 1, &QuickenMemoryMetrics::anonymousMemory },
+        { "Swap:", sizeof("Swap:") - 1, &QuickenMemoryMetrics::swapMemory }
+    };
+    const char* line = buffer;
+    while (line) {
+        for (int i = 0; i < static_cast<int>(ARRAY_SIZE(entries)); ++i) {
+            if (!strncmp(line, entries[i].name, entries[i].size)) {
+                metrics->memory.*entries[i].field +=
+                    static_cast<quint32>(strtoul(&line[entries[i].size], nullptr, 10));
+                break;
+            }
+        }
+        if ((line = strchr(line, '\n'))) {
+            line++;
+        }
+    }
 }
 
 // static.
@@ -144,3 +324,284 @@ quint64 QuickenMetricsUtils::timeStamp()
         return 0;
     }
 }
+
+// static.
+quint64 QuickenMetricsUtils::timeStampOrigin()
+{
+    const quint64 stamp = timeStamp();
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<quint64>(now.tv_sec) * Q_UINT64_C(1000000000) + now.tv_nsec - stamp;
+}
+
+// static.
+quint64 QuickenMetricsUtils::processCpuTime()
+{
+    struct timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) == -1) {
+        DWARN("MetricsUtils: can't get process CPU time");
+        return 0;
+    }
+    return static_cast<quint64>(time.tv_sec) * Q_UINT64_C(1000000000) + time.tv_nsec;
+}
+
+// static.
+quint64 QuickenMetricsUtils::threadCpuTime()
+{
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == -1) {
+        DWARN("MetricsUtils: can't get thread CPU time");
+        return 0;
+    }
+    return static_cast<quint64>(time.tv_sec) * Q_UINT64_C(1000000000) + time.tv_nsec;
+}
+
+// Gets the start time of the process in nanoseconds since boot. The 'starttime'
+// entry of '/proc/self/stat' is given in clock ticks since boot. Returns 0 on
+// failure.
+static quint64 processStartTime()
+{
+    int fd = open("/proc/self/stat", O_RDONLY);
+    if (fd == -1) {
+        DWARN("MetricsUtils: can't open '/proc/self/stat'");
+        return 0;
+    }
+    char buffer[memoryBufferSize];
+    const int readSize = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (readSize <= 0) {
+        DWARN("MetricsUtils: can't read '/proc/self/stat'");
+        return 0;
+    }
+    buffer[readSize] = '\0';
+
+    // Entries starting from 1 (as listed by 'man proc'). The command name
+    // (entry 2) is in parentheses and can contain spaces, entries are counted
+    // from its end.
+    const int startTimeEntry = 22;
+    const char* entry = strrchr(buffer, ')');
+    for (int i = 2; entry && i < startTimeEntry; ++i) {
+        entry = strchr(entry + 1, ' ');
+    }
+    unsigned long long startTime;
+    const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (!entry || sscanf(entry, "%llu", &startTime) != 1 || ticksPerSecond <= 0) {
+        DWARN("MetricsUtils: can't parse '/proc/self/stat'");
+        return 0;
+    }
+    return (startTime / ticksPerSecond) * Q_UINT64_C(1000000000)
+        + (startTime % ticksPerSecond) * Q_UINT64_C(1000000000) / ticksPerSecond;
+}
+
+// static.
+quint64 QuickenMetricsUtils::timeSinceProcessStart()
+{
+    // The start time is relative to the boot time clock, which keeps counting
+    // while the system is suspended.
+    static const quint64 startTime = processStartTime();
+    struct timespec now;
+    if (startTime == 0 || clock_gettime(CLOCK_BOOTTIME, &now) == -1) {
+        return 0;
+    }
+    const quint64 time = static_cast<quint64>(now.tv_sec) * Q_UINT64_C(1000000000) + now.tv_nsec;
+    return time > startTime ? time - startTime : 0;
+}
+
+struct ThreadTags
+{
+    quint32 tags;
+    quint32 window;
+};
+
+static QMutex* threadTagsMutex()
+{
+    static QMutex mutex;
+    return &mutex;
+}
+
+static QHash<quint32, ThreadTags>* threadTags()
+{
+    static QHash<quint32, ThreadTags> tags;
+    return &tags;
+}
+
+QuickenThreadSampler::QuickenThreadSampler()
+    : m_tickDuration(Q_UINT64_C(1000000000) / sysconf(_SC_CLK_TCK))
+    , m_flags(0)
+{
+#if !defined(QT_NO_DEBUG)
+    ASSERT(m_buffer = static_cast<char*>(alignedAlloc(bufferAlignment, bufferSize)));
+#else
+    m_buffer = static_cast<char*>(alignedAlloc(bufferAlignment, bufferSize));
+#endif
+
+    // Scheduler statistics are only available if the kernel has been built
+    // with CONFIG_SCHEDSTATS.
+    if (access("/proc/self/schedstat", R_OK) == 0) {
+        m_flags |= SchedStat;
+    }
+}
+
+QuickenThreadSampler::~QuickenThreadSampler()
+{
+    free(m_buffer);
+}
+
+// static.
+quint32 QuickenThreadSampler::threadId()
+{
+    return static_cast<quint32>(syscall(SYS_gettid));
+}
+
+// static.
+void QuickenThreadSampler::addThreadTags(quint32 tags, quint32 window)
+{
+    const quint32 id = threadId();
+    QMutexLocker locker(threadTagsMutex());
+    ThreadTags& threadTags = (*::threadTags())[id];
+    threadTags.tags |= tags;
+    if (tags & QuickenThreadMetrics::Render) {
+        threadTags.window = window;
+    }
+}
+
+// static.
+void QuickenThreadSampler::removeThreadTags(quint32 tags)
+{
+    const quint32 id = threadId();
+    QMutexLocker locker(threadTagsMutex());
+    QHash<quint32, ThreadTags>::iterator it = threadTags()->find(id);
+    if (it != threadTags()->end()) {
+        it->tags &= ~tags;
+        if (tags & QuickenThreadMetrics::Render) {
+            it->window = 0;
+        }
+        if (it->tags == 0) {
+            threadTags()->erase(it);
+        }
+    }
+}
+
+void QuickenThreadSampler::update(QVector<QuickenMetrics>* metrics)
+{
+    DASSERT(metrics);
+
+    metrics->resize(0);
+    const quint64 elapsed = m_timer.isValid() ? m_timer.nsecsElapsed() : 0;
+    m_timer.start();
+    const quint64 timeStamp = QuickenMetricsUtils::timeStamp();
+
+    DIR* directory = opendir("/proc/self/task");
+    if (!directory) {
+        DWARN("ThreadSampler: can't open '/proc/self/task'");
+        return;
+    }
+
+    threadTagsMutex()->lock();
+    const QHash<quint32, ThreadTags> tags = *threadTags();
+    threadTagsMutex()->unlock();
+
+    struct dirent* entry;
+    while ((entry = readdir(directory))) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        const quint32 id = static_cast<quint32>(strtoul(entry->d_name, nullptr, 10));
+        QuickenMetrics threadMetrics;
+        ThreadTimes times;
+        if (!readThreadMetrics(id, &threadMetrics, &times)) {
+            continue;  // The thread exited in the meantime.
+        }
+        m_nextThreads.insert(id, times);
+
+        QHash<quint32, ThreadTimes>::const_iterator previous = m_threads.constFind(id);
+        if (previous == m_threads.constEnd() || elapsed == 0) {
+            continue;
+        }
+        threadMetrics.type = QuickenMetrics::Thread;
+        threadMetrics.timeStamp = timeStamp;
+        threadMetrics.thread.id = id;
+        threadMetrics.thread.cpuTime = times.cpuTime - previous->cpuTime;
+        threadMetrics.thread.waitTime = times.waitTime - previous->waitTime;
+        threadMetrics.thread.sliceCount = times.sliceCount - previous->sliceCount;
+        threadMetrics.thread.cpuUsage =
+            qMin<quint64>((threadMetrics.thread.cpuTime * 100) / elapsed, 0xffff);
+        QHash<quint32, ThreadTags>::const_iterator threadTags = tags.constFind(id);
+        if (threadTags != tags.constEnd()) {
+            threadMetrics.thread.tags = threadTags->tags;
+            threadMetrics.thread.window = threadTags->window;
+        } else {
+            threadMetrics.thread.tags = 0;
+            threadMetrics.thread.window = 0;
+        }
+        metrics->append(threadMetrics);
+    }
+    closedir(directory);
+
+    // Threads not found anymore are dropped.
+    m_threads.swap(m_nextThreads);
+    m_nextThreads.clear();
+}
+
+bool QuickenThreadSampler::readThreadMetrics(
+    quint32 id, QuickenMetrics* metrics, ThreadTimes* times)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%u/stat", id);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    const int readSize = read(fd, m_buffer, bufferSize - 1);
+    close(fd);
+    if (readSize <= 0) {
+        return false;
+    }
+    m_buffer[readSize] = '\0';
+
+    // The name (entry 2) is enclosed in parentheses and can contain spaces and
+    // parentheses, entries are parsed from the last closing one.
+    const char* nameStart = strchr(m_buffer, '(');
+    const char* nameEnd = strrchr(m_buffer, ')');
+    if (!nameStart || !nameEnd || nameEnd < nameStart) {
+        DNOT_REACHED();
+        return false;
+    }
+    const int nameSize =
+        qMin(static_cast<int>(nameEnd - nameStart - 1),
+             static_cast<int>(QuickenThreadMetrics::maxNameSize) - 1);
+    memcpy(metrics->thread.name, nameStart + 1, nameSize);
+    memset(&metrics->thread.name[nameSize], 0, QuickenThreadMetrics::maxNameSize - nameSize);
+
+    // Get utime and stime (entries 14 and 15 as listed by 'man proc').
+    unsigned long userTicks, systemTicks;
+    if (sscanf(nameEnd + 1, " %*c %*d %*d %*d %*d %*d %*u %*lu %*lu %*lu %*lu %lu %lu",
+               &userTicks, &systemTicks) != 2) {
+        DNOT_REACHED();
+        return false;
+    }
+    times->cpuTime = static_cast<quint64>(userTicks + systemTicks) * m_tickDuration;
+    times->waitTime = 0;
+    times->sliceCount = 0;
+
+    // The scheduler gives the run time in nanoseconds, way more precise than
+    // the clock ticks of the stat entries.
+    if (m_flags & SchedStat) {
+        snprintf(path, sizeof(path), "/proc/self/task/%u/schedstat", id);
+        if ((fd = open(path, O_RDONLY)) != -1) {
+            const int readSize = read(fd, m_buffer, bufferSize - 1);
+            close(fd);
+            if (readSize > 0) {
+                m_buffer[readSize] = '\0';
+                unsigned long long runTime, waitTime, sliceCount;
+                if (sscanf(m_buffer, "%llu %llu %llu", &runTime, &waitTime, &sliceCount) == 3) {
+                    times->cpuTime = runTime;
+                    times->waitTime = waitTime;
+                    times->sliceCount = sliceCount;
+                }
+            }
+        }
+    }
+
+    return true;
+}
@@ -22,15 +22,51 @@ struct QUICKEN_EXPORT QuickenProcessMetrics
     quint32 rssMemory;
 
     // CPU usage of the process as a percentage. 100%, for instance, if all the
-    // cores are at 100% usage, 50% if half of the cores are at 100%.
+    // cores are at 100% usage, 50% if half of the cores are at 100%. Rounded
+    // value of preciseCpuUsage.
     quint16 cpuUsage;
 
     // Number of threads at buffer swap.
     quint16 threadCount;
 
+    // Number of metrics dropped by the logging queue since monitoring started.
+    quint32 droppedCount;
+
+    // Number of minor page faults (not requiring to load a page from disk)
+    // since the previous process metrics update.
+    quint32 minorFaults;
+
+    // Number of major page faults (requiring to load a page from disk) since
+    // the previous process metrics update.
+    quint32 majorFaults;
+
+    // Number of voluntary context switches (a thread blocking, waiting for a
+    // resource) since the previous process metrics update.
+    quint32 voluntarySwitches;
+
+    // Number of involuntary context switches (a thread preempted by the
+    // scheduler) since the previous process metrics update.
+    quint32 involuntarySwitches;
+
+    // Number of bytes fetched from the storage layer since the previous process
+    // metrics update. 0 if the kernel doesn't provide I/O accounting.
+    quint64 readBytes;
+
+    // Number of bytes sent to the storage layer since the previous process
+    // metrics update. 0 if the kernel doesn't provide I/O accounting.
+    quint64 writeBytes;
+
+    // CPU time in nanoseconds used by the threads of the process since the
+    // previous process metrics update.
+    quint64 cpuTime;
+
+    // CPU usage of the process in hundredths of a percent, with the same
+    // reference as cpuUsage (10000 if all the cores are at 100% usage).
+    quint32 preciseCpuUsage;
+
     // The whole struct must take 112 bytes to allow future additions and best
     // memory alignment, don't forget to update when adding new metrics.
-    quint8 __reserved[/*12 bytes taken,*/ 100 /*bytes free*/];
+    quint8 __reserved[/*60 bytes taken,*/ 52 /*bytes free*/];
 };
 Q_STATIC_ASSERT(sizeof(QuickenProcessMetrics) == 112);
 
@@ -82,9 +118,49 @@ struct QUICKEN_EXPORT QuickenFrameMetrics
     // Time in nanoseconds taken by the graphics subsystem's buffer swap call.
     quint64 swapTime;
 
+    // CPU time in nanoseconds used by the threads of the process since the
+    // last frame swap of the window.
+    quint64 cpuTime;
+
+    // Number of heap allocations and frees, and number of bytes allocated, by
+    // the render thread of the window since the last frame swap. 0 unless
+    // Quicken is built with the quicken_allocation_tracking option.
+    quint32 renderAllocations;
+    quint32 renderFrees;
+    quint64 renderAllocatedBytes;
+
+    // Same as above for the GUI thread. Same values as the render thread with
+    // the basic scene graph render loop.
+    quint32 guiAllocations;
+    quint32 guiFrees;
+    quint64 guiAllocatedBytes;
+
+    // Number of geometry nodes of the scene graph rendered opaque and rendered
+    // with blending. These are node counts, not batch counts, the batches
+    // being private to the renderer. Only set with the SceneGraphMetrics
+    // logging filter, 0 otherwise. Saturated at 65535.
+    quint16 opaqueNodes;
+    quint16 alphaNodes;
+
+    // Number of rendered geometry nodes the scene graph batch renderer can't
+    // merge with others, each one taking at least a draw call. Only set with
+    // the SceneGraphMetrics logging filter, 0 otherwise. Saturated at 65535.
+    quint16 unmergeableNodes;
+
+    // Number of draw calls issued by the scene graph. Only set with the
+    // OpenGLMetrics or TextureMetrics logging filters, 0 otherwise. Saturated
+    // at 65535.
+    quint16 drawCalls;
+
+    // Number of bytes uploaded to vertex and index buffers by the scene
+    // graph. Only set with the OpenGLMetrics or TextureMetrics logging
+    // filters, 0 otherwise. Saturated at 4294967295.
+    quint32 vertexBytes;
+    quint32 indexBytes;
+
     // The whole struct must take 112 bytes to allow future additions and best
     // memory alignment, don't forget to update when adding new metrics.
-    quint8 __reserved[/*48 bytes taken,*/ 64 /*bytes free*/];
+    quint8 __reserved[/*104 bytes taken,*/ 8 /*bytes free*/];
 };
 Q_STATIC_ASSERT(sizeof(QuickenFrameMetrics) == 112);
 
@@ -107,9 +183,322 @@ struct QUICKEN_EXPORT QuickenGenericMetrics
 };
 Q_STATIC_ASSERT(sizeof(QuickenGenericMetrics) == 112);
 
+struct QUICKEN_EXPORT QuickenThreadMetrics
+{
+    // Well-known threads, a thread can have several tags (the GUI thread is
+    // also the render thread with the basic scene graph render loop).
+    enum Tag { Gui = (1 << 0), Render = (1 << 1), Logging = (1 << 2), Logger = (1 << 3) };
+
+    static const quint32 maxNameSize = 16;
+
+    // Kernel thread id.
+    quint32 id;
+
+    // Id of the last window whose scene graph has been initialized in the
+    // thread if tagged Render, 0 otherwise.
+    quint32 window;
+
+    // Time in nanoseconds spent running on a CPU since the previous update.
+    quint64 cpuTime;
+
+    // Time in nanoseconds spent waiting on a run queue since the previous
+    // update. 0 if the kernel doesn't provide scheduler statistics.
+    quint64 waitTime;
+
+    // Number of time slices run on a CPU since the previous update. 0 if the
+    // kernel doesn't provide scheduler statistics.
+    quint32 sliceCount;
+
+    // CPU usage of the thread as a percentage of a single core.
+    quint16 cpuUsage;
+
+    // Null-terminated name of the thread as set by the kernel.
+    char name[maxNameSize];
+
+    // Combination of tags (see Tag).
+    quint8 tags;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*47 bytes taken,*/ 65 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenThreadMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenMemoryMetrics
+{
+    // Proportional set size (PSS) of the process in kilobytes, pages shared
+    // with other processes being divided by the number of processes sharing
+    // them.
+    quint32 pssMemory;
+
+    // Resident memory in kilobytes only mapped by the process and unmodified
+    // since it's been mapped (can be dropped under memory pressure).
+    quint32 privateCleanMemory;
+
+    // Resident memory in kilobytes only mapped by the process and modified
+    // since it's been mapped (must be swapped out under memory pressure).
+    quint32 privateDirtyMemory;
+
+    // Resident memory in kilobytes also mapped by other processes, clean and
+    // dirty.
+    quint32 sharedMemory;
+
+    // Resident memory in kilobytes not backed by a file.
+    quint32 anonymousMemory;
+
+    // Anonymous memory in kilobytes swapped out.
+    quint32 swapMemory;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*24 bytes taken,*/ 88 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenMemoryMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenTextureMetrics
+{
+    // The id of the window whose render thread handled the textures.
+    quint32 window;
+
+    // The number of the frame during which the textures have been uploaded
+    // (see QuickenFrameMetrics::number).
+    quint32 frame;
+
+    // Number of texture uploads made by the scene graph during the frame.
+    quint32 uploadCount;
+
+    // Number of bytes uploaded to textures during the frame.
+    quint32 uploadedBytes;
+
+    // Part of the uploads made to texture atlases (the scene graph texture
+    // atlas and the glyph caches) during the frame.
+    quint32 atlasUploadCount;
+    quint32 atlasUploadedBytes;
+
+    // Number of live textures of the share group of the window's OpenGL
+    // context, atlases included. Windows whose contexts share their objects
+    // report the same live textures.
+    quint32 textureCount;
+
+    // Estimated memory in kilobytes taken by the live textures, atlases
+    // included.
+    quint32 textureMemory;
+
+    // Number of live texture atlases and their estimated memory in kilobytes.
+    quint32 atlasCount;
+    quint32 atlasMemory;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*40 bytes taken,*/ 72 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenTextureMetrics) == 112);
+
+// The JavaScript engine is sampled by the GUI thread once per frame, right
+// before the scene graph is synchronized. Collections are detected with a
+// sentinel object checked at each sample, several collections between two
+// samples count as one. Their duration isn't reported, the V4 memory manager of
+// Qt 5 only prints its statistics to the standard error output (QV4_MM_STATS),
+// an upper bound is given instead.
+struct QUICKEN_EXPORT QuickenJavaScriptMetrics
+{
+    // The id of the window whose QML engine has been sampled.
+    quint32 window;
+
+    // The number of the frame prepared by the GUI thread when the engine has
+    // been sampled (see QuickenFrameMetrics::number). A collection reported
+    // here happened on the GUI thread since the previous sample, while it
+    // prepared that frame or while it was busy with something else or idle
+    // between frames.
+    quint32 frame;
+
+    // Memory in kilobytes of the JavaScript heap taken by live and not yet
+    // collected items, excluding large items.
+    quint32 usedMemory;
+
+    // Memory in kilobytes of the JavaScript heap taken by large items, which
+    // are allocated separately.
+    quint32 largeItemMemory;
+
+    // Memory in kilobytes allocated by the JavaScript heap from the system,
+    // used or not, excluding large items.
+    quint32 allocatedMemory;
+
+    // Whether a garbage collection has been detected since the previous
+    // sample, 0 or 1. Only one collection can be detected per sample.
+    quint32 collections;
+
+    // Number of garbage collections detected since monitoring started.
+    quint32 collectionCount;
+
+    // Estimated memory in kilobytes reclaimed by the collections of the frame,
+    // the drop of the used memory since the previous frame.
+    quint32 reclaimedMemory;
+
+    // Upper bound in nanoseconds of the time taken by the detected
+    // collections, the CPU time used by the GUI thread since the previous
+    // sample. Collections run on the GUI thread, they can't take more, but the
+    // bound includes everything else the thread did, the frame preparation
+    // for instance. 0 if no collection has been detected.
+    quint64 collectionTimeBound;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*40 bytes taken,*/ 72 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenJavaScriptMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenBindingMetrics
+{
+    static const quint32 maxLocationSize = 64;
+
+    // Rank of the binding among the hotspots of the update, 1 being the binding
+    // that took the most time since the previous update.
+    quint32 rank;
+
+    // Number of evaluations since the previous update.
+    quint32 evaluationCount;
+
+    // Time in nanoseconds spent evaluating the binding since the previous
+    // update, excluding the evaluation of the bindings it triggered.
+    quint64 time;
+
+    // Highest evaluation time in nanoseconds of the binding during a single
+    // frame since the previous update.
+    quint64 maxFrameTime;
+
+    // Time in nanoseconds spent evaluating the binding since profiling
+    // started.
+    quint64 totalTime;
+
+    // Highest number of evaluations of the binding during a single frame since
+    // the previous update.
+    quint32 maxFrameEvaluationCount;
+
+    // Number of evaluations since profiling started.
+    quint32 totalEvaluationCount;
+
+    // Null-terminated location of the binding as "file:line:column". The
+    // beginning of the file name is cut if too long.
+    char location[maxLocationSize];
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*104 bytes taken,*/ 8 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenBindingMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenAnimationMetrics
+{
+    // The id of the window whose GUI thread advanced the animations. Windows
+    // of the same thread share the animation ticks.
+    quint32 window;
+
+    // The number of the frame prepared by the GUI thread once the animations
+    // have been advanced (see QuickenFrameMetrics::number).
+    quint32 frame;
+
+    // Number of animations running on the GUI thread. Animators running on the
+    // render thread aren't taken into account.
+    quint32 runningAnimationCount;
+
+    // Number of animation ticks since the previous frame. Usually 1 while
+    // animations are running, more if the animation driver ticked several
+    // times between two frames.
+    quint32 tickCount;
+
+    // Time in nanoseconds spent advancing the animations during the ticks.
+    quint64 advanceTime;
+
+    // Time in nanoseconds the animation clock advanced during the ticks and
+    // wall-clock time in nanoseconds elapsed between the ticks.
+    quint64 animationTime;
+    quint64 wallTime;
+
+    // Drift in nanoseconds between the animation clock and the wall clock
+    // during the ticks (animationTime - wallTime). Positive when the animation
+    // clock skipped ahead, negative when it fell behind (slowed down
+    // animations for instance).
+    qint64 drift;
+
+    // Drift in nanoseconds accumulated since monitoring started.
+    qint64 totalDrift;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*56 bytes taken,*/ 56 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenAnimationMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenInputMetrics
+{
+    enum Type { Touch = 0, Mouse = 1, Key = 2, TypeCount = 3 };
+    enum Action { Press = 0, Move = 1, Release = 2, ActionCount = 3 };
+
+    // The id of the window targeted by the input event.
+    quint32 window;
+
+    // The number of the first frame synchronized after the event has been
+    // delivered, the first one that could show its result (see
+    // QuickenFrameMetrics::number).
+    quint32 frame;
+
+    // Time in nanoseconds between the creation of the event by the windowing
+    // system and its delivery to the window. Millisecond precision. Only
+    // available with the xcb and Wayland platform plugins, whose event time
+    // stamps are based on the monotonic clock, 0 otherwise.
+    quint64 queueingDelay;
+
+    // Time in nanoseconds between the creation of the event and the swap of
+    // the frame (queueingDelay included).
+    quint64 latency;
+
+    // Type of the input device and action of the event. Mouse events
+    // synthesized from touch events aren't reported.
+    Type type : 8;
+    Action action : 8;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*26 bytes taken,*/ 86 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenInputMetrics) == 112);
+
+struct QUICKEN_EXPORT QuickenStartupMetrics
+{
+    // Predefined milestones are only reported once per process, custom
+    // milestones are added by the application (see
+    // QuickenApplicationMonitor::addStartupMilestone()).
+    enum Milestone {
+        LibraryLoaded = 0, ApplicationCreated = 1, EngineCreated = 2, ComponentCompiled = 3,
+        RootObjectCreated = 4, WindowShown = 5, SceneGraphInitialized = 6, FirstFrameSwapped = 7,
+        Custom = 8, MilestoneCount = 9
+    };
+
+    static const quint32 maxNameSize = 64;
+
+    // Time in nanoseconds elapsed since the start of the process. The start
+    // time of the process has the precision of a clock tick (usually 10 ms).
+    quint64 time;
+
+    // Null-terminated name of the milestone.
+    char name[maxNameSize];
+
+    // The milestone.
+    Milestone milestone : 8;
+
+    // The whole struct must take 112 bytes to allow future additions and best
+    // memory alignment, don't forget to update when adding new metrics.
+    quint8 __reserved[/*73 bytes taken,*/ 39 /*bytes free*/];
+};
+Q_STATIC_ASSERT(sizeof(QuickenStartupMetrics) == 112);
+
 struct QUICKEN_EXPORT QuickenMetrics
 {
-    enum Type { Process = 0, Window = 1, Frame = 2, Generic = 3, TypeCount = 4 };
+    enum Type {
+        Process = 0, Window = 1, Frame = 2, Generic = 3, Thread = 4, Memory = 5, Texture = 6,
+        JavaScript = 7, Binding = 8, Animation = 9, Input = 10, Startup = 11, TypeCount = 12
+    };
 
     // Metrics type.
     Type type;
@@ -122,6 +511,14 @@ struct QUICKEN_EXPORT QuickenMetrics
         QuickenWindowMetrics window;
         QuickenFrameMetrics frame;
         QuickenGenericMetrics generic;
+        QuickenThreadMetrics thread;
+        QuickenMemoryMetrics memory;
+        QuickenTextureMetrics texture;
+        QuickenJavaScriptMetrics javaScript;
+        QuickenBindingMetrics binding;
+        QuickenAnimationMetrics animation;
+        QuickenInputMetrics input;
+        QuickenStartupMetrics startup;
     };
 };
 Q_STATIC_ASSERT(sizeof(QuickenMetrics) == 128);
@@ -138,10 +535,35 @@ public:
     // Fill the given metrics with updated process metrics.
     void updateProcessMetrics(QuickenMetrics* metrics);
 
+    // Restart the intervals over which the CPU usage, the page faults, the
+    // context switches and the I/O bytes of the process metrics are computed,
+    // so that the next update reports the deltas since this call.
+    void resetProcessMetrics();
+
+    // Fill the given metrics with updated memory metrics. The memory metrics
+    // are read from '/proc/self/smaps_rollup' (Linux 4.14 or later), which is
+    // much more expensive to read than process metrics since the kernel walks
+    // all the mappings. Fields are set to 0 if the file isn't available.
+    void updateMemoryMetrics(QuickenMetrics* metrics);
+
     // Get a time stamp in nanoseconds. The timer is started at the first call,
     // returning 0.
     static quint64 timeStamp();
 
+    // Get the wall-clock time in nanoseconds since the Unix epoch corresponding
+    // to a time stamp of 0.
+    static quint64 timeStampOrigin();
+
+    // Get the CPU time in nanoseconds used by the threads of the process.
+    static quint64 processCpuTime();
+
+    // Get the CPU time in nanoseconds used by the calling thread.
+    static quint64 threadCpuTime();
+
+    // Get the time in nanoseconds elapsed since the start of the process, read
+    // from '/proc/self/stat' in clock ticks. 0 if it can't be read.
+    static quint64 timeSinceProcessStart();
+
 private:
     QuickenMetricsUtilsPrivate* const d_ptr;
     Q_DECLARE_PRIVATE(QuickenMetricsUtils)
@@ -9,9 +9,9 @@
 
 #include <Quicken/quickenmetrics.h>
 
-#include <sys/times.h>
-
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
 
 #include <Quicken/private/quickenglobal_p.h>
 
@@ -21,15 +21,68 @@ public:
     QuickenMetricsUtilsPrivate();
     ~QuickenMetricsUtilsPrivate();
 
+    enum { IoAccounting = (1 << 0), SmapsRollup = (1 << 1) };
+
+    void resetDeltas();
     void updateCpuUsage(QuickenMetrics* metrics);
     void updateProcStatMetrics(QuickenMetrics* metrics);
+    void updateContextSwitches(QuickenMetrics* metrics);
+    void updateIoMetrics(QuickenMetrics* metrics);
+    void updateMemoryMetrics(QuickenMetrics* metrics);
 
     char* m_buffer;
     QElapsedTimer m_cpuTimer;
-    struct tms m_cpuTimes;
-    clock_t m_cpuTicks;
+    quint64 m_cpuTime;
+    quint64 m_minorFaults;
+    quint64 m_majorFaults;
+    quint64 m_voluntarySwitches;
+    quint64 m_involuntarySwitches;
+    quint64 m_readBytes;
+    quint64 m_writeBytes;
     quint16 m_cpuOnlineCores;
     quint16 m_pageSize;
+    quint32 m_flags;
+};
+
+// Samples the CPU usage of each thread of the process from
+// '/proc/self/task/<tid>/stat' and 'schedstat'. Well-known threads tag
+// themselves so that the metrics can be attributed.
+class QUICKEN_PRIVATE_EXPORT QuickenThreadSampler
+{
+public:
+    QuickenThreadSampler();
+    ~QuickenThreadSampler();
+
+    // Get the kernel id of the calling thread.
+    static quint32 threadId();
+
+    // Add or remove tags (see QuickenThreadMetrics::Tag) to the calling
+    // thread. The window id is stored along with the Render tag.
+    static void addThreadTags(quint32 tags, quint32 window = 0);
+    static void removeThreadTags(quint32 tags);
+
+    // Fill the given vector with updated metrics of each thread alive since
+    // the previous update. Threads seen for the first time are only
+    // registered.
+    void update(QVector<QuickenMetrics>* metrics);
+
+private:
+    enum { SchedStat = (1 << 0) };
+
+    struct ThreadTimes {
+        quint64 cpuTime;
+        quint64 waitTime;
+        quint64 sliceCount;
+    };
+
+    bool readThreadMetrics(quint32 id, QuickenMetrics* metrics, ThreadTimes* times);
+
+    char* m_buffer;
+    QElapsedTimer m_timer;
+    QHash<quint32, ThreadTimes> m_threads;
+    QHash<quint32, ThreadTimes> m_nextThreads;
+    quint64 m_tickDuration;
+    quint32 m_flags;
 };
 
 #endif  // METRICS_P_H
@@ -0,0 +1,521 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenopenglcounters_p.h"
+
+#include <atomic>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFunctions>
+
+#if !defined(GL_RED)
+#define GL_RED 0x1903  // For GL_EXT_texture_rg.
+#endif
+#if !defined(GL_RG)
+#define GL_RG 0x8227  // For GL_EXT_texture_rg.
+#endif
+
+static __thread QuickenOpenGLCounts counts;
+
+#if !(defined(QT_OPENGL_ES_2) && defined(Q_OS_ANDROID))
+
+typedef QOpenGLFunctionsPrivate::Functions Functions;
+
+// Entries of the first function table hooked, called by the hooks.
+static struct {
+    decltype(Functions::DrawArrays) drawArrays;
+    decltype(Functions::DrawElements) drawElements;
+    decltype(Functions::BufferData) bufferData;
+    decltype(Functions::BufferSubData) bufferSubData;
+    decltype(Functions::ActiveTexture) activeTexture;
+    decltype(Functions::BindTexture) bindTexture;
+    decltype(Functions::DeleteTextures) deleteTextures;
+    decltype(Functions::TexImage2D) texImage2D;
+    decltype(Functions::TexSubImage2D) texSubImage2D;
+    decltype(Functions::CompressedTexImage2D) compressedTexImage2D;
+    decltype(Functions::CompressedTexSubImage2D) compressedTexSubImage2D;
+    decltype(Functions::GenerateMipmap) generateMipmap;
+} original;
+
+struct TextureInfo
+{
+    quint64 baseBytes;  // Estimated size of the base level.
+    quint64 memory;     // Estimated size of all the levels.
+    bool empty;         // Base level specified without data.
+    bool mipmapped;
+    bool atlas;
+};
+
+// Live textures and installations of a share group.
+struct ShareGroup
+{
+    QHash<GLuint, TextureInfo> textures;
+    QuickenOpenGLTextureCounts counts;
+    int installCount;
+};
+
+// Only GL_TEXTURE_2D bindings of the first texture units are tracked, which is
+// what the scene graph uses. Bindings are tracked per thread rather than per
+// context since the scene graph binds a texture before specifying it, even
+// when a thread renders the contexts of several windows.
+const GLuint maxTextureUnits = 32;
+static __thread GLuint boundTextures[maxTextureUnits];
+static __thread GLuint activeTextureUnit;
+
+// Gives access to the function table of a QOpenGLFunctions, shared by all the
+// QOpenGLFunctions instances of a context share group.
+struct FunctionsAccessor : public QOpenGLFunctions
+{
+    static QOpenGLFunctionsPrivate* table(QOpenGLFunctions* functions) {
+        return functions->*(&FunctionsAccessor::d_ptr);
+    }
+};
+
+// Share groups keyed by their function table. The mutex is also taken by the
+// texture hooks, texture calls being rare compared to draw calls.
+static QHash<QOpenGLFunctionsPrivate*, ShareGroup*> shareGroups;
+static QMutex shareGroupsMutex;
+
+// Gets the share group of the current context, nullptr if not installed. Must
+// be called with the share groups mutex locked.
+static ShareGroup* currentShareGroup()
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    return context ? shareGroups.value(FunctionsAccessor::table(context->functions())) : nullptr;
+}
+
+static inline void countBufferUpload(GLenum target, qopengl_GLsizeiptr size)
+{
+    if (target == GL_ARRAY_BUFFER) {
+        counts.vertexBytes += size;
+    } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        counts.indexBytes += size;
+    }
+}
+
+static void QOPENGLF_APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    counts.drawCalls++;
+    original.drawArrays(mode, first, count);
+}
+
+static void QOPENGLF_APIENTRY drawElements(
+    GLenum mode, GLsizei count, GLenum type, const GLvoid* indices)
+{
+    counts.drawCalls++;
+    original.drawElements(mode, count, type, indices);
+}
+
+static void QOPENGLF_APIENTRY bufferData(
+    GLenum target, qopengl_GLsizeiptr size, const void* data, GLenum usage)
+{
+    // A null data pointer only allocates the buffer storage.
+    if (data) {
+        countBufferUpload(target, size);
+    }
+    original.bufferData(target, size, data, usage);
+}
+
+static void QOPENGLF_APIENTRY bufferSubData(
+    GLenum target, qopengl_GLintptr offset, qopengl_GLsizeiptr size, const void* data)
+{
+    countBufferUpload(target, size);
+    original.bufferSubData(target, offset, size, data);
+}
+
+// Estimates the size of a pixel, internal formats often pad RGB pixels to 4
+// bytes though.
+static quint64 bytesPerPixel(GLenum format, GLenum type)
+{
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4
+        || type == GL_UNSIGNED_SHORT_5_5_5_1) {
+        return 2;
+    }
+    quint64 componentSize;
+    if (type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT) {
+        componentSize = 4;
+    } else if (type == GL_UNSIGNED_SHORT || type == GL_SHORT) {
+        componentSize = 2;
+    } else {
+        componentSize = 1;
+    }
+    switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+    case GL_RED:
+    case GL_DEPTH_COMPONENT:
+        return componentSize;
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+        return 2 * componentSize;
+    case GL_RGB:
+        return 3 * componentSize;
+    default:
+        return 4 * componentSize;
+    }
+}
+
+static inline quint64 imageBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    return static_cast<quint64>(qMax(width, 0)) * static_cast<quint64>(qMax(height, 0))
+        * bytesPerPixel(format, type);
+}
+
+// Gets the info of the texture bound to the active unit, creating it if
+// requested. Returns nullptr if no texture is bound or tracked. Must be called
+// with the share groups mutex locked.
+static TextureInfo* boundTexture(ShareGroup* group, bool create)
+{
+    if (!group || activeTextureUnit >= maxTextureUnits || !boundTextures[activeTextureUnit]) {
+        return nullptr;
+    }
+    const GLuint texture = boundTextures[activeTextureUnit];
+    QHash<GLuint, TextureInfo>::iterator it = group->textures.find(texture);
+    if (it == group->textures.end()) {
+        if (!create) {
+            return nullptr;
+        }
+        it = group->textures.insert(texture, TextureInfo());
+        group->counts.textureCount++;
+    }
+    return &it.value();
+}
+
+static void updateTextureMemory(ShareGroup* group, TextureInfo* info)
+{
+    DASSERT(group);
+    DASSERT(info);
+
+    const quint64 memory = info->baseBytes + (info->mipmapped ? info->baseBytes / 3 : 0);
+    group->counts.textureMemory = group->counts.textureMemory - info->memory + memory;
+    if (info->atlas) {
+        group->counts.atlasMemory = group->counts.atlasMemory - info->memory + memory;
+    }
+    info->memory = memory;
+}
+
+// Sets the storage of a level of the bound texture.
+static void specifyTexture(
+    ShareGroup* group, GLenum target, GLint level, quint64 bytes, bool empty)
+{
+    if (target != GL_TEXTURE_2D) {
+        return;
+    }
+    if (TextureInfo* info = boundTexture(group, true)) {
+        if (level == 0) {
+            info->baseBytes = bytes;
+            info->empty = empty;
+        } else {
+            info->mipmapped = true;
+        }
+        updateTextureMemory(group, info);
+    }
+}
+
+static void countTextureUpload(quint64 bytes, const TextureInfo* info)
+{
+    counts.textureUploads++;
+    counts.textureUploadedBytes += bytes;
+    if (info && info->atlas) {
+        counts.atlasUploads++;
+        counts.atlasUploadedBytes += bytes;
+    }
+}
+
+// Counts an upload to a region of the bound texture, which turns textures
+// specified without data into atlases.
+static void countTextureSubUpload(GLenum target, quint64 bytes)
+{
+    QMutexLocker locker(&shareGroupsMutex);
+    ShareGroup* group = currentShareGroup();
+    TextureInfo* info = target == GL_TEXTURE_2D ? boundTexture(group, false) : nullptr;
+    if (info && info->empty && !info->atlas) {
+        info->atlas = true;
+        group->counts.atlasCount++;
+        group->counts.atlasMemory += info->memory;
+    }
+    countTextureUpload(bytes, info);
+}
+
+static void QOPENGLF_APIENTRY activeTexture(GLenum texture)
+{
+    activeTextureUnit = texture - GL_TEXTURE0;
+    original.activeTexture(texture);
+}
+
+static void QOPENGLF_APIENTRY bindTexture(GLenum target, GLuint texture)
+{
+    if (target == GL_TEXTURE_2D && activeTextureUnit < maxTextureUnits) {
+        boundTextures[activeTextureUnit] = texture;
+    }
+    original.bindTexture(target, texture);
+}
+
+static void QOPENGLF_APIENTRY deleteTextures(GLsizei n, const GLuint* textureIds)
+{
+    for (GLsizei i = 0; i < n; ++i) {
+        // Deleting a bound texture binds the default texture.
+        for (GLuint j = 0; j < maxTextureUnits; ++j) {
+            if (boundTextures[j] == textureIds[i]) {
+                boundTextures[j] = 0;
+            }
+        }
+    }
+    {
+        QMutexLocker locker(&shareGroupsMutex);
+        if (ShareGroup* group = currentShareGroup()) {
+            for (GLsizei i = 0; i < n; ++i) {
+                QHash<GLuint, TextureInfo>::iterator it = group->textures.find(textureIds[i]);
+                if (it != group->textures.end()) {
+                    group->counts.textureCount--;
+                    group->counts.textureMemory -= it.value().memory;
+                    if (it.value().atlas) {
+                        group->counts.atlasCount--;
+                        group->counts.atlasMemory -= it.value().memory;
+                    }
+                    group->textures.erase(it);
+                }
+            }
+        }
+    }
+    original.deleteTextures(n, textureIds);
+}
+
+static void QOPENGLF_APIENTRY texImage2D(
+    GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+    GLint border, GLenum format, GLenum type, const GLvoid* pixels)
+{
+    const quint64 bytes = imageBytes(width, height, format, type);
+    {
+        QMutexLocker locker(&shareGroupsMutex);
+        ShareGroup* group = currentShareGroup();
+        specifyTexture(group, target, level, bytes, !pixels);
+        if (pixels) {
+            countTextureUpload(
+                bytes, target == GL_TEXTURE_2D ? boundTexture(group, false) : nullptr);
+        }
+    }
+    original.texImage2D(
+        target, level, internalFormat, width, height, border, format, type, pixels);
+}
+
+static void QOPENGLF_APIENTRY texSubImage2D(
+    GLenum target, GLint level, GLint xOffset, GLint yOffset, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const GLvoid* pixels)
+{
+    countTextureSubUpload(target, imageBytes(width, height, format, type));
+    original.texSubImage2D(
+        target, level, xOffset, yOffset, width, height, format, type, pixels);
+}
+
+static void QOPENGLF_APIENTRY compressedTexImage2D(
+    GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height,
+    GLint border, GLsizei imageSize, const GLvoid* data)
+{
+    const quint64 bytes = qMax(imageSize, 0);
+    {
+        QMutexLocker locker(&shareGroupsMutex);
+        ShareGroup* group = currentShareGroup();
+        specifyTexture(group, target, level, bytes, !data);
+        if (data) {
+            countTextureUpload(
+                bytes, target == GL_TEXTURE_2D ? boundTexture(group, false) : nullptr);
+        }
+    }
+    original.compressedTexImage2D(
+        target, level, internalFormat, width, height, border, imageSize, data);
+}
+
+static void QOPENGLF_APIENTRY compressedTexSubImage2D(
+    GLenum target, GLint level, GLint xOffset, GLint yOffset, GLsizei width, GLsizei height,
+    GLenum format, GLsizei imageSize, const GLvoid* data)
+{
+    countTextureSubUpload(target, qMax(imageSize, 0));
+    original.compressedTexSubImage2D(
+        target, level, xOffset, yOffset, width, height, format, imageSize, data);
+}
+
+static void QOPENGLF_APIENTRY generateMipmap(GLenum target)
+{
+    if (target == GL_TEXTURE_2D) {
+        QMutexLocker locker(&shareGroupsMutex);
+        ShareGroup* group = currentShareGroup();
+        if (TextureInfo* info = boundTexture(group, false)) {
+            info->mipmapped = true;
+            updateTextureMemory(group, info);
+        }
+    }
+    original.generateMipmap(target);
+}
+
+#endif
+
+// static.
+bool QuickenOpenGLCounters::install()
+{
+#if defined(QT_OPENGL_ES_2) && defined(Q_OS_ANDROID)
+    return false;
+#else
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    DASSERT(context);
+    QOpenGLFunctionsPrivate* table = FunctionsAccessor::table(context->functions());
+    if (!table) {
+        return false;
+    }
+    Functions& functions = table->f;
+
+    QMutexLocker locker(&shareGroupsMutex);
+    if (functions.DrawArrays == drawArrays) {
+        // Already installed for that share group.
+        ShareGroup*& group = shareGroups[table];
+        if (!group) {
+            group = new ShareGroup();
+        }
+        group->installCount++;
+        return true;
+    }
+    if (original.drawArrays) {
+        // The hooks can only forward to a single set of entries, which is the
+        // case unless different OpenGL libraries are used.
+        if (functions.DrawArrays != original.drawArrays
+            || functions.DrawElements != original.drawElements
+            || functions.BufferData != original.bufferData
+            || functions.BufferSubData != original.bufferSubData
+            || functions.ActiveTexture != original.activeTexture
+            || functions.BindTexture != original.bindTexture
+            || functions.DeleteTextures != original.deleteTextures
+            || functions.TexImage2D != original.texImage2D
+            || functions.TexSubImage2D != original.texSubImage2D
+            || functions.CompressedTexImage2D != original.compressedTexImage2D
+            || functions.CompressedTexSubImage2D != original.compressedTexSubImage2D
+            || functions.GenerateMipmap != original.generateMipmap) {
+            DWARN("OpenGLCounters: can't count calls of different OpenGL libraries");
+            return false;
+        }
+    } else {
+        original.drawArrays = functions.DrawArrays;
+        original.drawElements = functions.DrawElements;
+        original.bufferData = functions.BufferData;
+        original.bufferSubData = functions.BufferSubData;
+        original.activeTexture = functions.ActiveTexture;
+        original.bindTexture = functions.BindTexture;
+        original.deleteTextures = functions.DeleteTextures;
+        original.texImage2D = functions.TexImage2D;
+        original.texSubImage2D = functions.TexSubImage2D;
+        original.compressedTexImage2D = functions.CompressedTexImage2D;
+        original.compressedTexSubImage2D = functions.CompressedTexSubImage2D;
+        original.generateMipmap = functions.GenerateMipmap;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // The table can be in use by the render threads of other windows of the
+    // share group, they either call an entry or its hook, which both work.
+    functions.DrawArrays = drawArrays;
+    functions.DrawElements = drawElements;
+    functions.BufferData = bufferData;
+    functions.BufferSubData = bufferSubData;
+    functions.ActiveTexture = activeTexture;
+    functions.BindTexture = bindTexture;
+    functions.DeleteTextures = deleteTextures;
+    functions.TexImage2D = texImage2D;
+    functions.TexSubImage2D = texSubImage2D;
+    functions.CompressedTexImage2D = compressedTexImage2D;
+    functions.CompressedTexSubImage2D = compressedTexSubImage2D;
+    functions.GenerateMipmap = generateMipmap;
+    // Replaces the share group of a destroyed table at the same address.
+    ShareGroup*& group = shareGroups[table];
+    delete group;
+    group = new ShareGroup();
+    group->installCount = 1;
+    return true;
+#endif
+}
+
+// static.
+void QuickenOpenGLCounters::uninstall()
+{
+#if !(defined(QT_OPENGL_ES_2) && defined(Q_OS_ANDROID))
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    DASSERT(context);
+    QOpenGLFunctionsPrivate* table = FunctionsAccessor::table(context->functions());
+    if (!table) {
+        return;
+    }
+    Functions& functions = table->f;
+
+    // The textures of the share group are freed along with its last context,
+    // they're forgotten with the last installation so that they aren't
+    // counted by a share group created later at the same address.
+    QMutexLocker locker(&shareGroupsMutex);
+    QHash<QOpenGLFunctionsPrivate*, ShareGroup*>::iterator it = shareGroups.find(table);
+    if (it == shareGroups.end() || --it.value()->installCount > 0) {
+        return;
+    }
+    delete it.value();
+    shareGroups.erase(it);
+
+    // The original entries are kept since the hooks can still be running in
+    // other render threads of the share group. Entries replaced by someone
+    // else since the installation are left untouched.
+    if (functions.DrawArrays == drawArrays) {
+        functions.DrawArrays = original.drawArrays;
+    }
+    if (functions.DrawElements == drawElements) {
+        functions.DrawElements = original.drawElements;
+    }
+    if (functions.BufferData == bufferData) {
+        functions.BufferData = original.bufferData;
+    }
+    if (functions.BufferSubData == bufferSubData) {
+        functions.BufferSubData = original.bufferSubData;
+    }
+    if (functions.ActiveTexture == activeTexture) {
+        functions.ActiveTexture = original.activeTexture;
+    }
+    if (functions.BindTexture == bindTexture) {
+        functions.BindTexture = original.bindTexture;
+    }
+    if (functions.DeleteTextures == deleteTextures) {
+        functions.DeleteTextures = original.deleteTextures;
+    }
+    if (functions.TexImage2D == texImage2D) {
+        functions.TexImage2D = original.texImage2D;
+    }
+    if (functions.TexSubImage2D == texSubImage2D) {
+        functions.TexSubImage2D = original.texSubImage2D;
+    }
+    if (functions.CompressedTexImage2D == compressedTexImage2D) {
+        functions.CompressedTexImage2D = original.compressedTexImage2D;
+    }
+    if (functions.CompressedTexSubImage2D == compressedTexSubImage2D) {
+        functions.CompressedTexSubImage2D = original.compressedTexSubImage2D;
+    }
+    if (functions.GenerateMipmap == generateMipmap) {
+        functions.GenerateMipmap = original.generateMipmap;
+    }
+#endif
+}
+
+// static.
+const QuickenOpenGLCounts& QuickenOpenGLCounters::threadCounts()
+{
+    return counts;
+}
+
+// static.
+QuickenOpenGLTextureCounts QuickenOpenGLCounters::textureCounts()
+{
+    QuickenOpenGLTextureCounts textureCounts;
+    memset(&textureCounts, 0, sizeof(textureCounts));
+#if !(defined(QT_OPENGL_ES_2) && defined(Q_OS_ANDROID))
+    QMutexLocker locker(&shareGroupsMutex);
+    if (const ShareGroup* group = currentShareGroup()) {
+        textureCounts = group->counts;
+    }
+#endif
+    return textureCounts;
+}
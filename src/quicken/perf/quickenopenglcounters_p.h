@@ -0,0 +1,78 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef OPENGLCOUNTERS_P_H
+#define OPENGLCOUNTERS_P_H
+
+#include <Quicken/private/quickenglobal_p.h>
+
+// OpenGL calls counted for a thread since it started.
+struct QuickenOpenGLCounts
+{
+    // Number of glDrawArrays() and glDrawElements() calls.
+    quint64 drawCalls;
+
+    // Number of bytes uploaded by glBufferData() and glBufferSubData() to
+    // vertex (GL_ARRAY_BUFFER) and index (GL_ELEMENT_ARRAY_BUFFER) buffers.
+    quint64 vertexBytes;
+    quint64 indexBytes;
+
+    // Number of texture uploads by glTexImage2D() with data, glTexSubImage2D(),
+    // glCompressedTexImage2D() and glCompressedTexSubImage2D() and number of
+    // bytes uploaded.
+    quint64 textureUploads;
+    quint64 textureUploadedBytes;
+
+    // Part of the texture uploads going to texture atlases. Atlases are told
+    // apart as textures allocated without data and then filled region by
+    // region, which is how the scene graph texture atlas and the glyph caches
+    // work.
+    quint64 atlasUploads;
+    quint64 atlasUploadedBytes;
+};
+
+// Live textures of a context share group.
+struct QuickenOpenGLTextureCounts
+{
+    // Number of live textures whose storage has been specified and estimated
+    // memory in bytes, atlases included. The memory is estimated from the size
+    // and the pixel format of the base level, plus a third when mipmapped.
+    quint64 textureCount;
+    quint64 textureMemory;
+
+    // Part of the live textures being atlases.
+    quint64 atlasCount;
+    quint64 atlasMemory;
+};
+
+// Counts the OpenGL calls made through QOpenGLFunctions, which is what the
+// QtQuick scene graph uses, by replacing entries of the function table shared
+// by the contexts of a share group. Calls are counted per thread so that they
+// can be attributed to the window rendered by the thread. Textures being
+// shared objects, the live ones are tracked per share group, only while
+// installed.
+class QUICKEN_PRIVATE_EXPORT QuickenOpenGLCounters
+{
+public:
+    // Hook the functions of the current context. Returns false if the calls
+    // can't be counted, QOpenGLFunctions calling the OpenGL library directly
+    // on some platforms. Must be called with a current context.
+    static bool install();
+
+    // Release an installation made with the current context. The original
+    // functions are restored and the live textures of the share group are
+    // forgotten once every installation of the share group has been released.
+    // Must be called with a current context.
+    static void uninstall();
+
+    // Get the counts of the calling thread.
+    static const QuickenOpenGLCounts& threadCounts();
+
+    // Get the live textures of the share group of the current context, zero
+    // if not installed. Must be called with a current context.
+    static QuickenOpenGLTextureCounts textureCounts();
+};
+
+#endif  // OPENGLCOUNTERS_P_H
@@ -40,22 +40,62 @@ static const struct {
     quint16 defaultWidth;
     QuickenMetrics::Type type;
 } metricInfo[] = {
-    { "cpuUsage",    sizeof("cpuUsage") - 1,    3, QuickenMetrics::Process },
-    { "threadCount", sizeof("threadCount") - 1, 3, QuickenMetrics::Process },
-    { "vszMemory",   sizeof("vszMemory") - 1,   8, QuickenMetrics::Process },
-    { "rssMemory",   sizeof("rssMemory") - 1,   8, QuickenMetrics::Process },
-    { "windowId",    sizeof("windowId") - 1,    2, QuickenMetrics::Window  },
-    { "windowSize",  sizeof("windowSize") - 1,  9, QuickenMetrics::Window  },
-    { "frameNumber", sizeof("frameNumber") - 1, 7, QuickenMetrics::Frame   },
-    { "deltaTime",   sizeof("deltaTime") - 1,   7, QuickenMetrics::Frame   },
-    { "syncTime",    sizeof("syncTime") - 1,    7, QuickenMetrics::Frame   },
-    { "renderTime",  sizeof("renderTime") - 1,  7, QuickenMetrics::Frame   },
-    { "gpuTime",     sizeof("gpuTime") - 1,     7, QuickenMetrics::Frame   },
-    { "totalTime",   sizeof("totalTime") - 1,   7, QuickenMetrics::Frame   }
+    { "cpuUsage",             sizeof("cpuUsage") - 1,             3, QuickenMetrics::Process },
+    { "preciseCpuUsage",      sizeof("preciseCpuUsage") - 1,      6, QuickenMetrics::Process },
+    { "threadCount",          sizeof("threadCount") - 1,          3, QuickenMetrics::Process },
+    { "vszMemory",            sizeof("vszMemory") - 1,            8, QuickenMetrics::Process },
+    { "rssMemory",            sizeof("rssMemory") - 1,            8, QuickenMetrics::Process },
+    { "droppedCount",         sizeof("droppedCount") - 1,         7, QuickenMetrics::Process },
+    { "minorFaults",          sizeof("minorFaults") - 1,          6, QuickenMetrics::Process },
+    { "majorFaults",          sizeof("majorFaults") - 1,          6, QuickenMetrics::Process },
+    { "voluntarySwitches",    sizeof("voluntarySwitches") - 1,    6, QuickenMetrics::Process },
+    { "involuntarySwitches",  sizeof("involuntarySwitches") - 1,  6, QuickenMetrics::Process },
+    { "readBytes",            sizeof("readBytes") - 1,            9, QuickenMetrics::Process },
+    { "writeBytes",           sizeof("writeBytes") - 1,           9, QuickenMetrics::Process },
+    { "guiCpuUsage",          sizeof("guiCpuUsage") - 1,          3, QuickenMetrics::Thread  },
+    { "renderCpuUsage",       sizeof("renderCpuUsage") - 1,       3, QuickenMetrics::Thread  },
+    { "loggingCpuUsage",      sizeof("loggingCpuUsage") - 1,      3, QuickenMetrics::Thread  },
+    { "pssMemory",            sizeof("pssMemory") - 1,            8, QuickenMetrics::Memory  },
+    { "privateCleanMemory",   sizeof("privateCleanMemory") - 1,   8, QuickenMetrics::Memory  },
+    { "privateDirtyMemory",   sizeof("privateDirtyMemory") - 1,   8, QuickenMetrics::Memory  },
+    { "sharedMemory",         sizeof("sharedMemory") - 1,         8, QuickenMetrics::Memory  },
+    { "anonymousMemory",      sizeof("anonymousMemory") - 1,      8, QuickenMetrics::Memory  },
+    { "swapMemory",           sizeof("swapMemory") - 1,           8, QuickenMetrics::Memory  },
+    { "windowId",             sizeof("windowId") - 1,             2, QuickenMetrics::Window  },
+    { "windowSize",           sizeof("windowSize") - 1,           9, QuickenMetrics::Window  },
+    { "frameNumber",          sizeof("frameNumber") - 1,          7, QuickenMetrics::Frame   },
+    { "deltaTime",            sizeof("deltaTime") - 1,            7, QuickenMetrics::Frame   },
+    { "syncTime",             sizeof("syncTime") - 1,             7, QuickenMetrics::Frame   },
+    { "renderTime",           sizeof("renderTime") - 1,           7, QuickenMetrics::Frame   },
+    { "gpuTime",              sizeof("gpuTime") - 1,              7, QuickenMetrics::Frame   },
+    { "totalTime",            sizeof("totalTime") - 1,            7, QuickenMetrics::Frame   },
+    { "frameCpuTime",         sizeof("frameCpuTime") - 1,         7, QuickenMetrics::Frame   },
+    { "renderAllocations",    sizeof("renderAllocations") - 1,    5, QuickenMetrics::Frame   },
+    { "guiAllocations",       sizeof("guiAllocations") - 1,       5, QuickenMetrics::Frame   },
+    { "opaqueNodes",          sizeof("opaqueNodes") - 1,          5, QuickenMetrics::Frame   },
+    { "alphaNodes",           sizeof("alphaNodes") - 1,           5, QuickenMetrics::Frame   },
+    { "unmergeableNodes",     sizeof("unmergeableNodes") - 1,     5, QuickenMetrics::Frame   },
+    { "drawCalls",            sizeof("drawCalls") - 1,            5, QuickenMetrics::Frame   },
+    { "vertexBytes",          sizeof("vertexBytes") - 1,          8, QuickenMetrics::Frame   },
+    { "indexBytes",           sizeof("indexBytes") - 1,           8, QuickenMetrics::Frame   },
+    { "textureUploads",       sizeof("textureUploads") - 1,       4, QuickenMetrics::Texture },
+    { "textureUploadedBytes", sizeof("textureUploadedBytes") - 1, 9, QuickenMetrics::Texture },
+    { "atlasUploads",         sizeof("atlasUploads") - 1,         4, QuickenMetrics::Texture },
+    { "atlasUploadedBytes",   sizeof("atlasUploadedBytes") - 1,   9, QuickenMetrics::Texture },
+    { "textureCount",         sizeof("textureCount") - 1,         5, QuickenMetrics::Texture },
+    { "textureMemory",        sizeof("textureMemory") - 1,        8, QuickenMetrics::Texture },
+    { "atlasCount",           sizeof("atlasCount") - 1,           3, QuickenMetrics::Texture },
+    { "atlasMemory",          sizeof("atlasMemory") - 1,          8, QuickenMetrics::Texture }
 };
 enum {
-    CpuUsage = 0, ThreadCount, VszMemory, RssMemory, WindowId, WindowSize, FrameNumber, DeltaTime,
-    SyncTime, RenderTime, GpuTime, TotalTime, MetricCount
+    CpuUsage = 0, PreciseCpuUsage, ThreadCount, VszMemory, RssMemory, DroppedCount,
+    MinorFaults, MajorFaults, VoluntarySwitches, InvoluntarySwitches, ReadBytes, WriteBytes,
+    GuiCpuUsage, RenderCpuUsage, LoggingCpuUsage, PssMemory, PrivateCleanMemory,
+    PrivateDirtyMemory, SharedMemory, AnonymousMemory, SwapMemory, WindowId, WindowSize,
+    FrameNumber, DeltaTime, SyncTime, RenderTime, GpuTime, TotalTime, FrameCpuTime,
+    RenderAllocations, GuiAllocations, OpaqueNodes, AlphaNodes, UnmergeableNodes, DrawCalls,
+    VertexBytes, IndexBytes, TextureUploads, TextureUploadedBytes, AtlasUploads,
+    AtlasUploadedBytes, TextureCount, TextureMemory, AtlasCount, AtlasMemory, MetricCount
 };
 Q_STATIC_ASSERT(ARRAY_SIZE(metricInfo) == MetricCount);
 
@@ -81,13 +121,17 @@ QuickenOverlay::QuickenOverlay(const char* text, int windowId)
     , m_metricsSize{}
     , m_frameSize(0, 0)
     , m_windowId(windowId)
-    , m_flags(DirtyText | DirtyProcessMetrics)
+    , m_flags(DirtyText | DirtyProcessMetrics | DirtyThreadMetrics | DirtyMemoryMetrics)
+    , m_requirements(textRequirements(text))
+    , m_threadCpuUsage{}
 {
     DASSERT(text);
 
     m_buffer = alignedAlloc(bufferAlignment, bufferSize);
     memset(&m_processMetrics, 0, sizeof(m_processMetrics));
     m_processMetrics.type = QuickenMetrics::Process;
+    memset(&m_memoryMetrics, 0, sizeof(m_memoryMetrics));
+    m_memoryMetrics.type = QuickenMetrics::Memory;
 }
 
 QuickenOverlay::~QuickenOverlay()
@@ -139,7 +183,39 @@ void QuickenOverlay::setProcessMetrics(const QuickenMetrics& processMetrics)
     m_flags |= DirtyProcessMetrics;
 }
 
-void QuickenOverlay::render(const QuickenMetrics& frameMetrics, const QSize& frameSize)
+void QuickenOverlay::setMemoryMetrics(const QuickenMetrics& memoryMetrics)
+{
+    DASSERT(memoryMetrics.type == QuickenMetrics::Memory);
+
+    memcpy(&m_memoryMetrics, &memoryMetrics, sizeof(m_memoryMetrics));
+    m_flags |= DirtyMemoryMetrics;
+}
+
+void QuickenOverlay::setThreadMetrics(const QuickenMetrics* threadMetrics, int count)
+{
+    DASSERT(threadMetrics || count == 0);
+
+    // The logging usage sums the logging thread and the logger workers.
+    memset(m_threadCpuUsage, 0, sizeof(m_threadCpuUsage));
+    for (int i = 0; i < count; ++i) {
+        DASSERT(threadMetrics[i].type == QuickenMetrics::Thread);
+        const QuickenThreadMetrics& metrics = threadMetrics[i].thread;
+        if (metrics.tags & QuickenThreadMetrics::Gui) {
+            m_threadCpuUsage[GuiThread] = metrics.cpuUsage;
+        }
+        if ((metrics.tags & QuickenThreadMetrics::Render) && metrics.window == m_windowId) {
+            m_threadCpuUsage[RenderThread] = metrics.cpuUsage;
+        }
+        if (metrics.tags & (QuickenThreadMetrics::Logging | QuickenThreadMetrics::Logger)) {
+            m_threadCpuUsage[LoggingThreads] += metrics.cpuUsage;
+        }
+    }
+    m_flags |= DirtyThreadMetrics;
+}
+
+void QuickenOverlay::render(
+    const QuickenMetrics& frameMetrics, const QuickenMetrics& textureMetrics,
+    const QSize& frameSize)
 {
     DASSERT(m_flags & Initialized);
     DASSERT(m_context == QOpenGLContext::currentContext());
@@ -159,7 +235,16 @@ void QuickenOverlay::render(const QuickenMetrics& frameMetrics, const QSize& fra
         updateProcessMetrics();
         m_flags &= ~DirtyProcessMetrics;
     }
+    if (m_flags & DirtyThreadMetrics) {
+        updateThreadMetrics();
+        m_flags &= ~DirtyThreadMetrics;
+    }
+    if (m_flags & DirtyMemoryMetrics) {
+        updateMemoryMetrics();
+        m_flags &= ~DirtyMemoryMetrics;
+    }
     updateFrameMetrics(frameMetrics);
+    updateTextureMetrics(textureMetrics);
     m_bitmapText.render();
 }
 
@@ -179,15 +264,14 @@ static int integerMetricToText(quint64 metric, char* text, int width)
     return width;
 }
 
-// Writes a 64-bit unsigned integer representing time in nanoseconds as text in
-// milliseconds with two decimal digits. The string is right aligned. Returns
-// the remaining width.
-static int timeMetricToText(quint64 metric, char* text, int width)
+// Writes a 64-bit unsigned integer representing a fixed-point value in
+// hundredths as text with two decimal digits. The string is right
+// aligned. Returns the remaining width.
+static int fixedPointMetricToText(quint64 metric, char* text, int width)
 {
     DASSERT(text);
     DASSERT(width > 0);
 
-    metric /= 10000;  // 10^−9 to 10^−5 (to keep 2 valid decimal digits).
     const int decimalCount = 2;
     const char decimalPoint = '.';
     int i = 0;
@@ -222,6 +306,23 @@ static int timeMetricToText(quint64 metric, char* text, int width)
     return width;
 }
 
+// Writes a 64-bit unsigned integer representing time in nanoseconds as text in
+// milliseconds with two decimal digits. The string is right aligned. Returns
+// the remaining width.
+static int timeMetricToText(quint64 metric, char* text, int width)
+{
+    // 10^−9 to 10^−5 (to keep 2 valid decimal digits).
+    return fixedPointMetricToText(metric / 10000, text, width);
+}
+
+// Writes a 32-bit unsigned integer representing a percentage in hundredths of
+// a percent as text with two decimal digits. The string is right
+// aligned. Returns the remaining width.
+static int percentageMetricToText(quint32 metric, char* text, int width)
+{
+    return fixedPointMetricToText(metric, text, width);
+}
+
 void QuickenOverlay::updateFrameMetrics(const QuickenMetrics& metrics)
 {
     DASSERT(m_flags & Initialized);
@@ -261,6 +362,33 @@ void QuickenOverlay::updateFrameMetrics(const QuickenMetrics& metrics)
             timeMetricToText(time, text, textWidth);
             break;
         }
+        case FrameCpuTime:
+            timeMetricToText(metrics.frame.cpuTime, text, textWidth);
+            break;
+        case RenderAllocations:
+            integerMetricToText(metrics.frame.renderAllocations, text, textWidth);
+            break;
+        case GuiAllocations:
+            integerMetricToText(metrics.frame.guiAllocations, text, textWidth);
+            break;
+        case OpaqueNodes:
+            integerMetricToText(metrics.frame.opaqueNodes, text, textWidth);
+            break;
+        case AlphaNodes:
+            integerMetricToText(metrics.frame.alphaNodes, text, textWidth);
+            break;
+        case UnmergeableNodes:
+            integerMetricToText(metrics.frame.unmergeableNodes, text, textWidth);
+            break;
+        case DrawCalls:
+            integerMetricToText(metrics.frame.drawCalls, text, textWidth);
+            break;
+        case VertexBytes:
+            integerMetricToText(metrics.frame.vertexBytes, text, textWidth);
+            break;
+        case IndexBytes:
+            integerMetricToText(metrics.frame.indexBytes, text, textWidth);
+            break;
         default:
             DNOT_REACHED();
             break;
@@ -323,6 +451,9 @@ void QuickenOverlay::updateProcessMetrics()
         case CpuUsage:
             integerMetricToText(m_processMetrics.process.cpuUsage, text, textWidth);
             break;
+        case PreciseCpuUsage:
+            percentageMetricToText(m_processMetrics.process.preciseCpuUsage, text, textWidth);
+            break;
         case ThreadCount:
             integerMetricToText(m_processMetrics.process.threadCount, text, textWidth);
             break;
@@ -332,6 +463,27 @@ void QuickenOverlay::updateProcessMetrics()
         case RssMemory:
             integerMetricToText(m_processMetrics.process.rssMemory, text, textWidth);
             break;
+        case DroppedCount:
+            integerMetricToText(m_processMetrics.process.droppedCount, text, textWidth);
+            break;
+        case MinorFaults:
+            integerMetricToText(m_processMetrics.process.minorFaults, text, textWidth);
+            break;
+        case MajorFaults:
+            integerMetricToText(m_processMetrics.process.majorFaults, text, textWidth);
+            break;
+        case VoluntarySwitches:
+            integerMetricToText(m_processMetrics.process.voluntarySwitches, text, textWidth);
+            break;
+        case InvoluntarySwitches:
+            integerMetricToText(m_processMetrics.process.involuntarySwitches, text, textWidth);
+            break;
+        case ReadBytes:
+            integerMetricToText(m_processMetrics.process.readBytes, text, textWidth);
+            break;
+        case WriteBytes:
+            integerMetricToText(m_processMetrics.process.writeBytes, text, textWidth);
+            break;
         default:
             DNOT_REACHED();
             break;
@@ -343,6 +495,124 @@ void QuickenOverlay::updateProcessMetrics()
     }
 }
 
+void QuickenOverlay::updateThreadMetrics()
+{
+    DASSERT(m_flags & Initialized);
+
+    char* text = static_cast<char*>(m_buffer);
+    for (int i = 0; i < m_metricsSize[QuickenMetrics::Thread]; i++) {
+        int textWidth = m_metrics[QuickenMetrics::Thread][i].width;
+        DASSERT(textWidth <= maxMetricsWidth);
+        memset(text, ' ', maxMetricsWidth);
+
+        switch (m_metrics[QuickenMetrics::Thread][i].index) {
+        case GuiCpuUsage:
+            integerMetricToText(m_threadCpuUsage[GuiThread], text, textWidth);
+            break;
+        case RenderCpuUsage:
+            integerMetricToText(m_threadCpuUsage[RenderThread], text, textWidth);
+            break;
+        case LoggingCpuUsage:
+            integerMetricToText(m_threadCpuUsage[LoggingThreads], text, textWidth);
+            break;
+        default:
+            DNOT_REACHED();
+            break;
+        }
+
+        m_bitmapText.updateText(
+            text, m_metrics[QuickenMetrics::Thread][i].textIndex,
+            m_metrics[QuickenMetrics::Thread][i].width);
+    }
+}
+
+void QuickenOverlay::updateMemoryMetrics()
+{
+    DASSERT(m_flags & Initialized);
+
+    char* text = static_cast<char*>(m_buffer);
+    for (int i = 0; i < m_metricsSize[QuickenMetrics::Memory]; i++) {
+        int textWidth = m_metrics[QuickenMetrics::Memory][i].width;
+        DASSERT(textWidth <= maxMetricsWidth);
+        memset(text, ' ', maxMetricsWidth);
+
+        switch (m_metrics[QuickenMetrics::Memory][i].index) {
+        case PssMemory:
+            integerMetricToText(m_memoryMetrics.memory.pssMemory, text, textWidth);
+            break;
+        case PrivateCleanMemory:
+            integerMetricToText(m_memoryMetrics.memory.privateCleanMemory, text, textWidth);
+            break;
+        case PrivateDirtyMemory:
+            integerMetricToText(m_memoryMetrics.memory.privateDirtyMemory, text, textWidth);
+            break;
+        case SharedMemory:
+            integerMetricToText(m_memoryMetrics.memory.sharedMemory, text, textWidth);
+            break;
+        case AnonymousMemory:
+            integerMetricToText(m_memoryMetrics.memory.anonymousMemory, text, textWidth);
+            break;
+        case SwapMemory:
+            integerMetricToText(m_memoryMetrics.memory.swapMemory, text, textWidth);
+            break;
+        default:
+            DNOT_REACHED();
+            break;
+        }
+
+        m_bitmapText.updateText(
+            text, m_metrics[QuickenMetrics::Memory][i].textIndex,
+            m_metrics[QuickenMetrics::Memory][i].width);
+    }
+}
+
+void QuickenOverlay::updateTextureMetrics(const QuickenMetrics& textureMetrics)
+{
+    DASSERT(m_flags & Initialized);
+    DASSERT(textureMetrics.type == QuickenMetrics::Texture);
+
+    char* text = static_cast<char*>(m_buffer);
+    for (int i = 0; i < m_metricsSize[QuickenMetrics::Texture]; i++) {
+        int textWidth = m_metrics[QuickenMetrics::Texture][i].width;
+        DASSERT(textWidth <= maxMetricsWidth);
+        memset(text, ' ', maxMetricsWidth);
+
+        switch (m_metrics[QuickenMetrics::Texture][i].index) {
+        case TextureUploads:
+            integerMetricToText(textureMetrics.texture.uploadCount, text, textWidth);
+            break;
+        case TextureUploadedBytes:
+            integerMetricToText(textureMetrics.texture.uploadedBytes, text, textWidth);
+            break;
+        case AtlasUploads:
+            integerMetricToText(textureMetrics.texture.atlasUploadCount, text, textWidth);
+            break;
+        case AtlasUploadedBytes:
+            integerMetricToText(textureMetrics.texture.atlasUploadedBytes, text, textWidth);
+            break;
+        case TextureCount:
+            integerMetricToText(textureMetrics.texture.textureCount, text, textWidth);
+            break;
+        case TextureMemory:
+            integerMetricToText(textureMetrics.texture.textureMemory, text, textWidth);
+            break;
+        case AtlasCount:
+            integerMetricToText(textureMetrics.texture.atlasCount, text, textWidth);
+            break;
+        case AtlasMemory:
+            integerMetricToText(textureMetrics.texture.atlasMemory, text, textWidth);
+            break;
+        default:
+            DNOT_REACHED();
+            break;
+        }
+
+        m_bitmapText.updateText(
+            text, m_metrics[QuickenMetrics::Texture][i].textIndex,
+            m_metrics[QuickenMetrics::Texture][i].width);
+    }
+}
+
 static int cpuModel(char* buffer, int bufferSize)
 {
     DASSERT(buffer);
@@ -496,6 +766,36 @@ int QuickenOverlay::keywordString(int index, char* buffer, int bufferSize)
     return size;
 }
 
+// Looks up the metrics of the text like parseText() does, without formatting
+// it, so that it can be done before the OpenGL resources are initialized.
+quint8 QuickenOverlay::textRequirements(const char* text)
+{
+    quint8 requirements = 0;
+    for (const char* character = strchr(text, '%'); character;
+         character = strchr(character, '%')) {
+        character++;
+        if (*character == '%') {
+            character++;
+            continue;
+        }
+        for (int i = 0; i < 2 && isdigit(*character); i++) {
+            character++;
+        }
+        for (int i = 0; i < MetricCount; i++) {
+            if (!strncmp(character, metricInfo[i].name, metricInfo[i].size)) {
+                if (i >= OpaqueNodes && i <= UnmergeableNodes) {
+                    requirements |= SceneGraphRequired;
+                } else if (i >= DrawCalls) {
+                    requirements |= OpenGLCountersRequired;
+                }
+                character += metricInfo[i].size;
+                break;
+            }
+        }
+    }
+    return requirements;
+}
+
 void QuickenOverlay::parseText()
 {
     QByteArray textLatin1 = m_text.toLatin1();
@@ -21,9 +21,18 @@ class QOpenGLContext;
 class QUICKEN_PRIVATE_EXPORT QuickenOverlay
 {
 public:
+    enum Requirement {
+        SceneGraphRequired     = (1 << 0),  // Shows geometry node counts.
+        OpenGLCountersRequired = (1 << 1)   // Shows OpenGL call or texture counts.
+    };
+
     QuickenOverlay(const char* text, int windowId);
     ~QuickenOverlay();
 
+    // Gets the instrumentation required by the metrics of the text, which the
+    // logging filter might not enable. Can be called from any thread.
+    quint8 requirements() const { return m_requirements; }
+
     // Allocates/Deletes the OpenGL resources. finalize() is not called at
     // destruction, it must be explicitly called to free the resources at the
     // right time in a thread with the same OpenGL context bound than at
@@ -34,23 +43,39 @@ public:
     // Sets the process metrics.
     void setProcessMetrics(const QuickenMetrics& processMetrics);
 
+    // Sets the memory metrics.
+    void setMemoryMetrics(const QuickenMetrics& memoryMetrics);
+
+    // Sets the thread metrics of all the threads sampled at once.
+    void setThreadMetrics(const QuickenMetrics* threadMetrics, int count);
+
     // Renders the overlay. Must be called in a thread with the same OpenGL
     // context bound than at initialize().
-    void render(const QuickenMetrics& frameMetrics, const QSize& frameSize);
+    void render(
+        const QuickenMetrics& frameMetrics, const QuickenMetrics& textureMetrics,
+        const QSize& frameSize);
 
 private:
     void updateFrameMetrics(const QuickenMetrics& frameMetrics);
+    void updateTextureMetrics(const QuickenMetrics& textureMetrics);
     void updateWindowMetrics(quint32 windowId, const QSize& frameSize);
     void updateProcessMetrics();
+    void updateThreadMetrics();
+    void updateMemoryMetrics();
     int keywordString(int index, char* buffer, int bufferSize);
     void parseText();
+    static quint8 textRequirements(const char* text);
 
     enum {
         Initialized         = (1 << 0),
         DirtyText           = (1 << 1),
-        DirtyProcessMetrics = (1 << 2)
+        DirtyProcessMetrics = (1 << 2),
+        DirtyThreadMetrics  = (1 << 3),
+        DirtyMemoryMetrics  = (1 << 4)
     };
 
+    enum { GuiThread = 0, RenderThread, LoggingThreads, ThreadUsageCount };
+
     static const int maxMetricsPerType = 16;
 
     void* m_buffer;
@@ -69,7 +94,10 @@ private:
     QSize m_frameSize;
     quint32 m_windowId;
     quint8 m_flags;
+    quint8 m_requirements;
+    quint16 m_threadCpuUsage[ThreadUsageCount];
     alignas(64) QuickenMetrics m_processMetrics;
+    alignas(64) QuickenMetrics m_memoryMetrics;
 };
 
 #endif  // OVERLAY_P_H
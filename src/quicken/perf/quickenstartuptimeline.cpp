@@ -0,0 +1,89 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#include "quickenstartuptimeline_p.h"
+
+#include <string.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMutex>
+
+static const char* const milestoneName[QuickenStartupMetrics::MilestoneCount] = {
+    "Library loaded", "Application created", "Engine created", "Component compiled",
+    "Root object created", "Window shown", "Scene graph initialized", "First frame swapped",
+    "Custom"
+};
+
+// Constant initialized, safe to use from static initializers.
+static QBasicMutex mutex;
+static QuickenMetrics milestones[QuickenStartupTimeline::maxMilestoneCount];
+static int milestoneCount = 0;
+static int takenCount = 0;
+static quint32 recordedMilestones = 0;  // Predefined milestones recorded.
+
+// static.
+bool QuickenStartupTimeline::add(QuickenStartupMetrics::Milestone milestone, const char* name)
+{
+    DASSERT(milestone < QuickenStartupMetrics::MilestoneCount);
+
+    const quint64 timeStamp = QuickenMetricsUtils::timeStamp();
+    const quint64 time = QuickenMetricsUtils::timeSinceProcessStart();
+
+    QMutexLocker locker(&mutex);
+    if (milestone != QuickenStartupMetrics::Custom) {
+        if (recordedMilestones & (1 << milestone)) {
+            return false;
+        }
+        recordedMilestones |= 1 << milestone;
+        name = milestoneName[milestone];
+    } else if (!name) {
+        name = milestoneName[milestone];
+    }
+    if (milestoneCount == maxMilestoneCount) {
+        WARN("StartupTimeline: Too many milestones, '%s' dropped.", name);
+        return false;
+    }
+
+    QuickenMetrics& metrics = milestones[milestoneCount++];
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.type = QuickenMetrics::Startup;
+    metrics.timeStamp = timeStamp;
+    metrics.startup.time = time;
+    metrics.startup.milestone = milestone;
+    strncpy(metrics.startup.name, name, QuickenStartupMetrics::maxNameSize - 1);
+    return true;
+}
+
+// static.
+int QuickenStartupTimeline::take(QuickenMetrics* metrics, int count)
+{
+    DASSERT(metrics);
+    DASSERT(count >= 0);
+
+    QMutexLocker locker(&mutex);
+    const int takeCount = qMin(count, milestoneCount - takenCount);
+    memcpy(metrics, &milestones[takenCount], takeCount * sizeof(QuickenMetrics));
+    takenCount += takeCount;
+    if (takenCount == milestoneCount) {
+        // Makes room for milestones recorded later on.
+        milestoneCount = 0;
+        takenCount = 0;
+    }
+    return takeCount;
+}
+
+static void libraryLoaded()
+{
+    QuickenStartupTimeline::add(QuickenStartupMetrics::LibraryLoaded);
+}
+Q_CONSTRUCTOR_FUNCTION(libraryLoaded)
+
+// Called from the QCoreApplication constructor, or right away if the library
+// is loaded once the application is created.
+static void applicationCreated()
+{
+    QuickenStartupTimeline::add(QuickenStartupMetrics::ApplicationCreated);
+}
+Q_COREAPP_STARTUP_FUNCTION(applicationCreated)
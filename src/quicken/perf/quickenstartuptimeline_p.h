@@ -0,0 +1,31 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+#ifndef STARTUPTIMELINE_P_H
+#define STARTUPTIMELINE_P_H
+
+#include <Quicken/quickenmetrics.h>
+#include <Quicken/private/quickenglobal_p.h>
+
+// Records the startup milestones of the process until they're logged. The
+// library load and the application creation are recorded automatically, at
+// static initialization and from the QCoreApplication constructor. Milestones
+// can be recorded before the application monitor exists and from any thread.
+class QUICKEN_PRIVATE_EXPORT QuickenStartupTimeline
+{
+public:
+    static const int maxMilestoneCount = 64;
+
+    // Record a milestone. The name is only used for custom milestones.
+    // Returns false if it's a predefined milestone already recorded or if
+    // there's no room left, milestones taking room until they're all taken.
+    static bool add(QuickenStartupMetrics::Milestone milestone, const char* name = nullptr);
+
+    // Fill metrics with the milestones recorded and not taken yet, in
+    // recording order. Returns the number of metrics filled, at most count.
+    static int take(QuickenMetrics* metrics, int count);
+};
+
+#endif  // STARTUPTIMELINE_P_H
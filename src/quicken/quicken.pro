@@ -1,5 +1,12 @@
 TARGET = Quicken
-QT = core-private quick-private
+QT = core-private qml-private quick-private
+
+# zlib streams the compression of the file logger segments.
+qtConfig(system-zlib) {
+    QMAKE_USE_PRIVATE += zlib
+} else {
+    QT_PRIVATE += zlib-private
+}
 
 contains(QT_CONFIG, opengles2) {
     CONFIG += egl
@@ -157,6 +157,7 @@ struct Options
         , coreProfile(false)
         , verbose(false)
         , metricsOverlay(false)
+        , metricsMemoryInterval(-1)
         , continuousUpdates(false)
         , applicationType(DefaultQmlApplicationType)
         , textRenderType(QQuickWindow::textRenderType())
@@ -183,6 +184,8 @@ struct Options
     bool metricsOverlay;
     QString metricsLogging;
     QString metricsLoggingFilter;
+    QString metricsLoggingFormat;
+    int metricsMemoryInterval;
     bool continuousUpdates;
     int quitAfterFrameCount;
     QVector<Qt::ApplicationAttribute> applicationAttributes;
@@ -394,8 +397,23 @@ static void usage()
     puts("  --metrics-logging <device> ........ Enable metrics logging. <device> is a file or 'stdout' (an empty");
     puts("    ................................. <device> means 'stdout').");
     puts("  --metrics-logging-filter <filter> . Filter logged metrics. <filter> is a list of metrics types (either");
-    puts("    ................................. 'window', 'frame', 'process' or 'generic') separated by commas");
-    puts("    ................................. (for example: 'window' or 'window,process').");
+    puts("    ................................. 'window', 'frame', 'process', 'thread', 'memory', 'texture',");
+    puts("    ................................. 'javascript', 'animation', 'input', 'startup', 'binding',");
+    puts("    ................................. 'opengl', 'scenegraph' or 'generic') separated by commas (for");
+    puts("    ................................. example: 'window' or 'window,process'). 'binding' profiles the");
+    puts("    ................................. QML bindings and logs the ones taking the most time every");
+    puts("    ................................. second. 'opengl' and 'scenegraph' add the draw calls and the");
+    puts("    ................................. geometry node counts to frame metrics.");
+    puts("    ................................. Without filter, 'texture', 'javascript', 'animation', 'input',");
+    puts("    ................................. 'binding', 'opengl' and 'scenegraph' aren't logged.");
+    puts("  --metrics-logging-format <format> . Format of logged metrics. <format> is either 'text' (default),");
+    puts("    ................................. 'binary' (raw records), 'compact' (compressed columns for long");
+    puts("    ................................. captures), 'trace' (Chrome Trace Event JSON) or 'socket' (raw");
+    puts("    ................................. records streamed to the quicken-collector socket at <device>).");
+    puts("    ................................. Only 'text' is supported by 'stdout'.");
+    puts("  --metrics-memory-interval <ms> .... Update memory metrics (PSS, private, shared, anonymous and swap");
+    puts("    ................................. memory) every <ms> milliseconds. Disabled by default since");
+    puts("    ................................. it's expensive.");
     puts("  --continuous-updates .............. Continuously update the main window.");
     puts("  --quit-after-frame-count <count> .. Quit after <count> frames rendered on the main window.");
     puts(" ");
@@ -544,6 +562,26 @@ static void setQuickenPerfOptions(Options* options) {
                 filter |= QuickenApplicationMonitor::ProcessMetrics;
             } else if (filterList[i] == QLatin1String("frame")) {
                 filter |= QuickenApplicationMonitor::FrameMetrics;
+            } else if (filterList[i] == QLatin1String("thread")) {
+                filter |= QuickenApplicationMonitor::ThreadMetrics;
+            } else if (filterList[i] == QLatin1String("memory")) {
+                filter |= QuickenApplicationMonitor::MemoryMetrics;
+            } else if (filterList[i] == QLatin1String("texture")) {
+                filter |= QuickenApplicationMonitor::TextureMetrics;
+            } else if (filterList[i] == QLatin1String("javascript")) {
+                filter |= QuickenApplicationMonitor::JavaScriptMetrics;
+            } else if (filterList[i] == QLatin1String("animation")) {
+                filter |= QuickenApplicationMonitor::AnimationMetrics;
+            } else if (filterList[i] == QLatin1String("startup")) {
+                filter |= QuickenApplicationMonitor::StartupMetrics;
+            } else if (filterList[i] == QLatin1String("input")) {
+                filter |= QuickenApplicationMonitor::InputMetrics;
+            } else if (filterList[i] == QLatin1String("binding")) {
+                filter |= QuickenApplicationMonitor::BindingMetrics;
+            } else if (filterList[i] == QLatin1String("opengl")) {
+                filter |= QuickenApplicationMonitor::OpenGLMetrics;
+            } else if (filterList[i] == QLatin1String("scenegraph")) {
+                filter |= QuickenApplicationMonitor::SceneGraphMetrics;
             } else if (filterList[i] == QLatin1String("generic")) {
                 filter |= QuickenApplicationMonitor::GenericMetrics;
             }
@@ -554,6 +592,14 @@ static void setQuickenPerfOptions(Options* options) {
         QuickenLogger* logger;
         if (options->metricsLogging == QLatin1String("stdout")) {
             logger = new QuickenFileLogger(stdout);
+        } else if (options->metricsLoggingFormat == QLatin1String("binary")) {
+            logger = new QuickenBinaryLogger(options->metricsLogging);
+        } else if (options->metricsLoggingFormat == QLatin1String("compact")) {
+            logger = new QuickenCompactLogger(options->metricsLogging);
+        } else if (options->metricsLoggingFormat == QLatin1String("trace")) {
+            logger = new QuickenTraceLogger(options->metricsLogging);
+        } else if (options->metricsLoggingFormat == QLatin1String("socket")) {
+            logger = new QuickenSocketLogger(options->metricsLogging);
         } else {
             logger = new QuickenFileLogger(options->metricsLogging);
         }
@@ -564,6 +610,10 @@ static void setQuickenPerfOptions(Options* options) {
             delete logger;
         }
     }
+    if (options->metricsMemoryInterval >= 0) {
+        applicationMonitor->setUpdateInterval(
+            QuickenMetrics::Memory, options->metricsMemoryInterval);
+    }
     if (options->metricsOverlay) {
         applicationMonitor->setOverlay(true);
     }
@@ -662,6 +712,12 @@ int main(int argc, char ** argv)
                     // Filter everything (as empty is not a valid metrics type).
                     options.metricsLoggingFilter = QString("empty");
                 }
+            } else if (lowerArgument == QLatin1String("--metrics-logging-format")) {
+                if (i+1 < size)
+                    options.metricsLoggingFormat = QString(argv[++i]);
+            } else if (lowerArgument == QLatin1String("--metrics-memory-interval")) {
+                if (i+1 < size)
+                    options.metricsMemoryInterval = atoi(argv[++i]);
             } else if (lowerArgument == QLatin1String("--continuous-updates"))
                 options.continuousUpdates = true;
             else if (lowerArgument == QLatin1String("--quit-after-frame-count"))
@@ -727,6 +783,7 @@ int main(int argc, char ** argv)
             // TODO: as soon as the engine construction completes, the debug service is
             // listening for connections.  But actually we aren't ready to debug anything.
             QQmlEngine engine;
+            QuickenApplicationMonitor::addStartupMilestone(QuickenStartupMetrics::EngineCreated);
             QPointer<QQmlComponent> component = new QQmlComponent(&engine);
             for (int i = 0; i < imports.size(); ++i)
                 engine.addImportPath(imports.at(i));
@@ -748,12 +805,16 @@ int main(int argc, char ** argv)
                 fprintf(stderr, "%s\n", qPrintable(component->errorString()));
                 return -1;
             }
+            QuickenApplicationMonitor::addStartupMilestone(
+                QuickenStartupMetrics::ComponentCompiled);
 
             QObject *topLevel = component->create();
             if (!topLevel && component->isError()) {
                 fprintf(stderr, "%s\n", qPrintable(component->errorString()));
                 return -1;
             }
+            QuickenApplicationMonitor::addStartupMilestone(
+                QuickenStartupMetrics::RootObjectCreated);
             QScopedPointer<QQuickWindow> window(qobject_cast<QQuickWindow *>(topLevel));
             if (window) {
                 engine.setIncubationController(window->incubationController());
@@ -806,6 +867,9 @@ int main(int argc, char ** argv)
                     window->showMaximized();
                 else if (!window->isVisible())
                     window->show();
+                // Monitoring isn't started yet, the window shown milestone
+                // isn't recorded by the application monitor.
+                QuickenApplicationMonitor::addStartupMilestone(QuickenStartupMetrics::WindowShown);
             }
 
             if (options.quitImmediately)
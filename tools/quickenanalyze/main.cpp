@@ -0,0 +1,661 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+// Computes per-window frame time and input latency statistics and per-process
+// resource trends from metrics logs. Parsable text logs (as written by
+// QuickenFileLogger and quicken-collector), binary logs (QuickenBinaryLogger
+// and QuickenFlightRecorderLogger) and compact logs (QuickenCompactLogger) are
+// supported. Inputs are memory-mapped and split in chunks parsed in parallel.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include <Quicken/quickenbinarylogreader.h>
+#include <Quicken/quickencompactlogreader.h>
+#include <Quicken/quickenlogger.h>
+#include <Quicken/quickenmetrics.h>
+
+enum FrameTime { DeltaTime = 0, SyncTime, RenderTime, GpuTime, SwapTime, FrameTimeCount };
+static const char* const frameTimeName[FrameTimeCount] = {
+    "delta", "sync", "render", "gpu", "swap"
+};
+enum InputTime { QueueingDelay = 0, InputLatency, InputTimeCount };
+static const char* const inputTimeName[InputTimeCount] = { "queue", "latency" };
+
+// Text logs without process ids are given one of these ids per file, above the
+// maximum process id of Linux so that they can't be mixed up with real ones.
+const quint32 anonymousProcessId = 0x80000000;
+
+struct Options
+{
+    quint64 frameInterval;  // In nanoseconds.
+    quint64 idleThreshold;  // In nanoseconds.
+    bool json;
+};
+
+struct WindowStatistics
+{
+    WindowStatistics() : frameCount(0), jankyFrameCount(0), missedFrameCount(0),
+                         idleCount(0), firstTimeStamp(~Q_UINT64_C(0)), lastTimeStamp(0) {}
+
+    QVector<quint64> times[FrameTimeCount];
+    QVector<quint64> inputTimes[InputTimeCount];
+    quint64 frameCount;
+    quint64 jankyFrameCount;
+    quint64 missedFrameCount;
+    quint64 idleCount;
+    quint64 firstTimeStamp;
+    quint64 lastTimeStamp;
+};
+
+struct ProcessStatistics
+{
+    ProcessStatistics() : count(0), cpuSum(0), cpuMax(0), rssMax(0), firstTimeStamp(~Q_UINT64_C(0)),
+                          lastTimeStamp(0), firstRss(0), lastRss(0), droppedCount(0),
+                          sumT(0.0), sumR(0.0), sumTT(0.0), sumTR(0.0) {}
+
+    quint64 count;
+    quint64 cpuSum;  // In hundredths of a percent.
+    quint32 cpuMax;  // In hundredths of a percent.
+    quint32 rssMax;
+    quint64 firstTimeStamp;
+    quint64 lastTimeStamp;
+    quint32 firstRss;
+    quint32 lastRss;
+    quint32 droppedCount;
+    // Sums for the least-squares fit of the RSS (kB) over time (minutes).
+    double sumT, sumR, sumTT, sumTR;
+};
+
+struct Statistics
+{
+    void add(quint32 processId, const QuickenMetrics& metrics, const Options& options);
+    void merge(const Statistics& other);
+
+    // Window statistics are keyed by process id in the high 32 bits and window
+    // id in the low 32 bits.
+    QHash<quint64, WindowStatistics> windows;
+    QHash<quint32, ProcessStatistics> processes;
+    // Files of the anonymous process ids.
+    QHash<quint32, QString> fileNames;
+};
+
+void Statistics::add(quint32 processId, const QuickenMetrics& metrics, const Options& options)
+{
+    if (metrics.type == QuickenMetrics::Frame) {
+        WindowStatistics& window =
+            windows[(static_cast<quint64>(processId) << 32) | metrics.frame.window];
+        window.frameCount++;
+        window.firstTimeStamp = qMin(window.firstTimeStamp, metrics.timeStamp);
+        window.lastTimeStamp = qMax(window.lastTimeStamp, metrics.timeStamp);
+
+        // Frames following an idle period (no update requested) are not
+        // counted as janky and their delta time is ignored.
+        const quint64 delta = metrics.frame.deltaTime;
+        if (delta > options.idleThreshold) {
+            window.idleCount++;
+        } else if (metrics.frame.number > 1) {
+            window.times[DeltaTime].append(delta);
+            if (delta * 2 > options.frameInterval * 3) {
+                window.jankyFrameCount++;
+                window.missedFrameCount +=
+                    (delta + options.frameInterval / 2) / options.frameInterval - 1;
+            }
+        }
+        window.times[SyncTime].append(metrics.frame.syncTime);
+        window.times[RenderTime].append(metrics.frame.renderTime);
+        window.times[GpuTime].append(metrics.frame.gpuTime);
+        window.times[SwapTime].append(metrics.frame.swapTime);
+
+    } else if (metrics.type == QuickenMetrics::Input) {
+        WindowStatistics& window =
+            windows[(static_cast<quint64>(processId) << 32) | metrics.input.window];
+        window.inputTimes[QueueingDelay].append(metrics.input.queueingDelay);
+        window.inputTimes[InputLatency].append(metrics.input.latency);
+
+    } else if (metrics.type == QuickenMetrics::Process) {
+        // Logs written before the precise CPU usage was added only have the
+        // rounded one.
+        const quint32 cpuUsage = metrics.process.preciseCpuUsage
+            ? metrics.process.preciseCpuUsage : metrics.process.cpuUsage * 100u;
+        ProcessStatistics& process = processes[processId];
+        process.count++;
+        process.cpuSum += cpuUsage;
+        process.cpuMax = qMax(process.cpuMax, cpuUsage);
+        process.rssMax = qMax(process.rssMax, metrics.process.rssMemory);
+        process.droppedCount = qMax(process.droppedCount, metrics.process.droppedCount);
+        if (metrics.timeStamp < process.firstTimeStamp) {
+            process.firstTimeStamp = metrics.timeStamp;
+            process.firstRss = metrics.process.rssMemory;
+        }
+        if (metrics.timeStamp >= process.lastTimeStamp) {
+            process.lastTimeStamp = metrics.timeStamp;
+            process.lastRss = metrics.process.rssMemory;
+        }
+        const double t = metrics.timeStamp / 60e9;
+        const double r = metrics.process.rssMemory;
+        process.sumT += t;
+        process.sumR += r;
+        process.sumTT += t * t;
+        process.sumTR += t * r;
+    }
+}
+
+void Statistics::merge(const Statistics& other)
+{
+    for (auto it = other.windows.constBegin(); it != other.windows.constEnd(); ++it) {
+        WindowStatistics& window = windows[it.key()];
+        const WindowStatistics& otherWindow = it.value();
+        for (int i = 0; i < FrameTimeCount; ++i) {
+            window.times[i] += otherWindow.times[i];
+        }
+        for (int i = 0; i < InputTimeCount; ++i) {
+            window.inputTimes[i] += otherWindow.inputTimes[i];
+        }
+        window.frameCount += otherWindow.frameCount;
+        window.jankyFrameCount += otherWindow.jankyFrameCount;
+        window.missedFrameCount += otherWindow.missedFrameCount;
+        window.idleCount += otherWindow.idleCount;
+        window.firstTimeStamp = qMin(window.firstTimeStamp, otherWindow.firstTimeStamp);
+        window.lastTimeStamp = qMax(window.lastTimeStamp, otherWindow.lastTimeStamp);
+    }
+
+    for (auto it = other.processes.constBegin(); it != other.processes.constEnd(); ++it) {
+        ProcessStatistics& process = processes[it.key()];
+        const ProcessStatistics& otherProcess = it.value();
+        process.count += otherProcess.count;
+        process.cpuSum += otherProcess.cpuSum;
+        process.cpuMax = qMax(process.cpuMax, otherProcess.cpuMax);
+        process.rssMax = qMax(process.rssMax, otherProcess.rssMax);
+        process.droppedCount = qMax(process.droppedCount, otherProcess.droppedCount);
+        if (otherProcess.firstTimeStamp < process.firstTimeStamp) {
+            process.firstTimeStamp = otherProcess.firstTimeStamp;
+            process.firstRss = otherProcess.firstRss;
+        }
+        if (otherProcess.lastTimeStamp >= process.lastTimeStamp) {
+            process.lastTimeStamp = otherProcess.lastTimeStamp;
+            process.lastRss = otherProcess.lastRss;
+        }
+        process.sumT += otherProcess.sumT;
+        process.sumR += otherProcess.sumR;
+        process.sumTT += otherProcess.sumTT;
+        process.sumTR += otherProcess.sumTR;
+    }
+
+    for (auto it = other.fileNames.constBegin(); it != other.fileNames.constEnd(); ++it) {
+        fileNames.insert(it.key(), it.value());
+    }
+}
+
+static const char* parseInteger(const char* text, const char* end, quint64* value)
+{
+    while (text < end && *text == ' ') {
+        text++;
+    }
+    if (text == end || *text < '0' || *text > '9') {
+        return nullptr;
+    }
+    quint64 result = 0;
+    while (text < end && *text >= '0' && *text <= '9') {
+        result = result * 10 + (*text++ - '0');
+    }
+    *value = result;
+    return text;
+}
+
+// Parses a parsable text line, optionally prefixed by a process id like in
+// quicken-collector logs. Other lines are ignored. Values appended to a line
+// type by later versions are optional, so that older logs can be read.
+static void parseLine(const char* text, const char* end, quint32 processId,
+                      Statistics* statistics, const Options& options)
+{
+    quint64 values[14];
+    if (text < end && *text >= '0' && *text <= '9') {
+        if (!(text = parseInteger(text, end, &values[0]))) {
+            return;
+        }
+        processId = static_cast<quint32>(values[0]);
+        while (text < end && *text == ' ') {
+            text++;
+        }
+    }
+    if (end - text < 2 || text[1] != ' ') {
+        return;
+    }
+
+    QuickenMetrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    int minValueCount;
+    int maxValueCount;
+    if (text[0] == 'F') {
+        metrics.type = QuickenMetrics::Frame;
+        minValueCount = maxValueCount = 8;
+    } else if (text[0] == 'P') {
+        // The dropped count and the following values were added later.
+        metrics.type = QuickenMetrics::Process;
+        minValueCount = 5;
+        maxValueCount = 14;
+    } else if (text[0] == 'I') {
+        metrics.type = QuickenMetrics::Input;
+        minValueCount = maxValueCount = 7;
+    } else {
+        return;
+    }
+    text += 2;
+    int valueCount = 0;
+    while (valueCount < maxValueCount) {
+        const char* next = parseInteger(text, end, &values[valueCount]);
+        if (!next) {
+            break;
+        }
+        text = next;
+        valueCount++;
+    }
+    if (valueCount < minValueCount) {
+        return;
+    }
+
+    metrics.timeStamp = values[0];
+    if (metrics.type == QuickenMetrics::Frame) {
+        metrics.frame.window = static_cast<quint32>(values[1]);
+        metrics.frame.number = static_cast<quint32>(values[2]);
+        metrics.frame.deltaTime = values[3];
+        metrics.frame.syncTime = values[4];
+        metrics.frame.renderTime = values[5];
+        metrics.frame.gpuTime = values[6];
+        metrics.frame.swapTime = values[7];
+    } else if (metrics.type == QuickenMetrics::Input) {
+        metrics.input.window = static_cast<quint32>(values[1]);
+        metrics.input.frame = static_cast<quint32>(values[2]);
+        metrics.input.queueingDelay = values[5];
+        metrics.input.latency = values[6];
+    } else {
+        metrics.process.cpuUsage = static_cast<quint16>(values[1]);
+        metrics.process.vszMemory = static_cast<quint32>(values[2]);
+        metrics.process.rssMemory = static_cast<quint32>(values[3]);
+        metrics.process.threadCount = static_cast<quint16>(values[4]);
+        if (valueCount > 5) {
+            metrics.process.droppedCount = static_cast<quint32>(values[5]);
+        }
+        if (valueCount > 12) {
+            metrics.process.preciseCpuUsage = static_cast<quint32>(values[12]);
+        }
+    }
+    statistics->add(processId, metrics, options);
+}
+
+static Statistics parseTextChunk(const char* text, const char* end, quint32 processId,
+                                 const Options& options)
+{
+    Statistics statistics;
+    while (text < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(text, '\n', end - text));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        parseLine(text, lineEnd, processId, &statistics, options);
+        text = lineEnd + 1;
+    }
+    return statistics;
+}
+
+static Statistics parseBinaryRange(QuickenBinaryLogReader* reader, qint64 first, qint64 last,
+                                   const Options& options)
+{
+    Statistics statistics;
+    const quint32 processId = reader->header()->processId;
+    for (qint64 i = first; i < last; ++i) {
+        statistics.add(processId, reader->at(i), options);
+    }
+    return statistics;
+}
+
+static Statistics parseCompactBlocks(QuickenCompactLogReader* reader, int first, int step,
+                                     const Options& options)
+{
+    Statistics statistics;
+    QVector<QuickenMetrics> records;
+    const quint32 processId = reader->processId();
+    for (int i = first; i < reader->blockCount(); i += step) {
+        records.resize(0);
+        if (!reader->readBlock(i, &records)) {
+            fprintf(stderr, "quicken-analyze: Skipping corrupted block %d.\n", i);
+            continue;
+        }
+        for (int j = 0; j < records.size(); ++j) {
+            statistics.add(processId, records[j], options);
+        }
+    }
+    return statistics;
+}
+
+static bool analyzeFile(const QString& fileName, int fileIndex, Statistics* statistics,
+                        const Options& options)
+{
+    const int threadCount = qMax(1, QThread::idealThreadCount());
+    QList<QFuture<Statistics> > futures;
+
+    char magic[8] = {};
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "quicken-analyze: Can't open file '%s'.\n",
+                fileName.toLocal8Bit().constData());
+        return false;
+    }
+    file.read(magic, sizeof(magic));
+
+    if (!memcmp(magic, "QUICKENB", sizeof(magic))) {
+        QuickenBinaryLogReader reader(fileName);
+        if (!reader.isOpen()) {
+            return false;
+        }
+        const qint64 count = reader.count();
+        for (int i = 0; i < threadCount; ++i) {
+            futures.append(QtConcurrent::run(parseBinaryRange, &reader, count * i / threadCount,
+                                             count * (i + 1) / threadCount, options));
+        }
+        for (int i = 0; i < futures.size(); ++i) {
+            statistics->merge(futures[i].result());
+        }
+
+    } else if (!memcmp(magic, "QUICKENC", sizeof(magic))) {
+        QuickenCompactLogReader reader(fileName);
+        if (!reader.isOpen()) {
+            return false;
+        }
+        for (int i = 0; i < threadCount; ++i) {
+            futures.append(QtConcurrent::run(parseCompactBlocks, &reader, i, threadCount, options));
+        }
+        for (int i = 0; i < futures.size(); ++i) {
+            statistics->merge(futures[i].result());
+        }
+
+    } else {
+        const qint64 size = file.size();
+        if (size == 0) {
+            return true;
+        }
+        const uchar* map = file.map(0, size);
+        if (!map) {
+            fprintf(stderr, "quicken-analyze: Can't map file '%s'.\n",
+                    fileName.toLocal8Bit().constData());
+            return false;
+        }
+        const char* const text = reinterpret_cast<const char*>(map);
+        const char* const end = text + size;
+
+        // Logs of a single process might start with a segment header giving
+        // the process id. Others are kept apart from the other files.
+        quint32 processId = anonymousProcessId + fileIndex;
+        const char header[] = "# Quicken metrics log pid ";
+        quint64 value;
+        if (size > static_cast<qint64>(sizeof(header) - 1)
+            && !memcmp(text, header, sizeof(header) - 1)
+            && parseInteger(text + sizeof(header) - 1, end, &value)) {
+            processId = static_cast<quint32>(value);
+        } else {
+            statistics->fileNames.insert(processId, fileName);
+        }
+
+        // Chunks are split at line boundaries.
+        const char* chunk = text;
+        for (int i = 1; i <= threadCount && chunk < end; ++i) {
+            const char* chunkEnd = i == threadCount ? end : text + size * i / threadCount;
+            if (chunkEnd < chunk) {
+                continue;
+            }
+            const char* lineEnd = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = lineEnd ? lineEnd + 1 : end;
+            futures.append(QtConcurrent::run(parseTextChunk, chunk, chunkEnd, processId, options));
+            chunk = chunkEnd;
+        }
+        for (int i = 0; i < futures.size(); ++i) {
+            statistics->merge(futures[i].result());
+        }
+    }
+
+    return true;
+}
+
+// Nearest-rank percentile, partially sorts the values.
+static quint64 percentile(QVector<quint64>* values, int percent)
+{
+    if (values->isEmpty()) {
+        return 0;
+    }
+    const qint64 size = values->size();
+    const int rank = qMax(1, static_cast<int>((size * percent + 99) / 100));
+    std::nth_element(values->begin(), values->begin() + rank - 1, values->end());
+    return (*values)[rank - 1];
+}
+
+static double rssTrend(const ProcessStatistics& process)
+{
+    const double n = process.count;
+    const double denominator = n * process.sumTT - process.sumT * process.sumT;
+    if (process.count < 2 || denominator == 0.0) {
+        return 0.0;
+    }
+    return (n * process.sumTR - process.sumT * process.sumR) / denominator;
+}
+
+// Reports the percentiles and the maximum of a set of times, as a line of the
+// window table or in the given JSON object.
+static void reportTimes(QVector<quint64>* times, const char* name, const Options& options,
+                        QJsonObject* json)
+{
+    const int percents[] = { 50, 90, 99 };
+    quint64 values[4];
+    for (int i = 0; i < 3; ++i) {
+        values[i] = percentile(times, percents[i]);
+    }
+    values[3] = times->isEmpty() ? 0 : *std::max_element(times->begin(), times->end());
+    if (options.json) {
+        QJsonObject jsonTime;
+        jsonTime[QStringLiteral("p50")] = values[0] / 1e6;
+        jsonTime[QStringLiteral("p90")] = values[1] / 1e6;
+        jsonTime[QStringLiteral("p99")] = values[2] / 1e6;
+        jsonTime[QStringLiteral("max")] = values[3] / 1e6;
+        (*json)[QString::fromLatin1(name)] = jsonTime;
+    } else {
+        fprintf(stdout, "    %-8s %9.2f %9.2f %9.2f %9.2f\n", name, values[0] / 1e6,
+                values[1] / 1e6, values[2] / 1e6, values[3] / 1e6);
+    }
+}
+
+static void report(Statistics* statistics, const Options& options)
+{
+    QList<quint32> processIds = statistics->processes.keys();
+    QList<quint64> windowKeys = statistics->windows.keys();
+    for (int i = 0; i < windowKeys.size(); ++i) {
+        if (!processIds.contains(static_cast<quint32>(windowKeys[i] >> 32))) {
+            processIds.append(static_cast<quint32>(windowKeys[i] >> 32));
+        }
+    }
+    std::sort(processIds.begin(), processIds.end());
+    std::sort(windowKeys.begin(), windowKeys.end());
+
+    QJsonArray jsonProcesses;
+    for (int i = 0; i < processIds.size(); ++i) {
+        const quint32 processId = processIds[i];
+        QJsonObject jsonProcess;
+        if (processId >= anonymousProcessId) {
+            const QString fileName = statistics->fileNames.value(processId);
+            jsonProcess[QStringLiteral("file")] = fileName;
+            if (!options.json) {
+                fprintf(stdout, "File %s\n", fileName.toLocal8Bit().constData());
+            }
+        } else {
+            jsonProcess[QStringLiteral("pid")] = static_cast<qint64>(processId);
+            if (!options.json) {
+                fprintf(stdout, "Process %u\n", processId);
+            }
+        }
+
+        if (statistics->processes.contains(processId)) {
+            const ProcessStatistics& process = statistics->processes[processId];
+            const double duration = (process.lastTimeStamp - process.firstTimeStamp) / 1e9;
+            const double cpuAverage = process.cpuSum / 100.0 / process.count;
+            const double cpuMax = process.cpuMax / 100.0;
+            const double trend = rssTrend(process);
+            if (options.json) {
+                jsonProcess[QStringLiteral("duration")] = duration;
+                jsonProcess[QStringLiteral("cpuAverage")] = cpuAverage;
+                jsonProcess[QStringLiteral("cpuMax")] = cpuMax;
+                jsonProcess[QStringLiteral("rssFirst")] = static_cast<qint64>(process.firstRss);
+                jsonProcess[QStringLiteral("rssLast")] = static_cast<qint64>(process.lastRss);
+                jsonProcess[QStringLiteral("rssMax")] = static_cast<qint64>(process.rssMax);
+                jsonProcess[QStringLiteral("rssTrend")] = trend;
+                jsonProcess[QStringLiteral("droppedCount")] =
+                    static_cast<qint64>(process.droppedCount);
+            } else {
+                fprintf(stdout, "  Duration : %.1f s\n", duration);
+                fprintf(stdout, "  CPU      : average %.2f %%, max %.2f %%\n", cpuAverage,
+                        cpuMax);
+                fprintf(stdout, "  RSS      : first %u kB, last %u kB, max %u kB, "
+                        "trend %+.1f kB/min\n", process.firstRss, process.lastRss,
+                        process.rssMax, trend);
+                fprintf(stdout, "  Dropped  : %u\n", process.droppedCount);
+            }
+        }
+
+        QJsonArray jsonWindows;
+        for (int j = 0; j < windowKeys.size(); ++j) {
+            if (static_cast<quint32>(windowKeys[j] >> 32) != processId) {
+                continue;
+            }
+            WindowStatistics& window = statistics->windows[windowKeys[j]];
+            const quint32 windowId = static_cast<quint32>(windowKeys[j] & 0xffffffff);
+            const double duration = (window.lastTimeStamp - window.firstTimeStamp) / 1e9;
+            QJsonObject jsonWindow;
+            if (options.json) {
+                jsonWindow[QStringLiteral("id")] = static_cast<qint64>(windowId);
+                jsonWindow[QStringLiteral("duration")] = duration;
+                jsonWindow[QStringLiteral("frameCount")] = static_cast<qint64>(window.frameCount);
+                jsonWindow[QStringLiteral("jankyFrameCount")] =
+                    static_cast<qint64>(window.jankyFrameCount);
+                jsonWindow[QStringLiteral("missedFrameCount")] =
+                    static_cast<qint64>(window.missedFrameCount);
+                jsonWindow[QStringLiteral("idleCount")] = static_cast<qint64>(window.idleCount);
+            } else {
+                fprintf(stdout, "  Window %u : %llu frames in %.1f s, %llu janky, %llu missed, "
+                        "%llu after idle\n", windowId,
+                        static_cast<unsigned long long>(window.frameCount), duration,
+                        static_cast<unsigned long long>(window.jankyFrameCount),
+                        static_cast<unsigned long long>(window.missedFrameCount),
+                        static_cast<unsigned long long>(window.idleCount));
+                fprintf(stdout, "    (ms)          p50       p90       p99       max\n");
+            }
+
+            for (int k = 0; k < FrameTimeCount; ++k) {
+                reportTimes(&window.times[k], frameTimeName[k], options, &jsonWindow);
+            }
+
+            // Input latencies are only reported for windows that received
+            // input events.
+            const int inputCount = window.inputTimes[InputLatency].size();
+            if (inputCount > 0) {
+                if (options.json) {
+                    QJsonObject jsonInput;
+                    jsonInput[QStringLiteral("count")] = inputCount;
+                    for (int k = 0; k < InputTimeCount; ++k) {
+                        reportTimes(&window.inputTimes[k], inputTimeName[k], options, &jsonInput);
+                    }
+                    jsonWindow[QStringLiteral("input")] = jsonInput;
+                } else {
+                    fprintf(stdout, "    input (%d events)\n", inputCount);
+                    for (int k = 0; k < InputTimeCount; ++k) {
+                        reportTimes(&window.inputTimes[k], inputTimeName[k], options, nullptr);
+                    }
+                }
+            }
+            if (options.json) {
+                jsonWindows.append(jsonWindow);
+            }
+        }
+
+        if (options.json) {
+            jsonProcess[QStringLiteral("windows")] = jsonWindows;
+            jsonProcesses.append(jsonProcess);
+        }
+    }
+
+    if (options.json) {
+        QJsonObject root;
+        root[QStringLiteral("processes")] = jsonProcesses;
+        fputs(QJsonDocument(root).toJson().constData(), stdout);
+    }
+}
+
+static void usage()
+{
+    puts("Usage: quicken-analyze [options] <file> [<file>...]");
+    puts(" ");
+    puts(" Options:");
+    puts("  --json .................. Output JSON instead of text.");
+    puts("  --refresh-rate <hz> ..... Refresh rate used to detect janky and missed frames");
+    puts("    ....................... (default is 60).");
+    puts("  --idle-threshold <ms> ... Delta time above which a frame is considered to follow an");
+    puts("    ....................... idle period rather than a jank (default is 500).");
+    puts("  --help .................. Show this help.");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication application(argc, argv);
+    Options options;
+    options.frameInterval = 1000000000 / 60;
+    options.idleThreshold = Q_UINT64_C(500000000);
+    options.json = false;
+    QStringList fileNames;
+
+    const QStringList arguments = QCoreApplication::arguments();
+    for (int i = 1, size = arguments.size(); i < size; ++i) {
+        const QString& argument = arguments.at(i);
+        if (argument == QLatin1String("--json")) {
+            options.json = true;
+        } else if (argument == QLatin1String("--refresh-rate") && i + 1 < size) {
+            const double refreshRate = arguments.at(++i).toDouble();
+            if (refreshRate <= 0.0) {
+                usage();
+            }
+            options.frameInterval = static_cast<quint64>(1e9 / refreshRate);
+        } else if (argument == QLatin1String("--idle-threshold") && i + 1 < size) {
+            options.idleThreshold =
+                static_cast<quint64>(qMax(0, arguments.at(++i).toInt())) * 1000000;
+        } else if (argument.startsWith(QLatin1Char('-'))) {
+            usage();
+        } else {
+            fileNames.append(argument);
+        }
+    }
+    if (fileNames.isEmpty()) {
+        usage();
+    }
+
+    Statistics statistics;
+    for (int i = 0; i < fileNames.size(); ++i) {
+        if (!analyzeFile(fileNames[i], i, &statistics, options)) {
+            return 1;
+        }
+    }
+    report(&statistics, options);
+
+    return 0;
+}
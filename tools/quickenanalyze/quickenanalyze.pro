@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = quicken-analyze
+QT = core concurrent
+
+CONFIG += c++11
+SOURCES += main.cpp
+INCLUDEPATH += $${OUT_PWD}/../../include
+LIBS += -L$${OUT_PWD}/../../lib -lQuicken
+QMAKE_TARGET_DESCRIPTION = Metrics log analyzer for Quicken
+
+load(qt_tool)
@@ -0,0 +1,447 @@
+// Copyright © 2018 Loïc Molinari <loicm@loicm.fr>
+//
+// This file is part of Quicken, licensed under the MIT license. See the license
+// file at project root for full information.
+
+// Collects the metrics streamed by QuickenSocketLogger instances of several
+// processes and merges them into a single timeline. Records are written in the
+// parsable text format of QuickenFileLogger, prefixed by the id of the process,
+// with time stamps converted to a common time base, the earliest clock origin
+// of the collector and of the processes connected so far. A comment line
+// giving that clock origin is written at the beginning and each time a process
+// with an earlier one connects.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#include <Quicken/quickenlogger.h>
+#include <Quicken/quickenmetrics.h>
+
+const int mergeInterval = 100;  // In milliseconds.
+
+static volatile sig_atomic_t quitRequested = 0;
+
+static void quitSignalHandler(int)
+{
+    quitRequested = 1;
+}
+
+struct Connection
+{
+    QLocalSocket* socket;
+    QuickenBinaryLogHeader header;
+    QVector<QuickenMetrics> records;  // Pending records, in arrival order.
+    int recordIndex;  // Index of the first pending record.
+    quint64 recordCount;
+    bool hasHeader;
+};
+
+class Collector : public QObject
+{
+    Q_OBJECT
+
+public:
+    Collector(FILE* output, int latency);
+    ~Collector();
+
+    bool listen(const QString& socketPath);
+
+private Q_SLOTS:
+    void acceptConnection();
+    void readSocket();
+    void closeSocket();
+    void merge();
+
+private:
+    Connection* connection(QObject* socket);
+    void mergeRecords(bool all);
+    qint64 mergeTime(const Connection* connection, const QuickenMetrics& metrics);
+    void write(const Connection* connection, const QuickenMetrics& metrics);
+
+    QLocalServer m_server;
+    QTimer m_mergeTimer;
+    QVector<Connection*> m_connections;
+    FILE* m_output;
+    quint64 m_latency;  // In nanoseconds.
+    quint64 m_collectorClockOrigin;
+    quint64 m_clockOrigin;  // Time base of the time stamps written.
+};
+
+Collector::Collector(FILE* output, int latency)
+    : m_output(output)
+    , m_latency(static_cast<quint64>(latency) * 1000000)
+    , m_collectorClockOrigin(QuickenMetricsUtils::timeStampOrigin())
+    , m_clockOrigin(m_collectorClockOrigin)
+{
+    connect(&m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    connect(&m_mergeTimer, SIGNAL(timeout()), this, SLOT(merge()));
+    m_mergeTimer.start(mergeInterval);
+    fprintf(m_output, "# clock origin %llu\n", static_cast<unsigned long long>(m_clockOrigin));
+}
+
+Collector::~Collector()
+{
+    mergeRecords(true);
+    qDeleteAll(m_connections);
+    fflush(m_output);
+}
+
+bool Collector::listen(const QString& socketPath)
+{
+    QLocalServer::removeServer(socketPath);
+    if (!m_server.listen(socketPath)) {
+        fprintf(stderr, "quicken-collector: Can't listen to socket '%s' (%s).\n",
+                socketPath.toLocal8Bit().constData(),
+                m_server.errorString().toLocal8Bit().constData());
+        return false;
+    }
+    return true;
+}
+
+Connection* Collector::connection(QObject* socket)
+{
+    for (int i = 0; i < m_connections.size(); ++i) {
+        if (m_connections[i]->socket == socket) {
+            return m_connections[i];
+        }
+    }
+    return nullptr;
+}
+
+void Collector::acceptConnection()
+{
+    while (QLocalSocket* socket = m_server.nextPendingConnection()) {
+        Connection* connection = new Connection;
+        connection->socket = socket;
+        connection->recordIndex = 0;
+        connection->recordCount = 0;
+        connection->hasHeader = false;
+        m_connections.append(connection);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readSocket()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(closeSocket()));
+    }
+}
+
+void Collector::readSocket()
+{
+    Connection* connection = this->connection(sender());
+    if (!connection || !connection->socket) {
+        return;
+    }
+    QLocalSocket* socket = connection->socket;
+
+    if (!connection->hasHeader) {
+        if (socket->bytesAvailable() < static_cast<qint64>(sizeof(QuickenBinaryLogHeader))) {
+            return;
+        }
+        socket->read(reinterpret_cast<char*>(&connection->header), sizeof(connection->header));
+        if (!connection->header.isCompatible()) {
+            fprintf(stderr, "quicken-collector: Incompatible stream, closing connection.\n");
+            socket->abort();
+            return;
+        }
+        connection->hasHeader = true;
+        if (connection->header.clockOrigin < m_clockOrigin) {
+            // Records of the process logged before the current time base
+            // would otherwise get negative time stamps.
+            m_clockOrigin = connection->header.clockOrigin;
+            fprintf(m_output, "# clock origin %llu\n",
+                    static_cast<unsigned long long>(m_clockOrigin));
+        }
+        fprintf(m_output, "# %u connected\n", connection->header.processId);
+    }
+
+    // Records are only read once complete.
+    const int count =
+        static_cast<int>(socket->bytesAvailable() / static_cast<qint64>(sizeof(QuickenMetrics)));
+    if (count > 0) {
+        const int size = connection->records.size();
+        connection->records.resize(size + count);
+        socket->read(reinterpret_cast<char*>(&connection->records[size]),
+                     count * sizeof(QuickenMetrics));
+        connection->recordCount += count;
+    }
+}
+
+void Collector::closeSocket()
+{
+    Connection* connection = this->connection(sender());
+    if (connection && connection->socket) {
+        // Pending records are merged before the connection is removed.
+        connection->socket->deleteLater();
+        connection->socket = nullptr;
+    }
+}
+
+void Collector::merge()
+{
+    mergeRecords(false);
+    fflush(m_output);
+    if (quitRequested) {
+        QCoreApplication::quit();
+    }
+}
+
+void Collector::mergeRecords(bool all)
+{
+    // Records of a process come in order, but later than logged because of the
+    // batching of the logging thread and of the socket logger. Pending records
+    // are held until they're older than the latency, so that the records of
+    // the other processes logged at the same time had a chance to arrive, and
+    // are then written in time stamp order across processes. All the pending
+    // records are written if requested, whatever their age.
+    const qint64 limit = static_cast<qint64>(QuickenMetricsUtils::timeStamp() - m_latency);
+
+    while (true) {
+        Connection* next = nullptr;
+        qint64 nextTime = 0;
+        for (int i = 0; i < m_connections.size(); ++i) {
+            Connection* connection = m_connections[i];
+            if (connection->recordIndex < connection->records.size()) {
+                const qint64 time =
+                    mergeTime(connection, connection->records[connection->recordIndex]);
+                if (!next || time < nextTime) {
+                    next = connection;
+                    nextTime = time;
+                }
+            }
+        }
+        if (!next || (!all && nextTime > limit)) {
+            break;
+        }
+        write(next, next->records[next->recordIndex++]);
+    }
+
+    for (int i = m_connections.size() - 1; i >= 0; --i) {
+        Connection* connection = m_connections[i];
+        // Written records are removed so that a connection streaming
+        // continuously doesn't grow its buffer.
+        if (connection->recordIndex > 0) {
+            connection->records.remove(0, connection->recordIndex);
+            connection->recordIndex = 0;
+        }
+        if (!connection->socket && connection->records.isEmpty()) {
+            if (connection->hasHeader) {
+                fprintf(m_output, "# %u disconnected %llu records\n",
+                        connection->header.processId,
+                        static_cast<unsigned long long>(connection->recordCount));
+            }
+            delete connection;
+            m_connections.remove(i);
+        }
+    }
+}
+
+// Gets the time stamp of a record in the time base of the collector, negative
+// for records logged before the collector started.
+qint64 Collector::mergeTime(const Connection* connection, const QuickenMetrics& metrics)
+{
+    return static_cast<qint64>(connection->header.clockOrigin - m_collectorClockOrigin)
+        + static_cast<qint64>(metrics.timeStamp);
+}
+
+void Collector::write(const Connection* connection, const QuickenMetrics& metrics)
+{
+    // The time base is the earliest clock origin of the processes connected,
+    // the time stamps written can't be negative.
+    const quint32 processId = connection->header.processId;
+    const unsigned long long timeStamp =
+        connection->header.clockOrigin - m_clockOrigin + metrics.timeStamp;
+
+    switch (metrics.type) {
+    case QuickenMetrics::Process:
+        fprintf(m_output, "%u P %llu %u %u %u %u %u %u %u %u %u %llu %llu %u %llu\n", processId,
+                timeStamp, metrics.process.cpuUsage, metrics.process.vszMemory,
+                metrics.process.rssMemory, metrics.process.threadCount,
+                metrics.process.droppedCount, metrics.process.minorFaults,
+                metrics.process.majorFaults, metrics.process.voluntarySwitches,
+                metrics.process.involuntarySwitches,
+                static_cast<unsigned long long>(metrics.process.readBytes),
+                static_cast<unsigned long long>(metrics.process.writeBytes),
+                metrics.process.preciseCpuUsage,
+                static_cast<unsigned long long>(metrics.process.cpuTime));
+        break;
+
+    case QuickenMetrics::Window:
+        fprintf(m_output, "%u W %llu %u %u %u %u\n", processId, timeStamp, metrics.window.id,
+                static_cast<unsigned int>(metrics.window.state), metrics.window.width,
+                metrics.window.height);
+        break;
+
+    case QuickenMetrics::Frame:
+        fprintf(m_output,
+                "%u F %llu %u %u %llu %llu %llu %llu %llu %llu %u %u %llu %u %u %llu %u %u %u %u %u"
+                " %u\n", processId, timeStamp, metrics.frame.window, metrics.frame.number,
+                static_cast<unsigned long long>(metrics.frame.deltaTime),
+                static_cast<unsigned long long>(metrics.frame.syncTime),
+                static_cast<unsigned long long>(metrics.frame.renderTime),
+                static_cast<unsigned long long>(metrics.frame.gpuTime),
+                static_cast<unsigned long long>(metrics.frame.swapTime),
+                static_cast<unsigned long long>(metrics.frame.cpuTime),
+                metrics.frame.renderAllocations, metrics.frame.renderFrees,
+                static_cast<unsigned long long>(metrics.frame.renderAllocatedBytes),
+                metrics.frame.guiAllocations, metrics.frame.guiFrees,
+                static_cast<unsigned long long>(metrics.frame.guiAllocatedBytes),
+                metrics.frame.opaqueNodes, metrics.frame.alphaNodes,
+                metrics.frame.unmergeableNodes, metrics.frame.drawCalls,
+                metrics.frame.vertexBytes, metrics.frame.indexBytes);
+        break;
+
+    case QuickenMetrics::Generic:
+        fprintf(m_output, "%u G %llu %u %.*s\n", processId, timeStamp, metrics.generic.id,
+                static_cast<int>(qMin(metrics.generic.stringSize,
+                                      static_cast<quint32>(QuickenGenericMetrics::maxStringSize))),
+                metrics.generic.string);
+        break;
+
+    case QuickenMetrics::Thread:
+        fprintf(m_output, "%u T %llu %u %u %u %u %llu %llu %u %.*s\n", processId, timeStamp,
+                metrics.thread.id, metrics.thread.tags, metrics.thread.window,
+                metrics.thread.cpuUsage,
+                static_cast<unsigned long long>(metrics.thread.cpuTime),
+                static_cast<unsigned long long>(metrics.thread.waitTime),
+                metrics.thread.sliceCount,
+                static_cast<int>(strnlen(metrics.thread.name, QuickenThreadMetrics::maxNameSize)),
+                metrics.thread.name);
+        break;
+
+    case QuickenMetrics::Memory:
+        fprintf(m_output, "%u M %llu %u %u %u %u %u %u\n", processId, timeStamp,
+                metrics.memory.pssMemory, metrics.memory.privateCleanMemory,
+                metrics.memory.privateDirtyMemory, metrics.memory.sharedMemory,
+                metrics.memory.anonymousMemory, metrics.memory.swapMemory);
+        break;
+
+    case QuickenMetrics::Texture:
+        fprintf(m_output, "%u X %llu %u %u %u %u %u %u %u %u %u %u\n", processId, timeStamp,
+                metrics.texture.window, metrics.texture.frame, metrics.texture.uploadCount,
+                metrics.texture.uploadedBytes, metrics.texture.atlasUploadCount,
+                metrics.texture.atlasUploadedBytes, metrics.texture.textureCount,
+                metrics.texture.textureMemory, metrics.texture.atlasCount,
+                metrics.texture.atlasMemory);
+        break;
+
+    case QuickenMetrics::JavaScript:
+        fprintf(m_output, "%u J %llu %u %u %u %u %u %u %u %u %llu\n", processId, timeStamp,
+                metrics.javaScript.window, metrics.javaScript.frame,
+                metrics.javaScript.usedMemory, metrics.javaScript.largeItemMemory,
+                metrics.javaScript.allocatedMemory, metrics.javaScript.collections,
+                metrics.javaScript.collectionCount, metrics.javaScript.reclaimedMemory,
+                static_cast<unsigned long long>(metrics.javaScript.collectionTimeBound));
+        break;
+
+    case QuickenMetrics::Binding:
+        fprintf(m_output, "%u B %llu %u %u %llu %u %llu %u %llu %.*s\n", processId, timeStamp,
+                metrics.binding.rank, metrics.binding.evaluationCount,
+                static_cast<unsigned long long>(metrics.binding.time),
+                metrics.binding.maxFrameEvaluationCount,
+                static_cast<unsigned long long>(metrics.binding.maxFrameTime),
+                metrics.binding.totalEvaluationCount,
+                static_cast<unsigned long long>(metrics.binding.totalTime),
+                static_cast<int>(
+                    strnlen(metrics.binding.location, QuickenBindingMetrics::maxLocationSize)),
+                metrics.binding.location);
+        break;
+
+    case QuickenMetrics::Animation:
+        fprintf(m_output, "%u A %llu %u %u %u %u %llu %llu %llu %lld %lld\n", processId,
+                timeStamp, metrics.animation.window, metrics.animation.frame,
+                metrics.animation.runningAnimationCount, metrics.animation.tickCount,
+                static_cast<unsigned long long>(metrics.animation.advanceTime),
+                static_cast<unsigned long long>(metrics.animation.animationTime),
+                static_cast<unsigned long long>(metrics.animation.wallTime),
+                static_cast<long long>(metrics.animation.drift),
+                static_cast<long long>(metrics.animation.totalDrift));
+        break;
+
+    case QuickenMetrics::Input:
+        fprintf(m_output, "%u I %llu %u %u %u %u %llu %llu\n", processId, timeStamp,
+                metrics.input.window, metrics.input.frame, metrics.input.type,
+                metrics.input.action, static_cast<unsigned long long>(metrics.input.queueingDelay),
+                static_cast<unsigned long long>(metrics.input.latency));
+        break;
+
+    case QuickenMetrics::Startup:
+        fprintf(m_output, "%u S %llu %u %llu %.*s\n", processId, timeStamp,
+                metrics.startup.milestone, static_cast<unsigned long long>(metrics.startup.time),
+                static_cast<int>(
+                    strnlen(metrics.startup.name, QuickenStartupMetrics::maxNameSize)),
+                metrics.startup.name);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void usage()
+{
+    puts("Usage: quicken-collector [options]");
+    puts(" ");
+    puts(" Options:");
+    puts("  --socket <path> ......... Listen to <path> (default is 'quicken-collector' in the");
+    puts("    ....................... temporary directory).");
+    puts("  --output <file> ......... Write the merged metrics to <file> (default is stdout).");
+    puts("  --latency <ms> .......... Delay before writing records in order (default is 500).");
+    puts("  --help .................. Show this help.");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication application(argc, argv);
+    QString socketPath = QDir::tempPath() + QLatin1String("/quicken-collector");
+    QString outputFileName;
+    int latency = 500;
+
+    const QStringList arguments = QCoreApplication::arguments();
+    for (int i = 1, size = arguments.size(); i < size; ++i) {
+        const QString& argument = arguments.at(i);
+        if (argument == QLatin1String("--socket") && i + 1 < size) {
+            socketPath = arguments.at(++i);
+        } else if (argument == QLatin1String("--output") && i + 1 < size) {
+            outputFileName = arguments.at(++i);
+        } else if (argument == QLatin1String("--latency") && i + 1 < size) {
+            latency = qMax(0, arguments.at(++i).toInt());
+        } else {
+            usage();
+        }
+    }
+
+    FILE* output = stdout;
+    if (!outputFileName.isEmpty()) {
+        output = fopen(QFile::encodeName(outputFileName).constData(), "w");
+        if (!output) {
+            fprintf(stderr, "quicken-collector: Can't open file '%s'.\n",
+                    outputFileName.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    signal(SIGINT, quitSignalHandler);
+    signal(SIGTERM, quitSignalHandler);
+
+    int exitCode = 1;
+    {
+        Collector collector(output, latency);
+        if (collector.listen(socketPath)) {
+            exitCode = application.exec();
+        }
+    }
+
+    if (output != stdout) {
+        fclose(output);
+    }
+    return exitCode;
+}
+
+#include "main.moc"
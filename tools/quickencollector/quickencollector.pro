@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = quicken-collector
+QT = core network
+
+CONFIG += c++11
+SOURCES += main.cpp
+INCLUDEPATH += $${OUT_PWD}/../../include
+LIBS += -L$${OUT_PWD}/../../lib -lQuicken
+QMAKE_TARGET_DESCRIPTION = Metrics collector for Quicken
+
+load(qt_tool)